@@ -4,19 +4,27 @@
 #
 #-------------------------------------------------
 
-QT       += core gui multimedia
+TEMPLATE = subdirs
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+# core:     Qt-free chip8 interpreter (static library)
+# gui:      Qt front-end (Chip8Emulator)
+# headless: command-line runner for batch jobs (Chip8Headless)
+# tracedump: decoder for instruction traces (Chip8TraceDump)
+# videodump: framebuffer video to image sequence (Chip8VideoDump)
+# bench:    micro- and macrobenchmarks with JSON output (Chip8Bench)
+# recompiler: ahead-of-time recompiler from ROMs to C++ (Chip8Recompile)
+SUBDIRS += \
+    core \
+    gui \
+    headless \
+    tracedump \
+    videodump \
+    bench \
+    recompiler
 
-TARGET = Chip8Emulator
-TEMPLATE = app
-
-SOURCES += main.cpp\
-        gui.cpp \
-    chip8.cpp
-
-HEADERS  += gui.h \
-    chip8.h
-
-RESOURCES += \
-    resources.qrc
+gui.depends = core
+headless.depends = core recompiler
+tracedump.depends = core
+videodump.depends = core
+bench.depends = core recompiler
+recompiler.depends = core
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Micro- and macrobenchmarks of the core, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt app_bundle
+CONFIG   += console
+
+TARGET = Chip8Bench
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += main.cpp
+
+# The bundled ROMs recompiled by Chip8Recompile, for --engine native
+include(../recompiler/native_roms.pri)
@@ -0,0 +1,441 @@
+#include "chip8.h"
+#include "library.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define BENCH_FORMAT_VERSION    1
+
+/*
+ * Microbenchmarks: a short loop at 0x200 that is almost all one opcode
+ * family, run with emulateCycles() so timers and idle skipping stay out of
+ * the way. Every loop ends in a jump back to its start.
+ */
+struct Micro
+{
+    const char *name;
+    const char *family;
+    unsigned short code[16];        // Zero terminated
+};
+
+static const Micro micros[] = {
+    // 8XY4, 8XY5, 8XY6, 8XY7, 8XYE, 8XY1, 8XY2, 8XY3, 8XY0
+    { "alu", "8XYN", { 0x8014, 0x8125, 0x8236, 0x8347, 0x845E, 0x8561, 0x8672, 0x8783, 0x8890, 0x1200, 0 } },
+    // 8x5 font sprites at moving positions, so they wrap and collide
+    { "draw", "DXYN", { 0xA000, 0xD015, 0x7003, 0xD125, 0x7105, 0xD235, 0x7207, 0x1202, 0 } },
+    // BCD then store and load V0-V3 at 0x400
+    { "memory", "FX33/FX55/FX65", { 0xA400, 0xF033, 0xF355, 0xF365, 0x7001, 0x1202, 0 } },
+    // Three calls of a subroutine that adds and returns
+    { "call", "2NNN/00EE", { 0x2208, 0x2208, 0x2208, 0x1200, 0x7001, 0x00EE, 0 } },
+    // Taken and untaken skips
+    { "branch", "3XNN/4XNN/5XY0/9XY0", { 0x3001, 0x4001, 0x5010, 0x9010, 0x7001, 0x1200, 0 } }
+};
+
+// Per-ROM input: every SCRIPT_HOLD frames a new key (or none) from a fixed sequence
+#define SCRIPT_HOLD     15
+
+struct Options
+{
+    const char *romDir;
+    const char *packPath;
+    const char *outputPath;
+    const char *label;
+    const char *filter;
+    unsigned long long iterations;
+    unsigned frames;
+    unsigned ipf;
+    unsigned repeat;
+    bool idle;
+    bool micro;
+    bool macro;
+    vector<chip8::Engine> engines;
+};
+
+struct Rom
+{
+    string name;
+    vector<unsigned char> image;
+};
+
+// Timings of one benchmark over all its runs
+struct Result
+{
+    string kind;                    // "micro" or "macro"
+    string name;
+    string family;                  // Micro only
+    chip8::Engine engine;
+    unsigned long long instructions;    // Per run
+    unsigned long long idle;            // Of those, fast-forwarded (macro only)
+    uint64_t hash;                      // Framebuffer at the end (macro only)
+    vector<double> ns;                  // ns/instruction of each run
+};
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("Runs the micro- and macrobenchmarks and writes the results as JSON.\n");
+    printf("  --roms DIR       Macrobenchmark every ROM in DIR (default ROMs)\n");
+    printf("  --pack F         Take the ROMs from the pack F instead\n");
+    printf("  --engine E       interpreter, blocks, native or all (default all)\n");
+    printf("  --iterations N   Instructions per microbenchmark run (default 20000000)\n");
+    printf("  --frames N       Frames per macrobenchmark run (default 3000)\n");
+    printf("  --ipf N          Instructions per frame for the ROMs (default %d)\n", CHIP8_DEFAULT_CYCLES_PER_FRAME);
+    printf("  --repeat N       Timed runs of each benchmark, after one warm-up (default 5)\n");
+    printf("  --no-idle        Run idle loops in the ROMs instruction by instruction\n");
+    printf("  --micro          Only the microbenchmarks\n");
+    printf("  --macro          Only the macrobenchmarks\n");
+    printf("  --filter S       Only benchmarks whose name contains S\n");
+    printf("  --label S        Stored in the output, e.g. the commit being measured\n");
+    printf("  --output F       Write the JSON to F instead of stdout\n");
+}
+
+static double seconds(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end)
+{
+    return chrono::duration<double>(end - start).count();
+}
+
+// Timed runs of one microbenchmark; the first run only warms the caches up
+static Result runMicro(const Options &opt, const Micro &m, chip8::Engine engine)
+{
+    unsigned char rom[sizeof(m.code)];
+    size_t size = 0;
+    for (size_t i = 0; i < sizeof(m.code) / sizeof(m.code[0]) && m.code[i] != 0; ++i)
+    {
+        rom[size++] = (unsigned char) (m.code[i] >> 8);
+        rom[size++] = (unsigned char) m.code[i];
+    }
+
+    Result r;
+    r.kind = "micro";
+    r.name = m.name;
+    r.family = m.family;
+    r.engine = engine;
+    r.instructions = opt.iterations;
+    r.idle = 0;
+    r.hash = 0;
+
+    for (unsigned run = 0; run <= opt.repeat; ++run)
+    {
+        chip8 emu;
+        emu.setEngine(engine);
+        emu.setIdleSkipping(false);
+        emu.initialize();
+        emu.loadGame(rom, size);
+        emu.setQuirks(chip8::QUIRKS_MODERN);
+        emu.seedRandom(1);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        emu.emulateCycles(opt.iterations);
+        double elapsed = seconds(start, chrono::steady_clock::now());
+
+        if (run > 0) {
+            r.ns.push_back(elapsed * 1e9 / opt.iterations);
+        }
+    }
+    return r;
+}
+
+// Timed runs of one ROM with the same scripted input every time
+static Result runMacro(const Options &opt, const Rom &rom, chip8::Engine engine)
+{
+    Result r;
+    r.kind = "macro";
+    r.name = rom.name;
+    r.engine = engine;
+
+    for (unsigned run = 0; run <= opt.repeat; ++run)
+    {
+        chip8 emu;
+        emu.setEngine(engine);
+        emu.setIdleSkipping(opt.idle);
+        emu.setCyclesPerFrame(opt.ipf);
+        emu.initialize();
+        emu.loadGame(&rom.image[0], rom.image.size());
+        emu.seedRandom(1);
+
+        uint32_t x = 1;
+        unsigned char keys[16] = { 0 };
+        unsigned long long instructions = 0;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (unsigned f = 0; f < opt.frames; ++f)
+        {
+            if (f % SCRIPT_HOLD == 0) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                memset(keys, 0, sizeof(keys));
+                if (x % 17 < 16) {
+                    keys[x % 17] = 1;
+                }
+                emu.setKeys(keys);
+            }
+            instructions += emu.runFrame().instructions;
+        }
+        double elapsed = seconds(start, chrono::steady_clock::now());
+
+        r.instructions = instructions;
+        r.idle = emu.getIdleInstructions();
+        r.hash = emu.framebufferHash();
+        if (run > 0) {
+            r.ns.push_back(instructions ? elapsed * 1e9 / instructions : 0.0);
+        }
+    }
+    return r;
+}
+
+// ROM file names are the only strings that may need escaping
+static string quoted(const string &s)
+{
+    string out = "\"";
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        unsigned char c = (unsigned char) s[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char) c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += (char) c;
+        }
+    }
+    return out + "\"";
+}
+
+// Mean, best and sample variance of ns/instruction over the runs
+static void summarize(const Result &r, double &mean, double &best, double &variance)
+{
+    const size_t n = r.ns.size();
+    mean = 0;
+    best = n ? r.ns[0] : 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        mean += r.ns[i];
+        best = min(best, r.ns[i]);
+    }
+    mean = n ? mean / n : 0.0;
+
+    variance = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        variance += (r.ns[i] - mean) * (r.ns[i] - mean);
+    }
+    variance = n > 1 ? variance / (n - 1) : 0.0;
+}
+
+static void writeResult(FILE *fp, const Result &r, bool last)
+{
+    const size_t n = r.ns.size();
+    double mean, best, variance;
+    summarize(r, mean, best, variance);
+
+    fprintf(fp, "    {\"kind\": %s, \"name\": %s, ", quoted(r.kind).c_str(), quoted(r.name).c_str());
+    if (!r.family.empty()) {
+        fprintf(fp, "\"family\": %s, ", quoted(r.family).c_str());
+    }
+    fprintf(fp, "\"engine\": \"%s\", \"instructions\": %llu, ", chip8::engineName(r.engine), r.instructions);
+    if (r.kind == "macro") {
+        fprintf(fp, "\"idle_instructions\": %llu, \"fb_hash\": \"%016llX\", ", r.idle, (unsigned long long) r.hash);
+    }
+    fprintf(fp, "\"runs\": %u,\n     \"instructions_per_second\": %.0f, \"ns_per_instruction\": %.4f, "
+                "\"ns_per_instruction_min\": %.4f, \"ns_per_instruction_variance\": %.6f, \"ns_per_instruction_stddev\": %.4f,\n"
+                "     \"ns_per_instruction_runs\": [",
+            (unsigned) n, mean > 0 ? 1e9 / mean : 0.0, mean, best, variance, sqrt(variance));
+    for (size_t i = 0; i < n; ++i)
+    {
+        fprintf(fp, "%s%.4f", i ? ", " : "", r.ns[i]);
+    }
+    fprintf(fp, "]}%s\n", last ? "" : ",");
+}
+
+// One line per benchmark while the suite runs
+static void progress(const Result &r)
+{
+    double mean, best, variance;
+    summarize(r, mean, best, variance);
+    fprintf(stderr, "%-12s %-6s %-12s %8.3f ns/instruction (+-%.3f)\n", chip8::engineName(r.engine), r.kind.c_str(), r.name.c_str(),
+            mean, sqrt(variance));
+}
+
+static bool loadRoms(const Options &opt, vector<Rom> &roms)
+{
+    if (opt.packPath != NULL) {
+        chip8_library library;
+        if (!library.open(opt.packPath)) {
+            fprintf(stderr, "Not a ROM pack of this version: %s\n", opt.packPath);
+            return false;
+        }
+        for (size_t i = 0; i < library.size(); ++i)
+        {
+            const chip8_pack_entry &e = library.entry(i);
+            Rom rom;
+            rom.name = e.name;
+            rom.image.assign(library.image(e), library.image(e) + e.size);
+            roms.push_back(rom);
+        }
+        return true;
+    }
+
+    vector<string> names;
+    if (!chip8_list_files(opt.romDir, names)) {
+        fprintf(stderr, "Cannot list %s\n", opt.romDir);
+        return false;
+    }
+    sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        Rom rom;
+        rom.name = names[i];
+        if (names[i][0] != '.' && chip8_read_rom((string(opt.romDir) + "/" + names[i]).c_str(), rom.image)) {
+            roms.push_back(rom);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    opt.romDir = "ROMs";
+    opt.packPath = NULL;
+    opt.outputPath = NULL;
+    opt.label = "";
+    opt.filter = "";
+    opt.iterations = 20000000;
+    opt.frames = 3000;
+    opt.ipf = CHIP8_DEFAULT_CYCLES_PER_FRAME;
+    opt.repeat = 5;
+    opt.idle = true;
+    opt.micro = true;
+    opt.macro = true;
+    opt.engines.push_back(chip8::ENGINE_INTERPRETER);
+    opt.engines.push_back(chip8::ENGINE_BLOCKS);
+    opt.engines.push_back(chip8::ENGINE_NATIVE);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--roms") == 0 && i + 1 < argc) {
+            opt.romDir = argv[++i];
+        } else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+            opt.packPath = argv[++i];
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            opt.engines.clear();
+            if (strcmp(name, "interpreter") == 0 || strcmp(name, "all") == 0) {
+                opt.engines.push_back(chip8::ENGINE_INTERPRETER);
+            }
+            if (strcmp(name, "blocks") == 0 || strcmp(name, "all") == 0) {
+                opt.engines.push_back(chip8::ENGINE_BLOCKS);
+            }
+            if (strcmp(name, "native") == 0 || strcmp(name, "all") == 0) {
+                opt.engines.push_back(chip8::ENGINE_NATIVE);
+            }
+            if (opt.engines.empty()) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            opt.iterations = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            opt.frames = (unsigned) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+            opt.ipf = (unsigned) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            opt.repeat = (unsigned) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--no-idle") == 0) {
+            opt.idle = false;
+        } else if (strcmp(argv[i], "--micro") == 0) {
+            opt.macro = false;
+        } else if (strcmp(argv[i], "--macro") == 0) {
+            opt.micro = false;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            opt.filter = argv[++i];
+        } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            opt.label = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            opt.outputPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opt.iterations == 0 || opt.frames == 0 || opt.ipf == 0 || opt.repeat == 0 || (!opt.micro && !opt.macro)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    vector<Rom> roms;
+    if (opt.macro && !loadRoms(opt, roms)) {
+        return 1;
+    }
+
+    // Progress goes to stderr so stdout stays valid JSON
+    vector<Result> results;
+    for (size_t e = 0; e < opt.engines.size(); ++e)
+    {
+        const chip8::Engine engine = opt.engines[e];
+
+        // The microbenchmarks are generated, so nothing of them was recompiled
+        for (size_t i = 0; opt.micro && engine != chip8::ENGINE_NATIVE && i < sizeof(micros) / sizeof(micros[0]); ++i)
+        {
+            if (strstr(micros[i].name, opt.filter) != NULL) {
+                results.push_back(runMicro(opt, micros[i], engine));
+                progress(results.back());
+            }
+        }
+        for (size_t i = 0; opt.macro && i < roms.size(); ++i)
+        {
+            if (strstr(roms[i].name.c_str(), opt.filter) != NULL) {
+                results.push_back(runMacro(opt, roms[i], engine));
+                progress(results.back());
+            }
+        }
+    }
+
+    FILE *fp = stdout;
+    if (opt.outputPath != NULL) {
+        fp = fopen(opt.outputPath, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "Cannot write %s\n", opt.outputPath);
+            return 1;
+        }
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"format\": %d,\n", BENCH_FORMAT_VERSION);
+    fprintf(fp, "  \"label\": %s,\n", quoted(opt.label).c_str());
+    fprintf(fp, "  \"time\": %lld,\n", (long long) time(NULL));
+    fprintf(fp, "  \"iterations\": %llu,\n", opt.iterations);
+    fprintf(fp, "  \"frames\": %u,\n", opt.frames);
+    fprintf(fp, "  \"ipf\": %u,\n", opt.ipf);
+    fprintf(fp, "  \"idle_skipping\": %s,\n", opt.idle ? "true" : "false");
+    fprintf(fp, "  \"repeat\": %u,\n", opt.repeat);
+    fprintf(fp, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        writeResult(fp, results[i], i + 1 == results.size());
+    }
+    fprintf(fp, "  ]\n}\n");
+
+    bool ok = !ferror(fp);
+    if (fp != stdout) {
+        ok = (fclose(fp) == 0) && ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "Cannot write %s\n", opt.outputPath ? opt.outputPath : "the results");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "audio.h"
+#include <cmath>
+#include <cstring>
+
+size_t chip8_null_sink::write(const int16_t *, size_t count)
+{
+    return count;
+}
+
+size_t chip8_null_sink::queued() const
+{
+    return 0;
+}
+
+chip8_wav_sink::chip8_wav_sink() : fp(NULL), rate(0), samples(0), failed(false)
+{
+}
+
+chip8_wav_sink::~chip8_wav_sink()
+{
+    close();
+}
+
+static void put16(unsigned char *p, uint16_t v)
+{
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+    put16(p, (uint16_t) v);
+    put16(p + 2, (uint16_t) (v >> 16));
+}
+
+#define WAV_HEADER_SIZE     44
+
+// RIFF header of a 16-bit mono PCM file holding samples samples
+static void wavHeader(unsigned char *h, unsigned rate, uint32_t samples)
+{
+    memcpy(h, "RIFF", 4);
+    put32(h + 4, 36 + samples * 2);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put32(h + 16, 16);                  // fmt chunk size
+    put16(h + 20, 1);                   // PCM
+    put16(h + 22, 1);                   // Channels
+    put32(h + 24, rate);
+    put32(h + 28, rate * 2);            // Bytes per second
+    put16(h + 32, 2);                   // Bytes per sample frame
+    put16(h + 34, 16);                  // Bits per sample
+    memcpy(h + 36, "data", 4);
+    put32(h + 40, samples * 2);
+}
+
+bool chip8_wav_sink::open(const char *filename, unsigned rate)
+{
+    close();
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    // Sizes are zero until close() patches them
+    unsigned char header[WAV_HEADER_SIZE];
+    wavHeader(header, rate, 0);
+    this->rate = rate;
+    samples = 0;
+    failed = fwrite(header, 1, sizeof(header), fp) != sizeof(header);
+    return !failed;
+}
+
+bool chip8_wav_sink::close()
+{
+    if (fp == NULL) {
+        return false;
+    }
+
+    unsigned char header[WAV_HEADER_SIZE];
+    wavHeader(header, rate, samples);
+    bool ok = !failed
+            && fseek(fp, 0, SEEK_SET) == 0
+            && fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+    ok = (fclose(fp) == 0) && ok;
+    fp = NULL;
+
+    return ok;
+}
+
+bool chip8_wav_sink::isOpen() const
+{
+    return fp != NULL;
+}
+
+size_t chip8_wav_sink::write(const int16_t *data, size_t count)
+{
+    if (fp == NULL || failed) {
+        return 0;
+    }
+
+    unsigned char bytes[2 * 1024];
+    size_t done = 0;
+    while (done < count)
+    {
+        size_t chunk = count - done < 1024 ? count - done : 1024;
+        for (size_t i = 0; i < chunk; ++i)
+        {
+            put16(bytes + 2 * i, (uint16_t) data[done + i]);
+        }
+        if (fwrite(bytes, 2, chunk, fp) != chunk) {
+            failed = true;
+            break;
+        }
+        done += chunk;
+    }
+
+    samples += (uint32_t) done;
+    return done;
+}
+
+size_t chip8_wav_sink::queued() const
+{
+    return 0;
+}
+
+chip8_audio::chip8_audio(unsigned rate) :
+    rate(rate ? rate : CHIP8_AUDIO_RATE), sink(NULL), frameNumber(0),
+    phase(0), patterned(true), pitch(0),
+    buffer(this->rate / 60 + 1)
+{
+    memset(pattern, 0, sizeof(pattern));
+    memset(&stats, 0, sizeof(stats));
+
+    // Big enough for the longest pattern loop (pitch 0), so rebuilding never allocates
+    tone.reserve(this->rate / 8);
+}
+
+void chip8_audio::setSink(chip8_audio_sink *sink)
+{
+    this->sink = sink;
+}
+
+unsigned chip8_audio::getRate() const
+{
+    return rate;
+}
+
+void chip8_audio::reset()
+{
+    frameNumber = 0;
+    phase = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void chip8_audio::beginFrame()
+{
+    frameStart = std::chrono::steady_clock::now();
+}
+
+// Renders the frame runFrame() just ran and hands it to the sink
+void chip8_audio::renderFrame(const chip8 &emu, const chip8_frame &frame)
+{
+    size_t count = nextFrameSamples();
+    updateTone(emu);
+
+    bool on = frame.soundOn;
+    bool onset = false;
+    size_t at = 0;
+    for (unsigned e = 0; e < frame.soundEdges; ++e)
+    {
+        size_t edge = count;
+        if (frame.instructions != 0 && frame.soundEdgeAt[e] < frame.instructions) {
+            edge = (size_t) (frame.soundEdgeAt[e] * (unsigned long long) count / frame.instructions);
+        }
+
+        if (on) {
+            fillTone(at, edge);
+        } else {
+            memset(&buffer[at], 0, (edge - at) * sizeof(int16_t));
+        }
+        at = edge;
+
+        // Every tone starts at the beginning of the loop
+        on = !on;
+        if (on) {
+            phase = 0;
+            onset = true;
+        }
+    }
+
+    if (on) {
+        fillTone(at, count);
+    } else {
+        memset(&buffer[at], 0, (count - at) * sizeof(int16_t));
+    }
+
+    submit(count, onset);
+}
+
+void chip8_audio::renderSilence()
+{
+    size_t count = nextFrameSamples();
+    memset(&buffer[0], 0, count * sizeof(int16_t));
+    submit(count, false);
+}
+
+const chip8_audio_stats &chip8_audio::getStats() const
+{
+    return stats;
+}
+
+// 800 at 48 kHz; rates that do not divide by 60 alternate so no sample is lost
+size_t chip8_audio::nextFrameSamples()
+{
+    size_t count = (size_t) ((frameNumber + 1) * rate / 60 - frameNumber * rate / 60);
+    ++frameNumber;
+    return count;
+}
+
+// Rebuilds the tone loop if the machine's pattern or pitch changed since the last frame
+void chip8_audio::updateTone(const chip8 &emu)
+{
+    const unsigned char *bits = emu.getAudioPattern();
+    bool loaded = false;
+    for (int i = 0; i < 16; ++i)
+    {
+        loaded |= bits[i] != 0;
+    }
+
+    if (!loaded) {
+        if (patterned) {
+            size_t period = (rate + CHIP8_AUDIO_BUZZER_HZ / 2) / CHIP8_AUDIO_BUZZER_HZ;
+            if (period < 2) {
+                period = 2;
+            }
+            tone.resize(period);
+            for (size_t i = 0; i < period; ++i)
+            {
+                tone[i] = (i < period / 2) ? CHIP8_AUDIO_VOLUME : -CHIP8_AUDIO_VOLUME;
+            }
+            patterned = false;
+            phase %= period;
+        }
+        return;
+    }
+
+    if (patterned && pitch == emu.getAudioPitch() && memcmp(pattern, bits, sizeof(pattern)) == 0) {
+        return;
+    }
+
+    memcpy(pattern, bits, sizeof(pattern));
+    pitch = emu.getAudioPitch();
+    patterned = true;
+
+    // All 128 bits once, stretched to the nearest whole number of samples
+    double bitsPerSecond = 4000.0 * pow(2.0, (pitch - 64) / 48.0);
+    size_t length = (size_t) (rate * 128.0 / bitsPerSecond + 0.5);
+    if (length < 1) {
+        length = 1;
+    }
+    tone.resize(length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        size_t bit = i * 128 / length;
+        bool set = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1;
+        tone[i] = set ? CHIP8_AUDIO_VOLUME : -CHIP8_AUDIO_VOLUME;
+    }
+    phase %= length;
+}
+
+// Copies the tone loop into buffer[from, to), carrying on where it left off
+void chip8_audio::fillTone(size_t from, size_t to)
+{
+    while (from < to)
+    {
+        size_t chunk = tone.size() - phase;
+        if (chunk > to - from) {
+            chunk = to - from;
+        }
+        memcpy(&buffer[from], &tone[phase], chunk * sizeof(int16_t));
+        from += chunk;
+        phase += chunk;
+        if (phase == tone.size()) {
+            phase = 0;
+        }
+    }
+}
+
+void chip8_audio::submit(size_t count, bool onset)
+{
+    ++stats.frames;
+    stats.samples += count;
+    if (sink == NULL) {
+        return;
+    }
+
+    // The new samples play once everything the sink already holds has
+    size_t ahead = sink->queued();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    size_t taken = sink->write(&buffer[0], count);
+    stats.dropped += count - taken;
+
+    if (onset) {
+        double latency = std::chrono::duration<double>(now - frameStart).count() + (double) ahead / rate;
+        ++stats.onsets;
+        stats.lastLatency = latency;
+        stats.totalLatency += latency;
+        if (latency > stats.maxLatency) {
+            stats.maxLatency = latency;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "chip8.h"
+
+#define CHIP8_AUDIO_RATE        48000   // Samples per second, 16-bit mono
+#define CHIP8_AUDIO_BUZZER_HZ   400     // Tone of ROMs that never load an XO-CHIP pattern
+#define CHIP8_AUDIO_VOLUME      6000    // Square wave amplitude
+
+/*
+ * Where synthesized samples go. write() is called once per frame from the
+ * thread running the emulator, so implementations must not block in it.
+ */
+class chip8_audio_sink
+{
+public:
+    virtual ~chip8_audio_sink() {}
+
+    virtual size_t write(const int16_t *samples, size_t count) = 0;    // Samples taken, the rest are dropped
+    virtual size_t queued() const = 0;      // Samples taken that have not been played yet
+};
+
+// Takes everything and plays nothing, for machines without an audio device
+class chip8_null_sink : public chip8_audio_sink
+{
+public:
+    size_t write(const int16_t *samples, size_t count);
+    size_t queued() const;
+};
+
+// 16-bit mono WAV file, its sizes are filled in by close()
+class chip8_wav_sink : public chip8_audio_sink
+{
+public:
+    chip8_wav_sink();
+    ~chip8_wav_sink();
+
+    bool open(const char *filename, unsigned rate);
+    bool close();
+    bool isOpen() const;
+
+    size_t write(const int16_t *samples, size_t count);
+    size_t queued() const;
+
+private:
+    chip8_wav_sink(const chip8_wav_sink &) = delete;
+    chip8_wav_sink &operator=(const chip8_wav_sink &) = delete;
+
+    FILE *fp;
+    unsigned rate;
+    uint32_t samples;
+    bool failed;
+};
+
+struct chip8_audio_stats
+{
+    unsigned long long frames;
+    unsigned long long samples;         // Rendered
+    unsigned long long dropped;         // Refused by the sink
+    unsigned long long onsets;          // Tone starts, each one a latency measurement
+    double lastLatency;                 // Seconds from FX18 running to its first sample playing
+    double maxLatency;
+    double totalLatency;                // Over all onsets, for the mean
+};
+
+/*
+ * Turns the sound timer into samples, one 60 Hz frame at a time.
+ *
+ * The tone is a precomputed loop: a square wave at CHIP8_AUDIO_BUZZER_HZ,
+ * or the machine's 128-bit XO-CHIP pattern played at 4000*2^((pitch-64)/48)
+ * bits per second, rebuilt only when the pattern or pitch change. Frames
+ * are copied out of it starting and stopping on the sample that matches
+ * the instruction that ran FX18 (chip8_frame::soundEdgeAt), and a running
+ * tone stops on the frame boundary where the timer reaches zero.
+ *
+ * Latency is measured for every tone start as the time from beginFrame()
+ * (when the FX18 ran, as far as real time is concerned) to the sink having
+ * played the samples it already held.
+ */
+class chip8_audio
+{
+public:
+    explicit chip8_audio(unsigned rate = CHIP8_AUDIO_RATE);
+
+    void setSink(chip8_audio_sink *sink);   // NULL renders nothing
+    unsigned getRate() const;
+    void reset();                           // New run: frame count, phase and stats
+
+    void beginFrame();                      // Just before runFrame()
+    void renderFrame(const chip8 &emu, const chip8_frame &frame);
+    void renderSilence();                   // A frame without running the machine, e.g. rewinding
+
+    const chip8_audio_stats &getStats() const;
+
+private:
+    unsigned rate;
+    chip8_audio_sink *sink;
+    unsigned long long frameNumber;         // Picks the frame length so frames add up to rate exactly
+
+    std::vector<int16_t> tone;              // One loop of the current tone
+    size_t phase;                           // Next sample of tone to play
+    bool patterned;                         // tone holds pattern/pitch rather than the buzzer
+    unsigned char pattern[16];
+    unsigned char pitch;
+
+    std::vector<int16_t> buffer;            // The frame being rendered
+    std::chrono::steady_clock::time_point frameStart;
+    chip8_audio_stats stats;
+
+    size_t nextFrameSamples();
+    void updateTone(const chip8 &emu);
+    void fillTone(size_t from, size_t to);
+    void submit(size_t count, bool onset);
+};
+
+#endif // AUDIO_H
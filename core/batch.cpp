@@ -0,0 +1,151 @@
+#include "batch.h"
+#include "library.h"
+#include "state.h"
+#include <cstring>
+
+// Instances per work item; big enough to amortize scheduling, small enough to balance
+#define CHIP8_BATCH_CHUNK   16
+
+chip8_batch::chip8_batch(size_t count, chip8_thread_pool &pool) :
+    pool(pool), machines(count), inputs(count * 16, 0), executed(count, 0)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        machines[i].initialize();
+    }
+}
+
+size_t chip8_batch::size() const
+{
+    return machines.size();
+}
+
+bool chip8_batch::loadGame(const char *filename)
+{
+    std::vector<unsigned char> rom;
+    return chip8_read_rom(filename, rom) && loadGame(&rom[0], rom.size());
+}
+
+bool chip8_batch::loadGame(const unsigned char *data, size_t size)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].initialize();
+        if (!machines[i].loadGame(data, size)) {
+            return false;
+        }
+        executed[i] = 0;
+    }
+    memset(&inputs[0], 0, inputs.size());
+
+    return true;
+}
+
+// Warm start: every instance resumes from the same snapshot, keys included
+bool chip8_batch::loadState(const chip8_state &state)
+{
+    if (!chip8_state_valid(state)) {
+        return false;
+    }
+
+    pool.parallelFor(machines.size(), CHIP8_BATCH_CHUNK, [this, &state](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            machines[i].loadState(state);
+            memcpy(&inputs[i * 16], state.key, 16);
+            executed[i] = 0;
+        }
+    });
+    return true;
+}
+
+void chip8_batch::seedRandom(uint32_t seed)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].seedRandom(seed + (uint32_t) i);
+    }
+}
+
+void chip8_batch::setEngine(chip8::Engine engine)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].setEngine(engine);
+    }
+}
+
+void chip8_batch::setCyclesPerFrame(unsigned cycles)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].setCyclesPerFrame(cycles);
+    }
+}
+
+void chip8_batch::setQuirks(chip8::Quirks quirks)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].setQuirks(quirks);
+    }
+}
+
+void chip8_batch::setIdleSkipping(bool enabled)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].setIdleSkipping(enabled);
+    }
+}
+
+unsigned char *chip8_batch::keys(size_t index)
+{
+    return &inputs[index * 16];
+}
+
+void chip8_batch::runFrames(unsigned frames)
+{
+    pool.parallelFor(machines.size(), CHIP8_BATCH_CHUNK, [this, frames](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            machines[i].setKeys(&inputs[i * 16]);
+            executed[i] += machines[i].runFrames(frames).instructions;
+        }
+    });
+}
+
+const uint64_t *chip8_batch::getFramebuffer(size_t index) const
+{
+    return machines[index].getFramebuffer();
+}
+
+uint64_t chip8_batch::framebufferHash(size_t index) const
+{
+    return machines[index].framebufferHash();
+}
+
+chip8 &chip8_batch::instance(size_t index)
+{
+    return machines[index];
+}
+
+unsigned long long chip8_batch::instructions() const
+{
+    unsigned long long total = 0;
+    for (size_t i = 0; i < executed.size(); ++i)
+    {
+        total += executed[i];
+    }
+    return total;
+}
+
+unsigned long long chip8_batch::idleInstructions() const
+{
+    unsigned long long total = 0;
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        total += machines[i].getIdleInstructions();
+    }
+    return total;
+}
@@ -0,0 +1,50 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "chip8.h"
+#include "thread_pool.h"
+
+/*
+ * Owns many independent chip8 machines and steps them in parallel.
+ * Every instance has its own 16-byte key array (applied before each call
+ * to runFrames()) and its own CXNN generator, so results do not depend on
+ * how instances are spread over threads.
+ */
+class chip8_batch
+{
+public:
+    chip8_batch(size_t count, chip8_thread_pool &pool);
+
+    size_t size() const;
+
+    bool loadGame(const char *filename);
+    bool loadGame(const unsigned char *data, size_t size);
+    bool loadState(const chip8_state &state);       // Same generator in all, reseed to vary; false if invalid
+    void seedRandom(uint32_t seed);                 // Instance i gets seed + i
+    void setEngine(chip8::Engine engine);
+    void setCyclesPerFrame(unsigned cycles);
+    void setQuirks(chip8::Quirks quirks);           // After loadGame(), which picks them by ROM hash
+    void setIdleSkipping(bool enabled);
+
+    unsigned char *keys(size_t index);              // Input array of one instance
+    void runFrames(unsigned frames);
+
+    const uint64_t *getFramebuffer(size_t index) const;
+    uint64_t framebufferHash(size_t index) const;
+    chip8 &instance(size_t index);
+
+    unsigned long long instructions() const;        // Total run by all instances
+    unsigned long long idleInstructions() const;    // Of those, fast-forwarded through idle loops
+
+private:
+    chip8_thread_pool &pool;
+    std::vector<chip8> machines;
+    std::vector<unsigned char> inputs;              // 16 bytes per instance
+    std::vector<unsigned long long> executed;       // Instructions per instance
+};
+
+#endif // BATCH_H
@@ -0,0 +1,2115 @@
+#include "chip8.h"
+#include "debugger.h"
+#include "library.h"
+#include "native.h"
+#include "quirks.h"
+#include "state.h"
+#include "trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <atomic>
+
+using namespace std;
+
+unsigned char chip8_fontset[80] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+unsigned char chip8_fontset_hires[160] = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// Distinguishes instances constructed within the same second
+static std::atomic<uint32_t> chip8_instances(0);
+
+chip8::chip8()
+{
+    seedRandom((uint32_t) time(NULL) ^ (chip8_instances.fetch_add(1) * 0x9E3779B9u));
+    engine = ENGINE_INTERPRETER;
+    cyclesPerFrame = CHIP8_DEFAULT_CYCLES_PER_FRAME;
+    trace = NULL;
+    debugger = NULL;
+    frameProgress = 0;
+    debugStop = false;
+    debugRan = 0;
+    quirks = QUIRKS_MODERN;
+    idleSkipping = true;
+    idleInstructions = 0;
+    unknownOpcodes = 0;
+    lastUnknownOpcode = 0;
+    soundEdges = 0;
+    native = NULL;
+    nativeStale = false;
+    invalidateAll();
+}
+
+void chip8::initialize()
+{
+    // Reset index register
+    this->I = 0;
+
+    // Reset stack pointer
+    this->sp = 0;
+
+    // Reset timers
+    this->delay_timer = 0;
+    this->sound_timer = 0;
+
+    // Reset ...
+    memset(this->memory, 0, sizeof(unsigned char) * CHIP8_MEMORY_SIZE);
+    memset(this->V, 0, sizeof(unsigned char) * 16);
+    memset(this->gfx, 0, sizeof(this->gfx));
+    this->dirtyRows = ~0ULL;
+    memset(this->stack, 0, sizeof(unsigned short) * 16);
+    memset(this->key, 0, sizeof(unsigned char) * 16);
+
+    // SUPER-CHIP and XO-CHIP start out as a plain 64x32 CHIP-8
+    memset(this->flags, 0, sizeof(this->flags));
+    memset(this->pattern, 0, sizeof(this->pattern));
+    memset(this->pad, 0, sizeof(this->pad));
+    this->pitch = 64;
+    this->hires = 0;
+    this->planes = 1;
+
+    // Program counter starts at 0x200
+    this->PC = 0x0200;
+
+    this->drawFlag = false;
+    this->isBeep = false;
+    this->idleInstructions = 0;
+    this->unknownOpcodes = 0;
+    this->lastUnknownOpcode = 0;
+    this->frameProgress = 0;
+
+    // Load fontset to memory (80 bytes)
+    memcpy(this->memory, chip8_fontset, sizeof(unsigned char) * 80);
+    memcpy(this->memory + 0x50, chip8_fontset_hires, sizeof(unsigned char) * 160);
+
+    invalidateAll();
+}
+
+// Per-instance xorshift32 generator for CXNN, so instances never share state
+void chip8::seedRandom(uint32_t seed)
+{
+    // Zero is a fixed point of xorshift
+    rng = (seed != 0) ? seed : 0x2545F491u;
+}
+
+uint32_t chip8::nextRandom()
+{
+    uint32_t x = rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng = x;
+    return x;
+}
+
+// Loads a ROM image that is already in memory
+bool chip8::loadGame(const unsigned char *data, size_t size)
+{
+    if (size > CHIP8_ROM_MAX_SIZE) {
+        return false;
+    }
+
+    memcpy(&memory[0] + 0x0200, data, size);
+    uint64_t hash = chip8_rom_hash(data, size);
+    quirks = chip8_rom_quirks(hash, size);
+    native = chip8_native_find(hash);
+    invalidateAll();
+
+    return true;
+}
+
+// Files that do not fit in memory are rejected before anything is loaded
+bool chip8::loadGame(const char *filename)
+{
+    std::vector<unsigned char> rom;
+    return chip8_read_rom(filename, rom) && loadGame(&rom[0], rom.size());
+}
+
+void chip8::saveState(chip8_state &state) const
+{
+    state = *static_cast<const chip8_state *>(this);
+}
+
+// Restores a machine saved by saveState(); caches and the display start over
+bool chip8::loadState(const chip8_state &state)
+{
+    if (!chip8_state_valid(state)) {
+        return false;
+    }
+    *static_cast<chip8_state *>(this) = state;
+
+    dirtyRows = ~0ULL;
+    drawFlag = true;
+    isBeep = false;
+    frameProgress = 0;
+    invalidateAll();
+    return true;
+}
+
+bool chip8::saveState(const char *filename) const
+{
+    return chip8_state_file::write(filename, *this);
+}
+
+bool chip8::loadState(const char *filename)
+{
+    chip8_state_file file;
+    if (!file.open(filename)) {
+        return false;
+    }
+
+    return loadState(*file.state());
+}
+
+// Runs one instruction. Timers are left alone, see runFrame()
+void chip8::emulateCycle()
+{
+    emulateCycles(1);
+}
+
+void chip8::emulateCycles(unsigned long long count)
+{
+    runCycles(count);
+}
+
+// Fewer than count only if the debugger stopped the machine
+unsigned long long chip8::runCycles(unsigned long long count)
+{
+    debugStop = false;
+    if (count == 0) {
+        return 0;
+    }
+
+    int hooks = 0;
+    if (!profile.empty()) {
+        profile[0].instructions += count;
+        hooks |= HOOK_PROFILE;
+    }
+    if (trace != NULL) {
+        hooks |= HOOK_TRACE;
+    }
+    if (debugger != NULL && debugger->isActive()) {
+        hooks |= HOOK_DEBUG;
+    }
+
+    // Breakpoints need every instruction address, so debugging always interprets;
+    // recompiled code has no hooks at all
+    if (engine == ENGINE_BLOCKS && !(hooks & HOOK_DEBUG)) {
+        executeQuirks<ENGINE_BLOCKS>(hooks, count);
+    } else if (engine == ENGINE_NATIVE && hooks == 0 && getNative() != NULL) {
+        executeNative(count);
+    } else {
+        executeQuirks<ENGINE_INTERPRETER>(hooks, count);
+    }
+
+    if (!debugStop) {
+        return count;
+    }
+    if (!profile.empty()) {
+        profile[0].instructions -= count - debugRan;
+    }
+    return debugRan;
+}
+
+// Each quirk profile is a separate instantiation of the engines
+template <int Mode>
+void chip8::executeQuirks(int hooks, unsigned long long count)
+{
+    switch (quirks)
+    {
+    case QUIRKS_VIP:
+        executeWith<Mode, chip8_quirks_vip>(hooks, count);
+        break;
+    case QUIRKS_CHIP48:
+        executeWith<Mode, chip8_quirks_chip48>(hooks, count);
+        break;
+    case QUIRKS_SCHIP:
+        executeWith<Mode, chip8_quirks_schip>(hooks, count);
+        break;
+    case QUIRKS_XOCHIP:
+        executeWith<Mode, chip8_quirks_xochip>(hooks, count);
+        break;
+    default:
+        executeWith<Mode, chip8_quirks_modern>(hooks, count);
+        break;
+    }
+}
+
+// Picks the instantiation with exactly the enabled hooks, so unused ones cost nothing
+template <int Mode, class Quirks>
+void chip8::executeWith(int hooks, unsigned long long count)
+{
+    switch (hooks)
+    {
+    case 0:
+        execute<Mode, 0, Quirks>(count);
+        break;
+    case HOOK_PROFILE:
+        execute<Mode, HOOK_PROFILE, Quirks>(count);
+        break;
+    case HOOK_TRACE:
+        execute<Mode, HOOK_TRACE, Quirks>(count);
+        break;
+    case HOOK_PROFILE | HOOK_TRACE:
+        execute<Mode, HOOK_PROFILE | HOOK_TRACE, Quirks>(count);
+        break;
+
+    // The debugger is only compiled into the interpreter
+    case HOOK_DEBUG:
+        execute<ENGINE_INTERPRETER, HOOK_DEBUG, Quirks>(count);
+        break;
+    case HOOK_DEBUG | HOOK_PROFILE:
+        execute<ENGINE_INTERPRETER, HOOK_DEBUG | HOOK_PROFILE, Quirks>(count);
+        break;
+    case HOOK_DEBUG | HOOK_TRACE:
+        execute<ENGINE_INTERPRETER, HOOK_DEBUG | HOOK_TRACE, Quirks>(count);
+        break;
+    default:
+        execute<ENGINE_INTERPRETER, HOOK_DEBUG | HOOK_PROFILE | HOOK_TRACE, Quirks>(count);
+        break;
+    }
+}
+
+// Instructions that changed the screen, for chip8_profile::frameDraws
+static unsigned long long drawOps(const chip8_profile &p)
+{
+    return p.ops[chip8::OP_00E0] + p.ops[chip8::OP_DXYN] + p.ops[chip8::OP_00CN] + p.ops[chip8::OP_00DN]
+            + p.ops[chip8::OP_00FB] + p.ops[chip8::OP_00FC];
+}
+
+// Runs one 60 Hz frame: cyclesPerFrame instructions, then one timer tick.
+// If the debugger stops the machine first, the rest of the frame is left for the next call.
+chip8_frame chip8::runFrame()
+{
+    chip8_frame frame;
+
+    bool wasDrawn = drawFlag;
+    bool soundBefore = sound_timer > 0;
+
+    chip8_profile *p = profile.empty() ? NULL : &profile[0];
+    unsigned long long drawsBefore = p ? drawOps(*p) : 0;
+    unsigned long long instructionsBefore = p ? p->instructions : 0;
+
+    drawFlag = false;
+    soundEdges = 0;
+    unsigned long long ran = runCycles(frameProgress < cyclesPerFrame ? cyclesPerFrame - frameProgress : 0);
+    if (debugStop) {
+        frameProgress += (unsigned) ran;
+
+        frame.instructions = ran;
+        frame.drawn = drawFlag;
+        frame.beepStarted = !soundBefore && sound_timer > 0;
+        frame.beepStopped = soundBefore && sound_timer == 0;
+        frame.stopped = true;
+        frame.soundOn = soundBefore;
+        frame.soundEdges = 0;
+
+        drawFlag |= wasDrawn;
+        isBeep |= frame.beepStarted;
+        return frame;
+    }
+    frameProgress = 0;
+    bool soundDuring = sound_timer > 0;
+    tickTimers();
+    bool soundAfter = sound_timer > 0;
+
+    if (p != NULL) {
+        p->frameInstructions = (unsigned) (p->instructions - instructionsBefore);
+        p->frameDraws = (unsigned) (drawOps(*p) - drawsBefore);
+        ++p->frames;
+    }
+
+    frame.instructions = ran;
+    frame.drawn = drawFlag;
+    frame.beepStarted = !soundBefore && soundDuring;
+    frame.beepStopped = (soundBefore && !soundDuring) || (soundDuring && !soundAfter);
+    frame.stopped = false;
+    frame.soundOn = soundBefore;
+    frame.soundEdges = soundEdges;
+    memcpy(frame.soundEdgeAt, soundEdgeAt, sizeof(frame.soundEdgeAt));
+
+    drawFlag |= wasDrawn;
+    isBeep |= frame.beepStarted;
+
+    return frame;
+}
+
+// Runs several frames back to back and merges their results
+chip8_frame chip8::runFrames(unsigned frames)
+{
+    chip8_frame total;
+    total.instructions = 0;
+    total.drawn = false;
+    total.beepStarted = false;
+    total.beepStopped = false;
+    total.stopped = false;
+    total.soundOn = false;
+    total.soundEdges = 0;
+
+    for (unsigned f = 0; f < frames && !total.stopped; ++f)
+    {
+        chip8_frame frame = runFrame();
+        total.instructions += frame.instructions;
+        total.drawn |= frame.drawn;
+        total.beepStarted |= frame.beepStarted;
+        total.beepStopped |= frame.beepStopped;
+        total.stopped = frame.stopped;
+    }
+
+    return total;
+}
+
+void chip8::setCyclesPerFrame(unsigned cycles)
+{
+    cyclesPerFrame = cycles;
+}
+
+unsigned chip8::getCyclesPerFrame() const
+{
+    return cyclesPerFrame;
+}
+
+void chip8::setEngine(Engine engine)
+{
+    this->engine = engine;
+
+    if (engine == ENGINE_BLOCKS) {
+        blocks.resize(4096);
+        codeMap.resize(4096);
+        blockCode.reserve(CHIP8_BLOCK_CODE_LIMIT + CHIP8_BLOCK_MAX_LENGTH);
+    } else {
+        std::vector<chip8_block>().swap(blocks);
+        std::vector<unsigned short>().swap(codeMap);
+        std::vector<chip8_insn>().swap(blockCode);
+    }
+    flushBlocks();
+
+    if (engine == ENGINE_NATIVE) {
+        nativeBlocks.resize(4096);
+        nativeCover.resize(4096);
+    } else {
+        std::vector<const chip8_native_block *>().swap(nativeBlocks);
+        std::vector<unsigned char>().swap(nativeCover);
+    }
+    attachNative();
+}
+
+chip8::Engine chip8::getEngine() const
+{
+    return engine;
+}
+
+const char *chip8::engineName(Engine engine)
+{
+    static const char *const names[] = { "interpreter", "blocks", "native" };
+    return (engine <= ENGINE_NATIVE) ? names[engine] : "?";
+}
+
+const chip8_native_program *chip8::getNative() const
+{
+    return (native != NULL && native->quirks == getQuirks()) ? native : NULL;
+}
+
+void chip8::setQuirks(Quirks quirks)
+{
+    this->quirks = (quirks < QUIRKS_COUNT) ? quirks : QUIRKS_MODERN;
+}
+
+chip8::Quirks chip8::getQuirks() const
+{
+    return (quirks < QUIRKS_COUNT) ? (Quirks) quirks : QUIRKS_MODERN;
+}
+
+const char *chip8::quirksName(Quirks quirks)
+{
+    static const char *const names[QUIRKS_COUNT] = { "modern", "vip", "chip48", "schip", "xochip" };
+    return (quirks < QUIRKS_COUNT) ? names[quirks] : "?";
+}
+
+void chip8::setIdleSkipping(bool enabled)
+{
+    idleSkipping = enabled;
+}
+
+bool chip8::getIdleSkipping() const
+{
+    return idleSkipping;
+}
+
+unsigned long long chip8::getIdleInstructions() const
+{
+    return idleInstructions;
+}
+
+unsigned long long chip8::getUnknownOpcodes() const
+{
+    return unknownOpcodes;
+}
+
+unsigned short chip8::getLastUnknownOpcode() const
+{
+    return lastUnknownOpcode;
+}
+
+void chip8::decodedUnknown(unsigned short opcode)
+{
+    ++unknownOpcodes;
+    lastUnknownOpcode = opcode;
+}
+
+// Enabling starts from zeroed counters; disabling frees them
+void chip8::setProfiling(bool enabled)
+{
+    if (enabled) {
+        profile.resize(1);
+        resetProfile();
+    } else {
+        std::vector<chip8_profile>().swap(profile);
+    }
+}
+
+bool chip8::getProfiling() const
+{
+    return !profile.empty();
+}
+
+void chip8::resetProfile()
+{
+    if (!profile.empty()) {
+        memset(&profile[0], 0, sizeof(chip8_profile));
+    }
+}
+
+const chip8_profile *chip8::getProfile() const
+{
+    return profile.empty() ? NULL : &profile[0];
+}
+
+void chip8::setTrace(chip8_trace *trace)
+{
+    this->trace = trace;
+}
+
+chip8_trace *chip8::getTrace() const
+{
+    return trace;
+}
+
+void chip8::setDebugger(chip8_debugger *debugger)
+{
+    this->debugger = debugger;
+}
+
+chip8_debugger *chip8::getDebugger() const
+{
+    return debugger;
+}
+
+// Before each instruction while debugging: true stops the machine with pc not run yet
+bool chip8::debugCheck(unsigned short pc)
+{
+    chip8_debugger &d = *debugger;
+
+    // The instruction that just ran wrote a watched location or register
+    if (d.written) {
+        d.written = false;
+        d.stopAddress = d.writtenAt;
+        d.stopped(chip8_debugger::STOP_MEMORY, pc);
+        return true;
+    }
+    if (d.registerCount != 0) {
+        for (int r = 0; r < CHIP8_DEBUG_REGISTERS; ++r)
+        {
+            if (d.registerWatch[r] < CHIP8_DEBUG_ANY_VALUE) {
+                continue;
+            }
+            int value = (r == CHIP8_DEBUG_REG_I) ? I : V[r];
+            int last = d.registerLast[r];
+            d.registerLast[r] = value;
+            if (last >= 0 && value != last && (d.registerWatch[r] == CHIP8_DEBUG_ANY_VALUE || d.registerWatch[r] == value)) {
+                d.stopRegister = r;
+                d.stopped(chip8_debugger::STOP_REGISTER, pc);
+                return true;
+            }
+        }
+    }
+
+    // Resuming runs the instruction the machine stopped at without hitting its breakpoint again
+    bool resumed = d.resuming && d.resumePC == pc;
+    d.resuming = false;
+    if (!resumed && ((d.breakpoints[(pc & 0x0FFF) >> 6] >> (pc & 63)) & 1)) {
+        d.stopped(chip8_debugger::STOP_BREAKPOINT, pc);
+        return true;
+    }
+
+    if (d.steppingOver && pc == d.overPC && sp <= d.overSP) {
+        d.steppingOver = false;
+        d.stopped(chip8_debugger::STOP_STEP, pc);
+        return true;
+    }
+    if (d.stepping) {
+        if (d.steps == 0) {
+            d.stepping = false;
+            d.stopped(chip8_debugger::STOP_STEP, pc);
+            return true;
+        }
+        --d.steps;
+    }
+    return false;
+}
+
+// After a store of len bytes at addr while debugging; unwatched pages cost two lookups
+void chip8::debugWrite(unsigned addr, unsigned len, unsigned mask)
+{
+    chip8_debugger &d = *debugger;
+    unsigned first = addr & mask;
+    unsigned last = (addr + len - 1) & mask;
+    if (!d.watchedPages[first >> 8] && !d.watchedPages[last >> 8]) {
+        return;
+    }
+
+    for (unsigned i = 0; i < len; ++i)
+    {
+        unsigned a = (addr + i) & mask;
+        for (unsigned r = 0; r < d.rangeCount; ++r)
+        {
+            if (a >= d.ranges[r].addr && a < (unsigned) d.ranges[r].addr + d.ranges[r].length) {
+                d.written = true;
+                d.writtenAt = (unsigned short) a;
+                return;
+            }
+        }
+    }
+}
+
+size_t chip8_profile_hottest(const chip8_profile &profile, unsigned short *addr, size_t max)
+{
+    size_t found = 0;
+    for (int pc = 0; pc < 4096; ++pc)
+    {
+        unsigned long long hits = profile.pc[pc];
+        if (hits == 0 || (found == max && hits <= profile.pc[addr[found - 1]])) {
+            continue;
+        }
+
+        // Insertion into the sorted list, dropping the coldest when it is full
+        size_t i = (found < max) ? found++ : found - 1;
+        while (i > 0 && profile.pc[addr[i - 1]] < hits)
+        {
+            addr[i] = addr[i - 1];
+            --i;
+        }
+        addr[i] = (unsigned short) pc;
+    }
+    return found;
+}
+
+/*
+ * Handlers are shared by both engines and always keep pc up to date.
+ * With GCC they are threaded through a label table (computed goto),
+ * otherwise through a switch.
+ *
+ * ENGINE_INTERPRETER fetches decoded[pc] after every instruction.
+ * ENGINE_BLOCKS walks a compiled block and only looks up the next block
+ * when it runs off the end.
+ *
+ * Timers are not touched here, runFrame() ticks them once per frame.
+ *
+ * Hooks instantiations count (HOOK_PROFILE) and record (HOOK_TRACE) every
+ * instruction as it is dispatched; both engines keep pc on the instruction
+ * being dispatched. HOOK_DEBUG asks the debugger first and leaves the batch
+ * early, with PC on that instruction, when it says stop.
+ */
+#if defined(__GNUC__)
+#define CHIP8_COMPUTED_GOTO
+#endif
+
+#ifdef CHIP8_COMPUTED_GOTO
+#define CASE(op)        L_##op
+#define DISPATCH()      goto *labels[in->op]
+#else
+#define CASE(op)        case op
+#define DISPATCH()      goto dispatch
+#endif
+
+// Instructions of the batch after the one being run
+#define LEFT()          ((Mode == ENGINE_INTERPRETER) ? count - n - 1 : count - n)
+
+// Index within the batch of the instruction being run
+#define POSITION()      ((Mode == ENGINE_INTERPRETER) ? n : n - (unsigned long long) (blockEnd - in))
+
+#define HOOKS()                                                     \
+    if ((Hooks & HOOK_DEBUG) && debugCheck(pc)) {                   \
+        goto stopped;                                               \
+    }                                                               \
+    if (Hooks & HOOK_PROFILE) {                                     \
+        ++prof->ops[in->op];                                        \
+        ++prof->pc[pc & 0x0FFF];                                    \
+    }                                                               \
+    if (Hooks & HOOK_TRACE) {                                       \
+        if (traced != NULL) {                                       \
+            traced->value = V[traced->reg & 0x0F];                  \
+        }                                                           \
+        traced = &traceRing[traceCount & traceMask];                \
+        traceInsn(*traced, *in, pc, I, V);                          \
+        trace->publish(++traceCount);                               \
+    }
+
+// Which register an op writes, for the trace: 1 is VX, 2 is VF
+static const unsigned char traceWrites[chip8::OP_COUNT] = {
+    0, 0,
+    0, 0, 0,
+    0, 0, 0, 0, 0, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+    0, 0, 0, 1, 2, 0, 0,
+    1, 1, 0, 0, 2, 0, 0, 0, 1,
+    0, 0, 0, 0, 0, 0, 0, 0, 1,
+    0, 0, 1, 0, 0, 0, 0
+};
+
+// Bytes a taken skip moves pc by; with LONG_SKIP it steps over all of F000 NNNN
+template <class Quirks>
+static inline unsigned short skipLength(const unsigned char *memory, unsigned short pc)
+{
+    if (Quirks::LONG_SKIP && memory[(pc + 2) & 0x0FFF] == 0xF0 && memory[(pc + 3) & 0x0FFF] == 0x00) {
+        return 6;
+    }
+    return 4;
+}
+
+static inline unsigned char traceReg(const chip8_insn &in)
+{
+    unsigned char writes = traceWrites[in.op];
+    return (writes == 1) ? in.x : (writes == 2) ? 0xF : CHIP8_TRACE_NO_REG;
+}
+
+// Fills in the entry for the instruction about to run; value is completed after it ran
+static inline void traceInsn(chip8_trace_entry &e, const chip8_insn &in,
+                             unsigned short pc, unsigned short I, const unsigned char *V)
+{
+    e.pc = pc & 0x0FFF;
+    e.opcode = in.opcode;
+    e.I = I;
+    e.reg = traceReg(in);
+    e.value = V[e.reg & 0x0F];
+}
+
+template <int Mode, int Hooks, class Quirks>
+void chip8::execute(unsigned long long count)
+{
+    static_assert(!(Hooks & HOOK_DEBUG) || Mode == ENGINE_INTERPRETER, "the debugger checks every instruction address");
+
+#ifdef CHIP8_COMPUTED_GOTO
+    static const void *labels[OP_COUNT] = {
+        &&L_OP_DECODE, &&L_OP_UNKNOWN,
+        &&L_OP_00E0, &&L_OP_00EE, &&L_OP_0NNN,
+        &&L_OP_1NNN, &&L_OP_2NNN, &&L_OP_3XNN, &&L_OP_4XNN, &&L_OP_5XY0, &&L_OP_6XNN, &&L_OP_7XNN,
+        &&L_OP_8XY0, &&L_OP_8XY1, &&L_OP_8XY2, &&L_OP_8XY3, &&L_OP_8XY4, &&L_OP_8XY5, &&L_OP_8XY6, &&L_OP_8XY7, &&L_OP_8XYE, &&L_OP_8XYU,
+        &&L_OP_9XY0, &&L_OP_ANNN, &&L_OP_BNNN, &&L_OP_CXNN, &&L_OP_DXYN, &&L_OP_EX9E, &&L_OP_EXA1,
+        &&L_OP_FX07, &&L_OP_FX0A, &&L_OP_FX15, &&L_OP_FX18, &&L_OP_FX1E, &&L_OP_FX29, &&L_OP_FX33, &&L_OP_FX55, &&L_OP_FX65,
+        &&L_OP_00CN, &&L_OP_00FB, &&L_OP_00FC, &&L_OP_00FD, &&L_OP_00FE, &&L_OP_00FF, &&L_OP_FX30, &&L_OP_FX75, &&L_OP_FX85,
+        &&L_OP_00DN, &&L_OP_5XY2, &&L_OP_5XY3, &&L_OP_F000, &&L_OP_FN01, &&L_OP_F002, &&L_OP_FX3A
+    };
+#endif
+
+    // PC lives in a register for the whole batch and is written back at the end
+    unsigned short pc = PC;
+    unsigned long long n = 0;
+
+    const chip8_insn *in;
+    const chip8_insn *blockEnd = NULL;
+    chip8_profile *prof = (Hooks & HOOK_PROFILE) ? &profile[0] : NULL;
+    chip8_trace_entry *traced = NULL;
+    chip8_trace_entry *traceRing = (Hooks & HOOK_TRACE) ? trace->ring() : NULL;
+    uint64_t traceMask = (Hooks & HOOK_TRACE) ? trace->ringMask() : 0;
+    uint64_t traceCount = (Hooks & HOOK_TRACE) ? trace->written() : 0;
+
+    if (Mode == ENGINE_BLOCKS) {
+        goto enter_block;
+    }
+
+    // Fetch decoded instruction
+    in = &decoded[pc & 0x0FFF];
+    HOOKS();
+
+#ifndef CHIP8_COMPUTED_GOTO
+dispatch:
+    switch (in->op)
+    {
+#else
+    DISPATCH();
+    {
+#endif
+    // Not decoded yet: decode in place and run it. Only seen by the interpreter,
+    // compiled blocks are decoded up front.
+    CASE(OP_DECODE):
+    {
+        unsigned short opcode = (memory[pc & 0x0FFF] << 8) | memory[(pc + 1) & 0x0FFF];
+        decoded[pc & 0x0FFF] = decode(opcode);
+        if (in->op == OP_UNKNOWN || in->op == OP_8XYU) {
+            decodedUnknown(opcode);
+        }
+
+        // Hooks saw OP_DECODE on the way in; it is really the decoded instruction
+        if (Hooks & HOOK_PROFILE) {
+            --prof->ops[OP_DECODE];
+            ++prof->ops[in->op];
+        }
+        if (Hooks & HOOK_TRACE) {
+            traced->opcode = opcode;
+            traced->reg = traceReg(*in);
+            traced->value = V[traced->reg & 0x0F];
+        }
+    }
+    DISPATCH();
+
+    // Unknown opcode: stay on it
+    CASE(OP_UNKNOWN):
+        if (!Hooks && idleSkipping) {
+            goto idle;
+        }
+        goto next;
+
+    // 00E0: Clears the screen (the selected planes on XO-CHIP)
+    CASE(OP_00E0):
+        clearPlanes();
+        pc += 2;
+        goto next;
+
+    // 00CN: Scrolls the screen down N rows
+    CASE(OP_00CN):
+        scrollRows(in->nn & 0x0F);
+        pc += 2;
+        goto next;
+
+    // 00DN: Scrolls the screen up N rows
+    CASE(OP_00DN):
+        scrollRows(-(in->nn & 0x0F));
+        pc += 2;
+        goto next;
+
+    // 00FB: Scrolls the screen right by 4 pixels
+    CASE(OP_00FB):
+        scrollColumns(4);
+        pc += 2;
+        goto next;
+
+    // 00FC: Scrolls the screen left by 4 pixels
+    CASE(OP_00FC):
+        scrollColumns(-4);
+        pc += 2;
+        goto next;
+
+    // 00FD: Exits the interpreter: stay on it
+    CASE(OP_00FD):
+        if (!Hooks && idleSkipping) {
+            goto idle;
+        }
+        goto next;
+
+    // 00FE: Switches to 64x32 and clears the screen
+    CASE(OP_00FE):
+        setHires(false);
+        pc += 2;
+        goto next;
+
+    // 00FF: Switches to 128x64 and clears the screen
+    CASE(OP_00FF):
+        setHires(true);
+        pc += 2;
+        goto next;
+
+    // 00EE: Returns from a subroutine
+    CASE(OP_00EE):
+        pc = stack[--sp];
+        pc += 2;
+        goto next;
+
+    // 0NNN: Calls RCA 1802 program at address NNN. Not necessary for most ROMs
+    CASE(OP_0NNN):
+        // TODO
+        //pc += 2;
+        goto next;
+
+    // 1NNN: Jumps to address NNN
+    CASE(OP_1NNN):
+        if (!Hooks && idleSkipping && in->nnn <= pc && pc - in->nnn <= 8
+                && idleLoop<Quirks>(pc, in->nnn, LEFT())) {
+            goto idle;
+        }
+        pc = in->nnn;
+        goto next;
+
+    // 2NNN: Calls subroutine at NNN
+    CASE(OP_2NNN):
+        stack[sp++] = pc;
+        pc = in->nnn;
+        goto next;
+
+    // 3XNN: Skips the next instruction if VX equals NN
+    CASE(OP_3XNN):
+        pc += (V[in->x] == in->nn) ? skipLength<Quirks>(memory, pc) : 2;
+        goto next;
+
+    // 4XNN: Skips the next instruction if VX doesn't equal NN
+    CASE(OP_4XNN):
+        pc += (V[in->x] != in->nn) ? skipLength<Quirks>(memory, pc) : 2;
+        goto next;
+
+    // 5XY0: Skips the next instruction if VX equals VY
+    CASE(OP_5XY0):
+        pc += (V[in->x] == V[in->y]) ? skipLength<Quirks>(memory, pc) : 2;
+        goto next;
+
+    // 5XY2: Stores VX to VY (in either order) in memory starting at address I, I is unchanged
+    CASE(OP_5XY2):
+    {
+        int step = (in->x <= in->y) ? 1 : -1;
+        int length = (in->x <= in->y) ? in->y - in->x + 1 : in->x - in->y + 1;
+        for (int i = 0; i < length; ++i)
+        {
+            memory[(I + i) & Quirks::MEMORY_MASK] = V[in->x + i * step];
+        }
+        invalidate(I, length);
+        if (Hooks & HOOK_DEBUG) {
+            debugWrite(I, length, Quirks::MEMORY_MASK);
+        }
+        pc += 2;
+    }
+    goto next;
+
+    // 5XY3: Fills VX to VY (in either order) from memory starting at address I, I is unchanged
+    CASE(OP_5XY3):
+    {
+        int step = (in->x <= in->y) ? 1 : -1;
+        int length = (in->x <= in->y) ? in->y - in->x + 1 : in->x - in->y + 1;
+        for (int i = 0; i < length; ++i)
+        {
+            V[in->x + i * step] = memory[(I + i) & Quirks::MEMORY_MASK];
+        }
+        pc += 2;
+    }
+    goto next;
+
+    // 6XNN: Sets VX to NN
+    CASE(OP_6XNN):
+        V[in->x] = in->nn;
+        pc += 2;
+        goto next;
+
+    // 7XNN: Adds NN to VX
+    CASE(OP_7XNN):
+        V[in->x] += in->nn;
+        pc += 2;
+        goto next;
+
+    // 8XY0: Sets VX to the value of VY
+    CASE(OP_8XY0):
+        V[in->x] = V[in->y];
+        pc += 2;
+        goto next;
+
+    // 8XY1: Sets VX to VX or VY (and clears VF with VF_RESET)
+    CASE(OP_8XY1):
+        V[in->x] |= V[in->y];
+        if (Quirks::VF_RESET) {
+            V[0xF] = 0;
+        }
+        pc += 2;
+        goto next;
+
+    // 8XY2: Sets VX to VX and VY (and clears VF with VF_RESET)
+    CASE(OP_8XY2):
+        V[in->x] &= V[in->y];
+        if (Quirks::VF_RESET) {
+            V[0xF] = 0;
+        }
+        pc += 2;
+        goto next;
+
+    // 8XY3: Sets VX to VX xor VY (and clears VF with VF_RESET)
+    CASE(OP_8XY3):
+        V[in->x] ^= V[in->y];
+        if (Quirks::VF_RESET) {
+            V[0xF] = 0;
+        }
+        pc += 2;
+        goto next;
+
+    // 8XY4: Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't
+    CASE(OP_8XY4):
+        V[0xF] = V[in->x] > (0xFF - V[in->y]);
+        V[in->x] += V[in->y];
+        pc += 2;
+        goto next;
+
+    // 8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't
+    CASE(OP_8XY5):
+        V[0xF] = V[in->x] >= V[in->y];
+        V[in->x] -= V[in->y];
+        pc += 2;
+        goto next;
+
+    // 8XY6: Shifts VX (VY with SHIFT_VY) right by one into VX.
+    // VF is set to the value of the least significant bit before the shift
+    CASE(OP_8XY6):
+    {
+        unsigned char src = V[Quirks::SHIFT_VY ? in->y : in->x];
+        V[0xF] = src & 0x1;
+        V[in->x] = src >> 1;
+        pc += 2;
+    }
+    goto next;
+
+    // 8XY7: Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't
+    CASE(OP_8XY7):
+        V[0xF] = ( V[in->x] <= V[in->y] );	// VY-VX
+        V[in->x] = V[in->y] - V[in->x];
+        pc += 2;
+        goto next;
+
+    // 8XYE: Shifts VX (VY with SHIFT_VY) left by one into VX.
+    // VF is set to the value of the most significant bit before the shift
+    CASE(OP_8XYE):
+    {
+        unsigned char src = V[Quirks::SHIFT_VY ? in->y : in->x];
+        V[0xF] = src >> 7;
+        V[in->x] = src << 1;
+        pc += 2;
+    }
+    goto next;
+
+    // 8XY?: Unknown arithmetic opcode, skipped
+    CASE(OP_8XYU):
+        pc += 2;
+        goto next;
+
+    // 9XY0: Skips the next instruction if VX doesn't equal VY
+    CASE(OP_9XY0):
+        pc += (V[in->x] != V[in->y]) ? skipLength<Quirks>(memory, pc) : 2;
+        goto next;
+
+    // ANNN: Sets I to the address NNN
+    CASE(OP_ANNN):
+        I = in->nnn;
+        pc += 2;
+        goto next;
+
+    // BNNN: Jumps to the address NNN plus V0 (BXNN: XNN plus VX with JUMP_VX)
+    CASE(OP_BNNN):
+        pc = in->nnn + V[Quirks::JUMP_VX ? in->x : 0];
+        goto next;
+
+    // CXNN: Sets VX to the result of a bitwise and operation on a random number and NN
+    CASE(OP_CXNN):
+        V[in->x] = (nextRandom() % 0xFF) & in->nn;
+        pc += 2;
+        goto next;
+
+    // DXYN: Draws a sprite at (VX, VY), see drawSprite()
+    CASE(OP_DXYN):
+        drawSprite<Quirks>(*in);
+        pc += 2;
+        goto next;
+
+    // EX9E: Skips the next instruction if the key stored in VX is pressed.
+    CASE(OP_EX9E):
+        pc += (key[V[in->x] & 0xF] != 0) ? skipLength<Quirks>(memory, pc) : 2;
+        goto next;
+
+    // EXA1: Skips the next instruction if the key stored in VX isn't pressed.
+    CASE(OP_EXA1):
+        pc += (key[V[in->x] & 0xF] == 0) ? skipLength<Quirks>(memory, pc) : 2;
+        goto next;
+
+    // FX07: Sets VX to the value of the delay timer
+    CASE(OP_FX07):
+        V[in->x] = delay_timer;
+        pc += 2;
+        goto next;
+
+    // FX0A: A key press is awaited, and then stored in VX
+    CASE(OP_FX0A):
+    {
+        bool keyPress = false;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            if (key[i] != 0)
+            {
+                V[in->x] = i;
+                keyPress = true;
+            }
+        }
+
+        // If we didn't received a keypress, stay on this instruction and try again->
+        // Keys only change between batches, so the rest of this one can be skipped
+        if (keyPress) {
+            pc += 2;
+        } else if (!Hooks && idleSkipping) {
+            goto idle;
+        }
+    }
+    goto next;
+
+    // FX15: Sets the delay timer to VX
+    CASE(OP_FX15):
+        delay_timer = V[in->x];
+        pc += 2;
+        goto next;
+
+    // FX18: Sets the sound timer to VX
+    CASE(OP_FX18):
+        if ((sound_timer == 0) != (V[in->x] == 0)) {
+            soundEdge(POSITION());
+        }
+        sound_timer = V[in->x];
+        pc += 2;
+        goto next;
+
+    // FX1E: Adds VX to I
+    // With FX1E_CARRY, VF is set to 1 when range overflow (I+VX>0xFFF), and 0 when there isn't.
+    CASE(OP_FX1E):
+        if (Quirks::FX1E_CARRY) {
+            V[0xF] = (I + V[in->x]) > 0xFFF;
+        }
+        I += V[in->x];
+        pc += 2;
+        goto next;
+
+    // FX29: Sets I to the location of the sprite for the character in VX.
+    // Characters 0-F (in hexadecimal) are represented by a 4x5 font.
+    CASE(OP_FX29):
+        I = V[in->x] * 0x5;
+        pc += 2;
+        goto next;
+
+    // FX33: Stores the Binary-coded decimal representation of VX,
+    // with the most significant of three digits at the address in I,
+    // the middle digit at I plus 1, and the least significant digit at I plus 2.
+    CASE(OP_FX33):
+    {
+        unsigned char vx = V[in->x];
+        memory[I & Quirks::MEMORY_MASK]       =  vx / 100;
+        memory[(I + 1) & Quirks::MEMORY_MASK] = (vx / 10) % 10;
+        memory[(I + 2) & Quirks::MEMORY_MASK] =  vx % 10;
+        invalidate(I, 3);
+        if (Hooks & HOOK_DEBUG) {
+            debugWrite(I, 3, Quirks::MEMORY_MASK);
+        }
+        pc += 2;
+    }
+    goto next;
+
+    // FX55: Stores V0 to VX in memory starting at address I
+    CASE(OP_FX55):
+        for (int i = 0; i <= in->x; ++i)
+        {
+            memory[(I + i) & Quirks::MEMORY_MASK] = V[i];
+        }
+        invalidate(I, in->x + 1);
+        if (Hooks & HOOK_DEBUG) {
+            debugWrite(I, in->x + 1, Quirks::MEMORY_MASK);
+        }
+        // On the original interpreter, when the operation is done, I = I + X + 1.
+        I += (Quirks::LOAD_STORE_I == 2) ? in->x + 1 : (Quirks::LOAD_STORE_I == 1) ? in->x : 0;
+        pc += 2;
+        goto next;
+
+    // FX65: Fills V0 to VX with values from memory starting at address I
+    CASE(OP_FX65):
+        for (int i = 0; i <= in->x; ++i)
+        {
+            V[i] = memory[(I + i) & Quirks::MEMORY_MASK];
+        }
+        // On the original interpreter, when the operation is done, I = I + X + 1.
+        I += (Quirks::LOAD_STORE_I == 2) ? in->x + 1 : (Quirks::LOAD_STORE_I == 1) ? in->x : 0;
+        pc += 2;
+        goto next;
+
+    // FX30: Sets I to the 8x10 sprite for the character in VX
+    CASE(OP_FX30):
+        I = 0x50 + (V[in->x] & 0x0F) * 10;
+        pc += 2;
+        goto next;
+
+    // FX75: Stores V0 to VX in the RPL flags
+    CASE(OP_FX75):
+        memcpy(flags, V, in->x + 1);
+        pc += 2;
+        goto next;
+
+    // FX85: Fills V0 to VX from the RPL flags
+    CASE(OP_FX85):
+        memcpy(V, flags, in->x + 1);
+        pc += 2;
+        goto next;
+
+    // F000 NNNN: Sets I to the 16-bit address in the next two bytes
+    CASE(OP_F000):
+        I = (memory[(pc + 2) & 0x0FFF] << 8) | memory[(pc + 3) & 0x0FFF];
+        pc += 4;
+        goto next;
+
+    // FN01: Selects the planes that are drawn, cleared and scrolled
+    CASE(OP_FN01):
+        planes = in->x & 0x03;
+        pc += 2;
+        goto next;
+
+    // F002: Loads the 16-byte audio pattern from memory starting at address I
+    CASE(OP_F002):
+        for (int i = 0; i < 16; ++i)
+        {
+            pattern[i] = memory[(I + i) & Quirks::MEMORY_MASK];
+        }
+        pc += 2;
+        goto next;
+
+    // FX3A: Sets the audio pattern pitch to VX
+    CASE(OP_FX3A):
+        pitch = V[in->x];
+        pc += 2;
+        goto next;
+    }
+
+next:
+    if (Mode == ENGINE_INTERPRETER) {
+        if (++n == count) {
+            goto done;
+        }
+        in = &decoded[pc & 0x0FFF];
+        HOOKS();
+        DISPATCH();
+    }
+
+    if (++in != blockEnd) {
+        HOOKS();
+        DISPATCH();
+    }
+
+    if (n == count) {
+        goto done;
+    }
+
+enter_block:
+    {
+        // Look up (or compile) the block at pc and run as much of it as the budget allows
+        const chip8_block *block = &blocks[pc & 0x0FFF];
+        if (block->code == NULL) {
+            block = &compileBlock(pc & 0x0FFF);
+        }
+
+        in = block->code;
+        if (block->length <= count - n) {
+            blockEnd = in + block->length;
+            n += block->length;
+        } else {
+            blockEnd = in + (count - n);
+            n = count;
+        }
+    }
+    HOOKS();
+    DISPATCH();
+
+    // Only reached without hooks: the rest of the batch would spin in place,
+    // and pc (plus anything the loop writes) already holds where it would end
+idle:
+    idleInstructions += LEFT();
+    goto done;
+
+    // Only reached with the debugger: the instruction at pc has not run
+stopped:
+    debugStop = true;
+    debugRan = n;
+
+done:
+    if ((Hooks & HOOK_TRACE) && traced != NULL) {
+        traced->value = V[traced->reg & 0x0F];
+    }
+    PC = pc;
+}
+
+#undef CASE
+#undef DISPATCH
+#undef LEFT
+#undef POSITION
+#undef HOOKS
+
+// Whether a skip instruction would skip if it ran now
+bool chip8::skipTaken(const chip8_insn &in) const
+{
+    switch (in.op)
+    {
+    case OP_3XNN: return V[in.x] == in.nn;
+    case OP_4XNN: return V[in.x] != in.nn;
+    case OP_5XY0: return V[in.x] == V[in.y];
+    case OP_9XY0: return V[in.x] != V[in.y];
+    case OP_EX9E: return key[V[in.x] & 0xF] != 0;
+    case OP_EXA1: return key[V[in.x] & 0xF] == 0;
+    }
+    return false;
+}
+
+static inline bool isSkip(unsigned char op)
+{
+    return op == chip8::OP_3XNN || op == chip8::OP_4XNN || op == chip8::OP_5XY0
+        || op == chip8::OP_9XY0 || op == chip8::OP_EX9E || op == chip8::OP_EXA1;
+}
+
+/*
+ * Recognizes the jump at pc back to loop as a wait that cannot end before
+ * the next timer tick or key change, i.e. before the batch is over:
+ *   loop: 1NNN loop                        jump to self
+ *   loop: skip; 1NNN loop                  polling keys or registers
+ *   loop: FX07; skip; 1NNN loop            polling the delay timer
+ *   loop: 6XNN; skip; 1NNN loop            polling key NN
+ * Skips only read registers and keys, and FX07/6XNN load the same value
+ * on every pass, so if one more pass comes back here so does every pass
+ * until the batch ends. Then pc and VX are set to where the remaining
+ * left instructions would have left them, and true is returned.
+ */
+template <class Quirks>
+bool chip8::idleLoop(unsigned short &pc, unsigned short loop, unsigned long long left)
+{
+    if (loop == pc) {
+        return true;
+    }
+
+    const chip8_insn &first = decoded[loop & 0x0FFF];
+    if (isSkip(first.op)) {
+        unsigned short after = loop + (skipTaken(first) ? skipLength<Quirks>(memory, loop) : 2);
+        if (after != pc) {
+            return false;
+        }
+
+        unsigned short path[2] = { loop, pc };
+        pc = path[left % 2];
+        return true;
+    }
+
+    const chip8_insn &test = decoded[(loop + 2) & 0x0FFF];
+    if ((first.op != OP_FX07 && first.op != OP_6XNN) || !isSkip(test.op)) {
+        return false;
+    }
+
+    unsigned char saved = V[first.x];
+    V[first.x] = (first.op == OP_FX07) ? delay_timer : first.nn;
+    bool taken = skipTaken(test);
+    unsigned short after = loop + 2 + (taken ? skipLength<Quirks>(memory, loop + 2) : 2);
+    if (after != pc) {
+        V[first.x] = saved;
+        return false;
+    }
+
+    if (left == 0) {
+        V[first.x] = saved;
+    }
+    unsigned short path[3] = { loop, (unsigned short) (loop + 2), pc };
+    pc = path[left % 3];
+    return true;
+}
+
+// Notes FX18 starting or stopping the tone. When the frame is full the
+// previous edge is dropped along with this one, so on/off still comes out right.
+void chip8::soundEdge(unsigned long long at)
+{
+    if (soundEdges == CHIP8_SOUND_EDGES) {
+        --soundEdges;
+        return;
+    }
+    soundEdgeAt[soundEdges++] = (unsigned) at;
+}
+
+// Decrements both timers, called at 60 Hz
+void chip8::tickTimers()
+{
+    if (delay_timer > 0)
+    {
+        --delay_timer;
+    }
+
+    if (sound_timer > 0)
+    {
+        --sound_timer;
+    }
+}
+
+chip8_insn chip8::decode(unsigned short opcode)
+{
+    chip8_insn in;
+    in.opcode = opcode;
+    in.nnn = opcode & 0x0FFF;
+    in.x = (opcode & 0x0F00) >> 8;
+    in.y = (opcode & 0x00F0) >> 4;
+    in.nn = opcode & 0x00FF;
+    in.op = OP_UNKNOWN;
+
+    switch (opcode & 0xF000)
+    {
+    case 0x0000:
+        if (opcode == 0x00E0) {
+            in.op = OP_00E0;
+        } else if (opcode == 0x00EE) {
+            in.op = OP_00EE;
+        } else if ((opcode & 0xFFF0) == 0x00C0) {
+            in.op = OP_00CN;
+        } else if ((opcode & 0xFFF0) == 0x00D0) {
+            in.op = OP_00DN;
+        } else if (opcode == 0x00FB) {
+            in.op = OP_00FB;
+        } else if (opcode == 0x00FC) {
+            in.op = OP_00FC;
+        } else if (opcode == 0x00FD) {
+            in.op = OP_00FD;
+        } else if (opcode == 0x00FE) {
+            in.op = OP_00FE;
+        } else if (opcode == 0x00FF) {
+            in.op = OP_00FF;
+        } else {
+            in.op = OP_0NNN;
+        }
+        break;
+    case 0x1000: in.op = OP_1NNN; break;
+    case 0x2000: in.op = OP_2NNN; break;
+    case 0x3000: in.op = OP_3XNN; break;
+    case 0x4000: in.op = OP_4XNN; break;
+    case 0x5000:
+        switch (opcode & 0x000F)
+        {
+        case 0x0002: in.op = OP_5XY2; break;
+        case 0x0003: in.op = OP_5XY3; break;
+        default:     in.op = OP_5XY0; break;
+        }
+        break;
+    case 0x6000: in.op = OP_6XNN; break;
+    case 0x7000: in.op = OP_7XNN; break;
+    case 0x8000:
+        switch (opcode & 0x000F)
+        {
+        case 0x0000: in.op = OP_8XY0; break;
+        case 0x0001: in.op = OP_8XY1; break;
+        case 0x0002: in.op = OP_8XY2; break;
+        case 0x0003: in.op = OP_8XY3; break;
+        case 0x0004: in.op = OP_8XY4; break;
+        case 0x0005: in.op = OP_8XY5; break;
+        case 0x0006: in.op = OP_8XY6; break;
+        case 0x0007: in.op = OP_8XY7; break;
+        case 0x000E: in.op = OP_8XYE; break;
+        default:     in.op = OP_8XYU; break;
+        }
+        break;
+    case 0x9000: in.op = OP_9XY0; break;
+    case 0xA000: in.op = OP_ANNN; break;
+    case 0xB000: in.op = OP_BNNN; break;
+    case 0xC000: in.op = OP_CXNN; break;
+    case 0xD000: in.op = OP_DXYN; break;
+    case 0xE000:
+        if ((opcode & 0x00FF) == 0x009E) {
+            in.op = OP_EX9E;
+        } else if ((opcode & 0x00FF) == 0x00A1) {
+            in.op = OP_EXA1;
+        }
+        break;
+    case 0xF000:
+        switch (opcode & 0x00FF)
+        {
+        case 0x0007: in.op = OP_FX07; break;
+        case 0x000A: in.op = OP_FX0A; break;
+        case 0x0015: in.op = OP_FX15; break;
+        case 0x0018: in.op = OP_FX18; break;
+        case 0x001E: in.op = OP_FX1E; break;
+        case 0x0029: in.op = OP_FX29; break;
+        case 0x0033: in.op = OP_FX33; break;
+        case 0x0055: in.op = OP_FX55; break;
+        case 0x0065: in.op = OP_FX65; break;
+        case 0x0030: in.op = OP_FX30; break;
+        case 0x0075: in.op = OP_FX75; break;
+        case 0x0085: in.op = OP_FX85; break;
+        case 0x0001: in.op = OP_FN01; break;
+        case 0x003A: in.op = OP_FX3A; break;
+        case 0x0000:
+            if (opcode == 0xF000) {
+                in.op = OP_F000;
+            }
+            break;
+        case 0x0002:
+            if (opcode == 0xF002) {
+                in.op = OP_F002;
+            }
+            break;
+        }
+        break;
+    }
+
+    return in;
+}
+
+const char *chip8::opName(unsigned char op)
+{
+    static const char *const names[OP_COUNT] = {
+        "decode", "unknown",
+        "00E0", "00EE", "0NNN",
+        "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+        "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE", "8XY?",
+        "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1",
+        "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX33", "FX55", "FX65",
+        "00CN", "00FB", "00FC", "00FD", "00FE", "00FF", "FX30", "FX75", "FX85",
+        "00DN", "5XY2", "5XY3", "F000", "FN01", "F002", "FX3A"
+    };
+    return (op < OP_COUNT) ? names[op] : "?";
+}
+
+void chip8::invalidate(unsigned short addr, unsigned short len)
+{
+    bool blockHit = false;
+    bool haveBlocks = !codeMap.empty();
+
+    // An instruction at addr - 1 also covers the byte at addr
+    for (int i = (int) addr - 1; i < (int) addr + len; ++i)
+    {
+        decoded[i & 0x0FFF].op = OP_DECODE;
+        blockHit |= haveBlocks && codeMap[i & 0x0FFF] != 0;
+    }
+
+    // Blocks are indexed by masked address; a store through I near 0xFFF wraps to 0x000
+    if (blockHit) {
+        unsigned short start = addr & 0x0FFF;
+        invalidateBlocks(start, len);
+        if (start + len > 0x1000) {
+            invalidateBlocks(0, start + len - 0x1000);
+        }
+        if (start < 4) {
+            invalidateBlocks(start + 0x1000, len);  // Blocks running off the end of memory
+        }
+    }
+
+    // Recompiled blocks cover their bytes exactly
+    if (!nativeCover.empty()) {
+        for (int i = addr; i < (int) addr + len; ++i)
+        {
+            if (nativeCover[i & 0x0FFF] != 0) {
+                invalidateNative(i & 0x0FFF);
+            }
+        }
+    }
+}
+
+void chip8::invalidateAll()
+{
+    for (int i = 0; i < 4096; ++i)
+    {
+        decoded[i].op = OP_DECODE;
+    }
+    flushBlocks();
+    attachNative();
+}
+
+// Drops every compiled block that overlaps [addr - 1, addr + len); addr + len may pass 0x1000
+// to catch blocks whose last instruction wraps
+void chip8::invalidateBlocks(unsigned short addr, unsigned short len)
+{
+    int first = (int) addr - 1;
+    int last = (int) addr + len;
+
+    // Blocks are at most CHIP8_BLOCK_MAX_LENGTH instructions long, and F000 NNNN takes 4 bytes
+    int from = first - 4 * CHIP8_BLOCK_MAX_LENGTH;
+    if (from < 0) {
+        from = 0;
+    }
+
+    for (int start = from; start < last && start < 4096; ++start)
+    {
+        chip8_block &block = blocks[start];
+        if (block.code == NULL || block.end <= first) {
+            continue;
+        }
+
+        for (int i = start; i < block.end; ++i)
+        {
+            --codeMap[i & 0x0FFF];
+        }
+        block.code = NULL;
+    }
+}
+
+void chip8::flushBlocks()
+{
+    blockCode.clear();
+    if (!blocks.empty()) {
+        memset(&blocks[0], 0, sizeof(chip8_block) * blocks.size());
+        memset(&codeMap[0], 0, sizeof(unsigned short) * codeMap.size());
+    }
+}
+
+// Opcodes that can change control flow or write memory end a block
+static bool endsBlock(unsigned char op)
+{
+    switch (op)
+    {
+    case chip8::OP_UNKNOWN:
+    case chip8::OP_00EE:
+    case chip8::OP_0NNN:
+    case chip8::OP_1NNN:
+    case chip8::OP_2NNN:
+    case chip8::OP_3XNN:
+    case chip8::OP_4XNN:
+    case chip8::OP_5XY0:
+    case chip8::OP_9XY0:
+    case chip8::OP_BNNN:
+    case chip8::OP_EX9E:
+    case chip8::OP_EXA1:
+    case chip8::OP_FX0A:
+    case chip8::OP_FX33:
+    case chip8::OP_FX55:
+    case chip8::OP_00FD:
+    case chip8::OP_5XY2:
+        return true;
+    }
+    return false;
+}
+
+const chip8_block &chip8::compileBlock(unsigned short start)
+{
+    // Compiled code only grows when ROMs keep patching themselves; start over
+    if (blockCode.size() > CHIP8_BLOCK_CODE_LIMIT) {
+        flushBlocks();
+    }
+
+    chip8_block &block = blocks[start];
+    size_t first = blockCode.size();
+
+    unsigned short addr = start;
+    for (;;)
+    {
+        chip8_insn &in = decoded[addr];
+        if (in.op == OP_DECODE) {
+            unsigned short opcode = (memory[addr] << 8) | memory[(addr + 1) & 0x0FFF];
+            in = decode(opcode);
+            if (in.op == OP_UNKNOWN || in.op == OP_8XYU) {
+                decodedUnknown(opcode);
+            }
+        }
+
+        blockCode.push_back(in);
+        addr += (in.op == OP_F000) ? 4 : 2;     // Steps over the NNNN operand
+
+        if (endsBlock(in.op) || blockCode.size() - first == CHIP8_BLOCK_MAX_LENGTH || addr > 0x0FFE) {
+            break;
+        }
+    }
+
+    block.code = &blockCode[first];
+    block.end = addr;
+    block.length = (unsigned short) (blockCode.size() - first);
+
+    for (int i = start; i < block.end; ++i)
+    {
+        ++codeMap[i & 0x0FFF];
+    }
+
+    return block;
+}
+
+// Enables the recompiled blocks whose code is in memory just as it was compiled
+void chip8::attachNative()
+{
+    if (nativeBlocks.empty()) {
+        return;
+    }
+    memset(&nativeBlocks[0], 0, sizeof(nativeBlocks[0]) * nativeBlocks.size());
+    memset(&nativeCover[0], 0, nativeCover.size());
+    if (native == NULL) {
+        return;
+    }
+
+    for (size_t b = 0; b < native->count; ++b)
+    {
+        const chip8_native_block &block = native->blocks[b];
+        if (block.start < 0x0200 || block.end > 0x0200 + native->size || block.end > 4096
+                || memcmp(memory + block.start, native->image + (block.start - 0x0200), block.end - block.start) != 0) {
+            continue;
+        }
+
+        nativeBlocks[block.start] = &block;
+        for (int i = block.start; i < block.end; ++i)
+        {
+            ++nativeCover[i];
+        }
+    }
+}
+
+// Drops every recompiled block holding the byte at addr; the interpreter runs that code from now on
+void chip8::invalidateNative(unsigned short addr)
+{
+    // F000 NNNN is the longest instruction
+    int from = (int) addr - 4 * CHIP8_NATIVE_MAX_LENGTH;
+    if (from < 0) {
+        from = 0;
+    }
+
+    for (int start = from; start <= addr; ++start)
+    {
+        const chip8_native_block *block = nativeBlocks[start];
+        if (block == NULL || block->end <= addr) {
+            continue;
+        }
+
+        for (int i = block->start; i < block->end; ++i)
+        {
+            --nativeCover[i];
+        }
+        nativeBlocks[start] = NULL;
+        nativeStale = true;
+    }
+}
+
+void chip8::executeNative(unsigned long long count)
+{
+    switch (quirks)
+    {
+    case QUIRKS_VIP:
+        runNative<chip8_quirks_vip>(count);
+        break;
+    case QUIRKS_CHIP48:
+        runNative<chip8_quirks_chip48>(count);
+        break;
+    case QUIRKS_SCHIP:
+        runNative<chip8_quirks_schip>(count);
+        break;
+    case QUIRKS_XOCHIP:
+        runNative<chip8_quirks_xochip>(count);
+        break;
+    default:
+        runNative<chip8_quirks_modern>(count);
+        break;
+    }
+}
+
+/*
+ * ENGINE_NATIVE: runs the recompiled block at PC while there is one, and
+ * the interpreter one instruction at a time where there is none (code the
+ * recompiler could not see, such as BNNN targets, or code that was
+ * overwritten). A block stops early when the batch runs out, so batches
+ * end on exactly the same instruction as with the other engines.
+ */
+template <class Quirks>
+void chip8::runNative(unsigned long long count)
+{
+    chip8_native m(*this);
+    unsigned long long n = 0;
+
+    while (n < count)
+    {
+        const chip8_native_block *block = nativeBlocks[PC & 0x0FFF];
+        if (block == NULL) {
+            execute<ENGINE_INTERPRETER, 0, Quirks>(1);
+            ++n;
+            continue;
+        }
+
+        m.position = n;
+        m.left = count - n;
+        uint32_t exit = block->code(m);
+        PC = CHIP8_NATIVE_PC(exit);
+        if (exit & CHIP8_NATIVE_IDLE) {
+            break;
+        }
+        n += CHIP8_NATIVE_RAN(exit);
+    }
+}
+
+// One instruction of recompiled code that the interpreter runs for it
+bool chip8::nativeStep(unsigned short pc)
+{
+    PC = pc;
+    nativeStale = false;
+    executeQuirks<ENGINE_INTERPRETER>(0, 1);
+    return nativeStale;
+}
+
+// idleLoop() for recompiled code, which leaves the loop it looks at undecoded
+bool chip8::nativeIdle(unsigned short &pc, unsigned short loop, unsigned long long left)
+{
+    for (int i = 0; i < 4; i += 2)
+    {
+        chip8_insn &in = decoded[(loop + i) & 0x0FFF];
+        if (in.op == OP_DECODE) {
+            in = decode((memory[(loop + i) & 0x0FFF] << 8) | memory[(loop + i + 1) & 0x0FFF]);
+        }
+    }
+
+    switch (quirks)
+    {
+    case QUIRKS_VIP:
+        return idleLoop<chip8_quirks_vip>(pc, loop, left);
+    case QUIRKS_CHIP48:
+        return idleLoop<chip8_quirks_chip48>(pc, loop, left);
+    case QUIRKS_SCHIP:
+        return idleLoop<chip8_quirks_schip>(pc, loop, left);
+    case QUIRKS_XOCHIP:
+        return idleLoop<chip8_quirks_xochip>(pc, loop, left);
+    default:
+        return idleLoop<chip8_quirks_modern>(pc, loop, left);
+    }
+}
+
+// DXYN: Sprites stored in memory at location in index register (I), 8bits wide.
+// Wraps around the screen. If when drawn, clears a pixel, register VF is set to 1 otherwise it is zero.
+// All drawing is XOR drawing (i.e. it toggles the screen pixels).
+// Sprites are drawn starting at position (VX, VY).
+// N is the number of 8bit rows that need to be drawn.
+// If N is greater than 1, second line continues at position (VX, VY+1), and so on.
+// DXY0 draws a 16x16 sprite of two bytes per row. On XO-CHIP the sprite is
+// drawn into every selected plane, each plane's data following the last.
+//
+// Each sprite row is shifted into place on a packed screen row, so drawing
+// a row is one XOR per word and collision detection is one AND per word.
+// With CLIP_SPRITES, the parts past the right and bottom edges are dropped instead.
+template <class Quirks>
+void chip8::drawSprite(const chip8_insn &in)
+{
+    const int width = hires ? 128 : 64;
+    const int height = hires ? 64 : 32;
+    unsigned char x = V[in.x] & (width - 1);
+    unsigned char y = V[in.y] & (height - 1);
+    unsigned char n = in.nn & 0x0F;
+    int rows = (n != 0) ? n : 16;
+    int bytes = (n != 0) ? n : 32;          // Sprite data per plane
+    unsigned short addr = I;
+    uint64_t collision = 0;
+    uint64_t dirty = 0;
+
+    if (Quirks::CLIP_SPRITES && y + rows > height) {
+        rows = height - y;
+    }
+
+    for (int p = 0; p < CHIP8_PLANES; ++p)
+    {
+        if ((planes & (1 << p)) == 0) {
+            continue;
+        }
+        uint64_t *plane = gfx + p * CHIP8_FB_PLANE_WORDS;
+
+        for (int yline = 0; yline < rows; yline++)
+        {
+            // The sprite row at the left edge of a 64-bit row
+            uint64_t line;
+            if (n != 0) {
+                line = (uint64_t) memory[(addr + yline) & Quirks::MEMORY_MASK] << 56;
+            } else {
+                line = ((uint64_t) memory[(addr + 2 * yline) & Quirks::MEMORY_MASK] << 56)
+                     | ((uint64_t) memory[(addr + 2 * yline + 1) & Quirks::MEMORY_MASK] << 48);
+            }
+
+            int ry = (y + yline) & (height - 1);
+            uint64_t *row = plane + ry * CHIP8_FB_ROW_WORDS;
+            if (!hires) {
+                if (Quirks::CLIP_SPRITES) {
+                    line >>= x;
+                } else if (x != 0) {
+                    line = (line >> x) | (line << (64 - x));
+                }
+                collision |= row[0] & line;
+                row[0] ^= line;
+            } else {
+                // Shifted across both words; only x > 112 runs off the right edge
+                uint64_t left, right;
+                if (x < 64) {
+                    left = line >> x;
+                    right = (x != 0) ? line << (64 - x) : 0;
+                } else {
+                    right = line >> (x - 64);
+                    left = (!Quirks::CLIP_SPRITES && x != 64) ? line << (128 - x) : 0;
+                }
+                collision |= (row[0] & left) | (row[1] & right);
+                row[0] ^= left;
+                row[1] ^= right;
+            }
+            dirty |= 1ULL << ry;
+        }
+        addr += bytes;
+    }
+
+    V[0xF] = collision != 0;
+    dirtyRows |= dirty;
+    drawFlag = true;
+}
+
+// 00E0: clears the selected planes
+void chip8::clearPlanes()
+{
+    for (int p = 0; p < CHIP8_PLANES; ++p)
+    {
+        if (planes & (1 << p)) {
+            memset(gfx + p * CHIP8_FB_PLANE_WORDS, 0, sizeof(uint64_t) * CHIP8_FB_PLANE_WORDS);
+        }
+    }
+    dirtyRows = ~0ULL;
+    drawFlag = true;
+}
+
+// 00CN/00DN: rows are whole words apart, so scrolling moves memory
+void chip8::scrollRows(int rows)
+{
+    const int height = hires ? 64 : 32;
+    int count = (rows < 0) ? -rows : rows;
+    if (count > height) {
+        count = height;
+    }
+
+    size_t shift = count * CHIP8_FB_ROW_WORDS;
+    size_t keep = height * CHIP8_FB_ROW_WORDS - shift;
+    for (int p = 0; p < CHIP8_PLANES; ++p)
+    {
+        if ((planes & (1 << p)) == 0) {
+            continue;
+        }
+
+        uint64_t *plane = gfx + p * CHIP8_FB_PLANE_WORDS;
+        if (rows > 0) {
+            memmove(plane + shift, plane, sizeof(uint64_t) * keep);
+            memset(plane, 0, sizeof(uint64_t) * shift);
+        } else {
+            memmove(plane, plane + shift, sizeof(uint64_t) * keep);
+            memset(plane + keep, 0, sizeof(uint64_t) * shift);
+        }
+    }
+    dirtyRows = ~0ULL;
+    drawFlag = true;
+}
+
+// 00FB/00FC: each row shifts as a whole, carrying between its two words in hi-res
+void chip8::scrollColumns(int columns)
+{
+    const int height = hires ? 64 : 32;
+    int c = (columns < 0) ? -columns : columns;
+
+    for (int p = 0; p < CHIP8_PLANES; ++p)
+    {
+        if ((planes & (1 << p)) == 0) {
+            continue;
+        }
+
+        uint64_t *row = gfx + p * CHIP8_FB_PLANE_WORDS;
+        for (int y = 0; y < height; ++y, row += CHIP8_FB_ROW_WORDS)
+        {
+            if (!hires) {
+                row[0] = (columns > 0) ? row[0] >> c : row[0] << c;
+            } else if (columns > 0) {
+                row[1] = (row[1] >> c) | (row[0] << (64 - c));
+                row[0] >>= c;
+            } else {
+                row[0] = (row[0] << c) | (row[1] >> (64 - c));
+                row[1] <<= c;
+            }
+        }
+    }
+    dirtyRows = ~0ULL;
+    drawFlag = true;
+}
+
+// 00FE/00FF: switching resolution clears every plane
+void chip8::setHires(bool enabled)
+{
+    hires = enabled ? 1 : 0;
+    memset(gfx, 0, sizeof(gfx));
+    dirtyRows = ~0ULL;
+    drawFlag = true;
+}
+
+void chip8::setKeys(const unsigned char key[])
+{
+    memcpy(this->key, key, sizeof(char) * 16);
+}
+
+void chip8::consoleRender()
+{
+    static const char shades[4] = { ' ', '#', '+', '@' };
+
+    system("cls");
+    for (int y = 0; y < getHeight(); ++y)
+    {
+        for (int x = 0; x < getWidth(); ++x)
+        {
+            printf("%c", shades[getPixel(x, y)]);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+unsigned short chip8::getPC() const
+{
+    return PC;
+}
+
+unsigned short chip8::getI() const
+{
+    return I;
+}
+
+unsigned short chip8::getSP() const
+{
+    return sp;
+}
+
+const unsigned short *chip8::getStack() const
+{
+    return stack;
+}
+
+const unsigned char *chip8::getRegisters() const
+{
+    return V;
+}
+
+const unsigned char *chip8::getMemory() const
+{
+    return memory;
+}
+
+unsigned char chip8::getDelayTimer() const
+{
+    return delay_timer;
+}
+
+unsigned char chip8::getSoundTimer() const
+{
+    return sound_timer;
+}
+
+const unsigned char *chip8::getAudioPattern() const
+{
+    return pattern;
+}
+
+unsigned char chip8::getAudioPitch() const
+{
+    return pitch;
+}
+
+bool chip8::isHires() const
+{
+    return hires != 0;
+}
+
+int chip8::getWidth() const
+{
+    return hires ? 128 : 64;
+}
+
+int chip8::getHeight() const
+{
+    return hires ? 64 : 32;
+}
+
+int chip8::getPixel(int x, int y) const
+{
+    x &= getWidth() - 1;
+    y &= getHeight() - 1;
+
+    const uint64_t *word = gfx + y * CHIP8_FB_ROW_WORDS + (x >> 6);
+    int shift = 63 - (x & 63);
+    return (int) (((word[0] >> shift) & 1) | (((word[CHIP8_FB_PLANE_WORDS] >> shift) & 1) << 1));
+}
+
+const uint64_t *chip8::getFramebuffer() const
+{
+    return gfx;
+}
+
+// Rows changed since the last clearDirtyRows(), bit n is row n
+uint64_t chip8::getDirtyRows() const
+{
+    return dirtyRows;
+}
+
+void chip8::clearDirtyRows()
+{
+    dirtyRows = 0;
+}
+
+#define FNV_OFFSET  14695981039346656037ULL
+#define FNV_PRIME   1099511628211ULL
+
+// Hashes the rows in use of every plane with something on it, so a lo-res
+// single-plane screen hashes the same as it did before hi-res existed
+uint64_t chip8::framebufferHash() const
+{
+    const int height = getHeight();
+    const int words = hires ? CHIP8_FB_ROW_WORDS : 1;
+
+    uint64_t hash = FNV_OFFSET;
+    for (int p = 0; p < CHIP8_PLANES; ++p)
+    {
+        const uint64_t *plane = gfx + p * CHIP8_FB_PLANE_WORDS;
+        if (p > 0) {
+            uint64_t any = 0;
+            for (int i = 0; i < CHIP8_FB_PLANE_WORDS; ++i)
+            {
+                any |= plane[i];
+            }
+            if (any == 0) {
+                continue;
+            }
+        }
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int w = 0; w < words; ++w)
+            {
+                hash ^= plane[y * CHIP8_FB_ROW_WORDS + w];
+                hash *= FNV_PRIME;
+            }
+        }
+    }
+    return hash;
+}
+
+// Shared with the other engines so their hashes are comparable
+uint64_t chip8::hashFramebuffer(const uint64_t *rows)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (int y = 0; y < 32; ++y)
+    {
+        hash ^= rows[y];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
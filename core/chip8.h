@@ -0,0 +1,350 @@
+#ifndef CHIP8_H
+#define CHIP8_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define CHIP8_DEFAULT_CYCLES_PER_FRAME  10  // Instructions per 60 Hz frame (600 Hz)
+#define CHIP8_MEMORY_SIZE       65536   // XO-CHIP; the other profiles wrap at 4K
+#define CHIP8_ROM_MAX_SIZE      (CHIP8_MEMORY_SIZE - 0x0200) // Everything from 0x200 to the end of memory
+
+/*
+ * Packed framebuffer: CHIP8_PLANES planes of CHIP8_FB_ROWS rows, each row
+ * CHIP8_FB_ROW_WORDS 64-bit words with bit 63 of the first word at x = 0.
+ * Hi-res (128x64) uses all of it; lo-res (64x32) uses the first word of
+ * the first 32 rows, so a lo-res row is still a single word.
+ */
+#define CHIP8_PLANES            2
+#define CHIP8_FB_ROWS           64
+#define CHIP8_FB_ROW_WORDS      2
+#define CHIP8_FB_PLANE_WORDS    (CHIP8_FB_ROWS * CHIP8_FB_ROW_WORDS)
+
+#define CHIP8_BLOCK_MAX_LENGTH  128     // Instructions per compiled block
+#define CHIP8_BLOCK_CODE_LIMIT  16384   // Compiled instructions kept before a flush
+
+class chip8_trace;
+class chip8_debugger;
+class chip8_native;
+struct chip8_native_block;
+struct chip8_native_program;
+
+extern unsigned char chip8_fontset[80];  // Loaded at 0x000 by initialize()
+extern unsigned char chip8_fontset_hires[160];  // 8x10 digits for FX30, loaded at 0x050
+
+// One pre-decoded instruction: the handler number plus its operands
+struct chip8_insn
+{
+    unsigned char op;           // Handler, see chip8::Op
+    unsigned char x;            // Lower 4 bits of the high byte
+    unsigned char y;            // Upper 4 bits of the low byte
+    unsigned char nn;           // Lowest 8 bits (N is nn & 0xF)
+    unsigned short nnn;         // Lowest 12 bits
+    unsigned short opcode;
+};
+
+// A straight-line run of instructions ending at a jump, call, return, skip or store
+struct chip8_block
+{
+    const chip8_insn *code;     // First compiled instruction, NULL if there is no block
+    unsigned short end;         // Address after the last instruction
+    unsigned short length;      // Number of instructions
+};
+
+#define CHIP8_SOUND_EDGES       4       // Tone changes kept per frame
+
+// What happened during runFrame()
+struct chip8_frame
+{
+    unsigned long long instructions;
+    bool drawn;                 // 00E0, DXYN, a scroll or a resolution change ran
+    bool beepStarted;           // Sound timer went from 0 to running
+    bool beepStopped;           // Sound timer ran out (or was cleared)
+    bool stopped;               // The debugger stopped it early, the next runFrame() finishes it
+
+    // Where FX18 switched the tone within the frame, for sample-accurate audio.
+    // The tone is soundOn at the start, flips at each edge and stops at the end
+    // of the frame if the timer ran out. Only runFrame() fills these in.
+    bool soundOn;
+    unsigned soundEdges;
+    unsigned soundEdgeAt[CHIP8_SOUND_EDGES];    // Instruction index of each flip, in order
+};
+
+#define CHIP8_PROFILE_OPS       64      // Room for every chip8::Op
+
+/*
+ * Execution counters, only kept while profiling is enabled.
+ * Counting is compiled into separate instantiations of the engines, so a
+ * machine that is not profiling runs exactly the same code as before.
+ */
+struct chip8_profile
+{
+    unsigned long long ops[CHIP8_PROFILE_OPS];  // Executions per chip8::Op
+    unsigned long long pc[4096];                // Executions per instruction address
+    unsigned long long frames;                  // Frames run by runFrame()
+    unsigned long long instructions;
+    unsigned frameInstructions;                 // During the last frame
+    unsigned frameDraws;                        // 00E0, DXYN and scrolls during the last frame
+};
+
+// Fills addr with up to max of the most executed addresses, hottest first; returns how many
+size_t chip8_profile_hottest(const chip8_profile &profile, unsigned short *addr, size_t max);
+
+#define CHIP8_STATE_VERSION     2
+
+/*
+ * Everything that makes up a running machine, in a fixed layout with no
+ * implicit padding, so a savestate is this struct behind a small header
+ * and restoring one is a single copy. Multi-byte fields are stored in the
+ * host byte order; the header records it.
+ */
+struct chip8_state
+{
+    uint64_t gfx[CHIP8_PLANES * CHIP8_FB_PLANE_WORDS];  // Packed framebuffer, see CHIP8_FB_ROWS
+
+    /*
+     * Memory Map: (0 ~ 65535)
+     * 0x000-0x1FF - Chip 8 interpreter (contains font set in emu)
+     * 0x000-0x04F - Used for the built in 4x5 pixel font set (0-F)
+     * 0x050-0x0EF - SUPER-CHIP 8x10 font (0-F)
+     * 0x200-0xFFF - Program ROM and work RAM
+     * 0x1000-     - XO-CHIP data, programs still run from the first 4K
+     */
+    unsigned char memory[CHIP8_MEMORY_SIZE];
+
+    unsigned char V[16];        // 15 8-bit general purpose registers named V0, V1, ... , VE
+    unsigned char key[16];      // HEX based keypad (0x0-0xF)
+
+    unsigned short stack[16];   // Stack
+    unsigned short sp;          // Stack pointer
+    unsigned short I;           // Index register I
+    unsigned short PC;          // Program counter 0x0000 ~ 0x0FFF
+
+    unsigned char delay_timer;  // 60 Hz
+    unsigned char sound_timer;  // 60 Hz
+
+    unsigned char flags[16];    // SUPER-CHIP RPL flags (FX75/FX85)
+    unsigned char pattern[16];  // XO-CHIP audio pattern (F002)
+    unsigned char pitch;        // XO-CHIP playback pitch (FX3A)
+    unsigned char hires;        // 1 in 128x64 mode (00FF), 0 in 64x32 (00FE)
+    unsigned char planes;       // XO-CHIP planes drawn to (FN01), bit n is plane n
+    unsigned char pad[5];       // Zero
+
+    uint32_t rng;               // xorshift32 state for CXNN
+    uint32_t quirks;            // chip8::Quirks profile, QUIRKS_MODERN (0) in older states
+};
+
+static_assert(sizeof(chip8_state) == 67704, "chip8_state layout changed, bump CHIP8_STATE_VERSION");
+
+class chip8 : private chip8_state
+{
+public:
+    chip8();
+
+    void initialize();
+    bool loadGame(const char *filename);
+    bool loadGame(const unsigned char *data, size_t size);
+    void emulateCycle();
+    void emulateCycles(unsigned long long count);
+    void setKeys(const unsigned char key[]);
+    void seedRandom(uint32_t seed);
+
+    // Savestates: the machine state as a chip8_state, or a file holding one
+    void saveState(chip8_state &state) const;
+    bool loadState(const chip8_state &state);       // False, and nothing changed, if the state is invalid
+    bool saveState(const char *filename) const;
+    bool loadState(const char *filename);
+
+    // Frame scheduler: instructions run in batches, timers tick once per frame
+    chip8_frame runFrame();
+    chip8_frame runFrames(unsigned frames);
+    void setCyclesPerFrame(unsigned cycles);
+    unsigned getCyclesPerFrame() const;
+
+    // Execution engines, selectable to compare throughput and correctness
+    enum Engine {
+        ENGINE_INTERPRETER,     // One decoded instruction at a time
+        ENGINE_BLOCKS,          // Cached basic blocks of threaded code
+        ENGINE_NATIVE           // ROMs recompiled ahead of time (see native.h), the interpreter for the rest
+    };
+    void setEngine(Engine engine);
+    Engine getEngine() const;
+    static const char *engineName(Engine engine);   // "interpreter", "blocks", "native"
+    const chip8_native_program *getNative() const;  // Recompiled code for the loaded ROM and quirks, or NULL
+
+    // Quirk profiles, see quirks.h. loadGame() picks one from the ROM hash
+    enum Quirks {
+        QUIRKS_MODERN,          // This interpreter's original behavior
+        QUIRKS_VIP,             // COSMAC VIP
+        QUIRKS_CHIP48,
+        QUIRKS_SCHIP,           // SUPER-CHIP 1.1
+        QUIRKS_XOCHIP,          // XO-CHIP (Octo), the only one using memory past 4K
+        QUIRKS_COUNT
+    };
+    void setQuirks(Quirks quirks);
+    Quirks getQuirks() const;
+    static const char *quirksName(Quirks quirks);   // "modern", "vip", "chip48", "schip", "xochip"
+
+    // Instrumentation, see chip8_profile
+    void setProfiling(bool enabled);
+    bool getProfiling() const;
+    void resetProfile();
+    const chip8_profile *getProfile() const;    // NULL while not profiling
+
+    /*
+     * Idle loops: jumping to self, waiting in FX0A and short loops polling
+     * the delay timer, keys or registers cannot end before the next timer
+     * tick or key change. With idle skipping (the default) the rest of the
+     * batch is fast-forwarded to exactly the state spinning would reach.
+     * Profiling, tracing and debugging machines always run every instruction.
+     */
+    void setIdleSkipping(bool enabled);
+    bool getIdleSkipping() const;
+    unsigned long long getIdleInstructions() const;    // Skipped since initialize()
+
+    // Opcodes decoded as unknown since initialize(); the core prints nothing, tools decide
+    unsigned long long getUnknownOpcodes() const;
+    unsigned short getLastUnknownOpcode() const;
+
+    // Records every instruction into trace (owned by the caller), NULL stops
+    void setTrace(chip8_trace *trace);
+    chip8_trace *getTrace() const;
+
+    // Breakpoints and watchpoints, see debugger.h (owned by the caller), NULL detaches
+    void setDebugger(chip8_debugger *debugger);
+    chip8_debugger *getDebugger() const;
+
+    void consoleRender();
+
+    bool drawFlag;
+    bool isBeep;                // Latched when a beep starts
+
+    unsigned short getPC() const;
+    unsigned short getI() const;
+    unsigned short getSP() const;
+    const unsigned short *getStack() const; // 16 entries, the top one at getSP() - 1
+    const unsigned char *getRegisters() const;  // V0-VF
+    const unsigned char *getMemory() const; // CHIP8_MEMORY_SIZE bytes
+    unsigned char getDelayTimer() const;
+    unsigned char getSoundTimer() const;
+    const unsigned char *getAudioPattern() const;   // 16 bytes, all zero until F002
+    unsigned char getAudioPitch() const;
+    bool isHires() const;
+    int getWidth() const;                   // 64 or 128
+    int getHeight() const;                  // 32 or 64
+    int getPixel(int x, int y) const;       // Bit n set when plane n is lit
+    const uint64_t *getFramebuffer() const; // CHIP8_PLANES planes, see CHIP8_FB_ROWS
+    uint64_t getDirtyRows() const;
+    void clearDirtyRows();
+    uint64_t framebufferHash() const; // FNV-1a over the framebuffer rows
+    static uint64_t hashFramebuffer(const uint64_t *rows);  // 32 lo-res rows, one word each
+
+    // Handler numbers stored in chip8_insn::op
+    enum Op {
+        OP_DECODE,              // Not decoded yet (or invalidated by a write)
+        OP_UNKNOWN,
+        OP_00E0, OP_00EE, OP_0NNN,
+        OP_1NNN, OP_2NNN, OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN, OP_7XNN,
+        OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6, OP_8XY7, OP_8XYE, OP_8XYU,
+        OP_9XY0, OP_ANNN, OP_BNNN, OP_CXNN, OP_DXYN, OP_EX9E, OP_EXA1,
+        OP_FX07, OP_FX0A, OP_FX15, OP_FX18, OP_FX1E, OP_FX29, OP_FX33, OP_FX55, OP_FX65,
+        // SUPER-CHIP
+        OP_00CN, OP_00FB, OP_00FC, OP_00FD, OP_00FE, OP_00FF, OP_FX30, OP_FX75, OP_FX85,
+        // XO-CHIP
+        OP_00DN, OP_5XY2, OP_5XY3, OP_F000, OP_FN01, OP_F002, OP_FX3A,
+        OP_COUNT
+    };
+
+    static chip8_insn decode(unsigned short opcode);
+    static const char *opName(unsigned char op);    // "DXYN" etc.
+
+private:
+    friend class chip8_native;
+
+    uint64_t dirtyRows;         // Rows touched since the last clearDirtyRows()
+    uint32_t nextRandom();
+
+    /*
+     * Decoded instruction cache, indexed by address.
+     * Entries start out as OP_DECODE, which decodes the opcode at that
+     * address in place. Writes to memory reset the affected entries.
+     */
+    chip8_insn decoded[4096];
+
+    Engine engine;
+    unsigned cyclesPerFrame;
+    bool idleSkipping;
+    unsigned long long idleInstructions;
+    unsigned long long unknownOpcodes;
+    unsigned short lastUnknownOpcode;
+    void decodedUnknown(unsigned short opcode);
+
+    // Tone switches by FX18 during the current runFrame()
+    unsigned soundEdges;
+    unsigned soundEdgeAt[CHIP8_SOUND_EDGES];
+    void soundEdge(unsigned long long at);
+
+    /*
+     * Basic block cache for ENGINE_BLOCKS, only allocated for that engine.
+     * blocks is indexed by start address, codeMap counts the live blocks
+     * covering each byte so stores can cheaply tell if they hit code.
+     * blockCode is reserved up front so block code pointers stay valid.
+     */
+    std::vector<chip8_block> blocks;
+    std::vector<chip8_insn> blockCode;
+    std::vector<unsigned short> codeMap;
+
+    // Recompiled code for the loaded ROM; blocks whose code was overwritten are dropped
+    const chip8_native_program *native;
+    std::vector<const chip8_native_block *> nativeBlocks;   // By start address, ENGINE_NATIVE only
+    std::vector<unsigned char> nativeCover;                 // Recompiled blocks covering each address
+    bool nativeStale;                       // invalidate() dropped a recompiled block
+
+    std::vector<chip8_profile> profile;     // One entry while profiling, otherwise empty
+    chip8_trace *trace;
+    chip8_debugger *debugger;
+    unsigned frameProgress;                 // Instructions of the frame run before the debugger stopped it
+    bool debugStop;                         // Set by execute() when the debugger stopped it...
+    unsigned long long debugRan;            // ...after this many instructions
+
+    // Instrumentation compiled into execute(), see emulateCycles()
+    enum Hook {
+        HOOK_PROFILE = 1,
+        HOOK_TRACE = 2,
+        HOOK_DEBUG = 4          // Interpreter only
+    };
+
+    unsigned long long runCycles(unsigned long long count);    // Returns how many ran
+
+    template <int Mode> void executeQuirks(int hooks, unsigned long long count);
+    template <int Mode, class Quirks> void executeWith(int hooks, unsigned long long count);
+    template <int Mode, int Hooks, class Quirks> void execute(unsigned long long count);
+    void tickTimers();
+    bool skipTaken(const chip8_insn &in) const;
+    bool debugCheck(unsigned short pc);
+    void debugWrite(unsigned addr, unsigned len, unsigned mask);
+    template <class Quirks> bool idleLoop(unsigned short &pc, unsigned short loop, unsigned long long left);
+
+    void invalidate(unsigned short addr, unsigned short len);
+    void invalidateAll();
+    void invalidateBlocks(unsigned short addr, unsigned short len);
+    void flushBlocks();
+    const chip8_block &compileBlock(unsigned short start);
+
+    void attachNative();
+    void invalidateNative(unsigned short addr);
+    void executeNative(unsigned long long count);
+    template <class Quirks> void runNative(unsigned long long count);
+    bool nativeStep(unsigned short pc);
+    bool nativeIdle(unsigned short &pc, unsigned short loop, unsigned long long left);
+
+    template <class Quirks> void drawSprite(const chip8_insn &in);
+    void clearPlanes();
+    void scrollRows(int rows);              // Down when positive
+    void scrollColumns(int columns);        // Right when positive
+    void setHires(bool enabled);
+};
+
+static_assert(chip8::OP_COUNT <= CHIP8_PROFILE_OPS, "chip8_profile::ops is too small");
+
+#endif // CHIP8_H
@@ -0,0 +1,20 @@
+# Include this from any project that links against the chip8 core library.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+CONFIG += c++11
+
+unix:LIBS += -lpthread
+linux:LIBS += -lrt
+
+win32:CONFIG(release, debug|release) {
+    LIBS += -L$$OUT_PWD/../core/release/ -lchip8core
+    PRE_TARGETDEPS += $$OUT_PWD/../core/release/libchip8core.a
+} else:win32:CONFIG(debug, debug|release) {
+    LIBS += -L$$OUT_PWD/../core/debug/ -lchip8core
+    PRE_TARGETDEPS += $$OUT_PWD/../core/debug/libchip8core.a
+} else:unix {
+    LIBS += -L$$OUT_PWD/../core/ -lchip8core
+    PRE_TARGETDEPS += $$OUT_PWD/../core/libchip8core.a
+}
@@ -0,0 +1,59 @@
+#-------------------------------------------------
+#
+# chip8 core library, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt
+CONFIG   += staticlib c++11
+
+# qmake CONFIG+=avx2 builds the lockstep engine with 256-bit kernels (SSE2 otherwise)
+avx2: QMAKE_CXXFLAGS += -mavx2
+
+TARGET = chip8core
+TEMPLATE = lib
+
+SOURCES += \
+    chip8.cpp \
+    audio.cpp \
+    batch.cpp \
+    debugger.cpp \
+    disasm.cpp \
+    lanes.cpp \
+    library.cpp \
+    mapfile.cpp \
+    movie.cpp \
+    native.cpp \
+    quirks.cpp \
+    recompiler.cpp \
+    rewind.cpp \
+    search.cpp \
+    shm.cpp \
+    state.cpp \
+    thread_pool.cpp \
+    trace.cpp \
+    video.cpp
+
+HEADERS += \
+    chip8.h \
+    audio.h \
+    batch.h \
+    debugger.h \
+    disasm.h \
+    lanes.h \
+    library.h \
+    mapfile.h \
+    movie.h \
+    native.h \
+    quirks.h \
+    recompiler.h \
+    rewind.h \
+    search.h \
+    shm.h \
+    state.h \
+    thread_pool.h \
+    trace.h \
+    video.h \
+    spsc_queue.h \
+    triple_buffer.h
@@ -0,0 +1,162 @@
+#include "debugger.h"
+#include <cstring>
+
+#define NOT_WATCHED     -2
+
+chip8_debugger::chip8_debugger() :
+    breakpointCount(0), rangeCount(0), written(false), writtenAt(0), registerCount(0),
+    stepping(false), steps(0), steppingOver(false), overPC(0), overSP(0),
+    resuming(false), resumePC(0), reason(STOP_NONE), stopPC(0), stopAddress(0), stopRegister(0)
+{
+    memset(breakpoints, 0, sizeof(breakpoints));
+    memset(watchedPages, 0, sizeof(watchedPages));
+    memset(ranges, 0, sizeof(ranges));
+    for (int r = 0; r < CHIP8_DEBUG_REGISTERS; ++r)
+    {
+        registerWatch[r] = NOT_WATCHED;
+        registerLast[r] = -1;
+    }
+}
+
+void chip8_debugger::setBreakpoint(unsigned short addr, bool enabled)
+{
+    uint64_t bit = 1ULL << (addr & 63);
+    uint64_t &word = breakpoints[(addr & 0x0FFF) >> 6];
+    if (enabled && !(word & bit)) {
+        word |= bit;
+        ++breakpointCount;
+    } else if (!enabled && (word & bit)) {
+        word &= ~bit;
+        --breakpointCount;
+    }
+}
+
+bool chip8_debugger::hasBreakpoint(unsigned short addr) const
+{
+    return (breakpoints[(addr & 0x0FFF) >> 6] >> (addr & 63)) & 1;
+}
+
+void chip8_debugger::clearBreakpoints()
+{
+    memset(breakpoints, 0, sizeof(breakpoints));
+    breakpointCount = 0;
+}
+
+bool chip8_debugger::watchMemory(unsigned short addr, unsigned short length)
+{
+    if (rangeCount == CHIP8_DEBUG_MEMORY_WATCHES || length == 0) {
+        return false;
+    }
+
+    ranges[rangeCount].addr = addr;
+    ranges[rangeCount].length = length;
+    ++rangeCount;
+
+    unsigned last = (unsigned) addr + length - 1;
+    for (unsigned page = addr >> 8; page <= (last >> 8) && page < CHIP8_DEBUG_PAGES; ++page)
+    {
+        watchedPages[page] = 1;
+    }
+    return true;
+}
+
+void chip8_debugger::clearMemoryWatches()
+{
+    memset(watchedPages, 0, sizeof(watchedPages));
+    rangeCount = 0;
+    written = false;
+}
+
+void chip8_debugger::watchRegister(int reg, int value)
+{
+    if (reg < 0 || reg >= CHIP8_DEBUG_REGISTERS) {
+        return;
+    }
+    if (registerWatch[reg] == NOT_WATCHED) {
+        ++registerCount;
+    }
+    registerWatch[reg] = value;
+    registerLast[reg] = -1;
+}
+
+void chip8_debugger::clearRegisterWatches()
+{
+    for (int r = 0; r < CHIP8_DEBUG_REGISTERS; ++r)
+    {
+        registerWatch[r] = NOT_WATCHED;
+        registerLast[r] = -1;
+    }
+    registerCount = 0;
+}
+
+void chip8_debugger::step(unsigned long long count)
+{
+    stepping = true;
+    steps = count;
+    steppingOver = false;
+}
+
+void chip8_debugger::stepOver(const chip8 &emu)
+{
+    unsigned short pc = emu.getPC();
+    const unsigned char *memory = emu.getMemory();
+    if ((memory[pc & 0x0FFF] & 0xF0) == 0x20) {
+        stepping = false;
+        steppingOver = true;
+        overPC = (unsigned short) (pc + 2);
+        overSP = emu.getSP();
+    } else {
+        step(1);
+    }
+}
+
+void chip8_debugger::resume()
+{
+    stepping = false;
+    steppingOver = false;
+}
+
+bool chip8_debugger::isActive() const
+{
+    return breakpointCount != 0 || rangeCount != 0 || registerCount != 0 || stepping || steppingOver;
+}
+
+chip8_debugger::Reason chip8_debugger::getReason() const
+{
+    return reason;
+}
+
+unsigned short chip8_debugger::getStopPC() const
+{
+    return stopPC;
+}
+
+unsigned short chip8_debugger::getStopAddress() const
+{
+    return stopAddress;
+}
+
+int chip8_debugger::getStopRegister() const
+{
+    return stopRegister;
+}
+
+const char *chip8_debugger::reasonName(Reason reason)
+{
+    switch (reason)
+    {
+    case STOP_BREAKPOINT: return "breakpoint";
+    case STOP_MEMORY: return "memory watch";
+    case STOP_REGISTER: return "register watch";
+    case STOP_STEP: return "step";
+    default: return "none";
+    }
+}
+
+void chip8_debugger::stopped(Reason why, unsigned short pc)
+{
+    reason = why;
+    stopPC = pc;
+    resuming = true;
+    resumePC = pc;
+}
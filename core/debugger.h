@@ -0,0 +1,107 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define CHIP8_DEBUG_REGISTERS       17      // V0-VF, then I
+#define CHIP8_DEBUG_REG_I           16
+#define CHIP8_DEBUG_ANY_VALUE       -1      // Register watch on any change
+#define CHIP8_DEBUG_MEMORY_WATCHES  16
+#define CHIP8_DEBUG_PAGES           (CHIP8_MEMORY_SIZE / 256)
+
+/*
+ * Breakpoints, watchpoints and stepping for one machine, attached with
+ * chip8::setDebugger() (the caller owns it).
+ *
+ * While nothing is set the machine runs exactly the code it runs without a
+ * debugger. Otherwise it runs a separate instantiation of the interpreter
+ * that, before every instruction, tests one bit of a 4096-bit PC bitmap
+ * and the few watched registers. Stores test a flag per 256-byte page of
+ * memory and only look at the watched ranges when their page is flagged.
+ *
+ * A stop leaves the machine before the instruction that hit a breakpoint,
+ * or after the one that wrote a watched location. runFrame() then returns
+ * early with chip8_frame::stopped set, and the next runFrame() finishes the
+ * same frame, so stepping keeps frames and timers exact. Resuming from a
+ * breakpoint runs the instruction it stopped on.
+ *
+ * Only the thread running the machine may change a debugger in use.
+ */
+class chip8_debugger
+{
+public:
+    enum Reason {
+        STOP_NONE,
+        STOP_BREAKPOINT,
+        STOP_MEMORY,            // A store wrote into a watched range
+        STOP_REGISTER,          // A watched register changed
+        STOP_STEP               // step() or stepOver() finished
+    };
+
+    chip8_debugger();
+
+    void setBreakpoint(unsigned short addr, bool enabled);
+    bool hasBreakpoint(unsigned short addr) const;
+    void clearBreakpoints();
+
+    bool watchMemory(unsigned short addr, unsigned short length);   // False once CHIP8_DEBUG_MEMORY_WATCHES are set
+    void clearMemoryWatches();
+    void watchRegister(int reg, int value);     // Stops when reg changes (to value, unless CHIP8_DEBUG_ANY_VALUE)
+    void clearRegisterWatches();
+
+    void step(unsigned long long count = 1);    // Run count instructions, then stop
+    void stepOver(const chip8 &emu);            // One instruction, a CALL runs until it returns
+    void resume();                              // Cancels a pending step
+
+    bool isActive() const;                      // Anything set that needs checking
+
+    // Why and where the machine last stopped
+    Reason getReason() const;
+    unsigned short getStopPC() const;
+    unsigned short getStopAddress() const;      // STOP_MEMORY: first watched byte written
+    int getStopRegister() const;                // STOP_REGISTER: 0-15 or CHIP8_DEBUG_REG_I
+    static const char *reasonName(Reason reason);
+
+private:
+    friend class chip8;
+
+    struct Range
+    {
+        unsigned short addr;
+        unsigned short length;
+    };
+
+    uint64_t breakpoints[4096 / 64];
+    unsigned breakpointCount;
+
+    unsigned char watchedPages[CHIP8_DEBUG_PAGES];
+    Range ranges[CHIP8_DEBUG_MEMORY_WATCHES];
+    unsigned rangeCount;
+    bool written;                               // A store hit a range, stop before the next instruction
+    unsigned short writtenAt;
+
+    int registerWatch[CHIP8_DEBUG_REGISTERS];   // Value to stop at, CHIP8_DEBUG_ANY_VALUE, or -2 if not watched
+    int registerLast[CHIP8_DEBUG_REGISTERS];    // -1 until first seen
+    unsigned registerCount;
+
+    bool stepping;
+    unsigned long long steps;                   // Instructions left to run
+    bool steppingOver;
+    unsigned short overPC;                      // Stop here once the stack is back to overSP
+    unsigned short overSP;
+
+    bool resuming;                              // Do not stop at resumePC on the first check
+    unsigned short resumePC;
+
+    Reason reason;
+    unsigned short stopPC;
+    unsigned short stopAddress;
+    int stopRegister;
+
+    void stopped(Reason why, unsigned short pc);
+};
+
+#endif // DEBUGGER_H
@@ -0,0 +1,66 @@
+#include "disasm.h"
+#include "chip8.h"
+#include <cstdio>
+
+int chip8_disassemble(unsigned short opcode, char *out, size_t size)
+{
+    chip8_insn in = chip8::decode(opcode);
+
+    switch (in.op)
+    {
+    case chip8::OP_00E0: return snprintf(out, size, "CLS");
+    case chip8::OP_00EE: return snprintf(out, size, "RET");
+    case chip8::OP_0NNN: return snprintf(out, size, "SYS 0x%03X", in.nnn);
+    case chip8::OP_1NNN: return snprintf(out, size, "JP 0x%03X", in.nnn);
+    case chip8::OP_2NNN: return snprintf(out, size, "CALL 0x%03X", in.nnn);
+    case chip8::OP_3XNN: return snprintf(out, size, "SE V%X, 0x%02X", in.x, in.nn);
+    case chip8::OP_4XNN: return snprintf(out, size, "SNE V%X, 0x%02X", in.x, in.nn);
+    case chip8::OP_5XY0: return snprintf(out, size, "SE V%X, V%X", in.x, in.y);
+    case chip8::OP_6XNN: return snprintf(out, size, "LD V%X, 0x%02X", in.x, in.nn);
+    case chip8::OP_7XNN: return snprintf(out, size, "ADD V%X, 0x%02X", in.x, in.nn);
+    case chip8::OP_8XY0: return snprintf(out, size, "LD V%X, V%X", in.x, in.y);
+    case chip8::OP_8XY1: return snprintf(out, size, "OR V%X, V%X", in.x, in.y);
+    case chip8::OP_8XY2: return snprintf(out, size, "AND V%X, V%X", in.x, in.y);
+    case chip8::OP_8XY3: return snprintf(out, size, "XOR V%X, V%X", in.x, in.y);
+    case chip8::OP_8XY4: return snprintf(out, size, "ADD V%X, V%X", in.x, in.y);
+    case chip8::OP_8XY5: return snprintf(out, size, "SUB V%X, V%X", in.x, in.y);
+    case chip8::OP_8XY6: return snprintf(out, size, "SHR V%X", in.x);
+    case chip8::OP_8XY7: return snprintf(out, size, "SUBN V%X, V%X", in.x, in.y);
+    case chip8::OP_8XYE: return snprintf(out, size, "SHL V%X", in.x);
+    case chip8::OP_9XY0: return snprintf(out, size, "SNE V%X, V%X", in.x, in.y);
+    case chip8::OP_ANNN: return snprintf(out, size, "LD I, 0x%03X", in.nnn);
+    case chip8::OP_BNNN: return snprintf(out, size, "JP V0, 0x%03X", in.nnn);
+    case chip8::OP_CXNN: return snprintf(out, size, "RND V%X, 0x%02X", in.x, in.nn);
+    case chip8::OP_DXYN: return snprintf(out, size, "DRW V%X, V%X, %d", in.x, in.y, in.nn & 0x0F);
+    case chip8::OP_EX9E: return snprintf(out, size, "SKP V%X", in.x);
+    case chip8::OP_EXA1: return snprintf(out, size, "SKNP V%X", in.x);
+    case chip8::OP_FX07: return snprintf(out, size, "LD V%X, DT", in.x);
+    case chip8::OP_FX0A: return snprintf(out, size, "LD V%X, K", in.x);
+    case chip8::OP_FX15: return snprintf(out, size, "LD DT, V%X", in.x);
+    case chip8::OP_FX18: return snprintf(out, size, "LD ST, V%X", in.x);
+    case chip8::OP_FX1E: return snprintf(out, size, "ADD I, V%X", in.x);
+    case chip8::OP_FX29: return snprintf(out, size, "LD F, V%X", in.x);
+    case chip8::OP_FX33: return snprintf(out, size, "LD B, V%X", in.x);
+    case chip8::OP_FX55: return snprintf(out, size, "LD [I], V%X", in.x);
+    case chip8::OP_FX65: return snprintf(out, size, "LD V%X, [I]", in.x);
+    case chip8::OP_00CN: return snprintf(out, size, "SCD %d", in.nn & 0x0F);
+    case chip8::OP_00FB: return snprintf(out, size, "SCR");
+    case chip8::OP_00FC: return snprintf(out, size, "SCL");
+    case chip8::OP_00FD: return snprintf(out, size, "EXIT");
+    case chip8::OP_00FE: return snprintf(out, size, "LOW");
+    case chip8::OP_00FF: return snprintf(out, size, "HIGH");
+    case chip8::OP_FX30: return snprintf(out, size, "LD HF, V%X", in.x);
+    case chip8::OP_FX75: return snprintf(out, size, "LD R, V%X", in.x);
+    case chip8::OP_FX85: return snprintf(out, size, "LD V%X, R", in.x);
+    case chip8::OP_00DN: return snprintf(out, size, "SCU %d", in.nn & 0x0F);
+    case chip8::OP_5XY2: return snprintf(out, size, "SAVE V%X-V%X", in.x, in.y);
+    case chip8::OP_5XY3: return snprintf(out, size, "LOAD V%X-V%X", in.x, in.y);
+    case chip8::OP_F000: return snprintf(out, size, "LD I, LONG");
+    case chip8::OP_FN01: return snprintf(out, size, "PLANE %d", in.x);
+    case chip8::OP_F002: return snprintf(out, size, "AUDIO");
+    case chip8::OP_FX3A: return snprintf(out, size, "PITCH V%X", in.x);
+    }
+
+    // Unknown opcodes (and 8XY? arithmetic) are shown as data
+    return snprintf(out, size, "DW 0x%04X", opcode);
+}
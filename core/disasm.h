@@ -0,0 +1,13 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stddef.h>
+
+/*
+ * Writes the mnemonic of one opcode into out, in the usual
+ * Cowgod style ("DRW V1, V2, 5", "LD I, 0x2EA", ...).
+ * Returns the length of the text, like snprintf.
+ */
+int chip8_disassemble(unsigned short opcode, char *out, size_t size);
+
+#endif // DISASM_H
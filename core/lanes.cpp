@@ -0,0 +1,828 @@
+#include "lanes.h"
+#include "library.h"
+#include <cstring>
+#include <ctime>
+
+// decoded[] entry for instruction bytes some lane has stored to
+static const unsigned char OP_PRIVATE = chip8::OP_COUNT;
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Minimal vector layer: vec8 holds VEC8_LANES byte lanes, vec16 holds
+ * VEC16_LANES 16-bit lanes. Masks are 0xFF / 0xFFFF per lane. Builds
+ * without SSE2 get one lane per "vector" and the same code paths.
+ */
+#if defined(__AVX2__)
+
+typedef __m256i vec8;
+typedef __m256i vec16;
+#define VEC8_LANES  32
+#define VEC16_LANES 16
+
+static inline vec8 v8_load(const unsigned char *p) { return _mm256_loadu_si256((const __m256i *) p); }
+static inline void v8_store(unsigned char *p, vec8 v) { _mm256_storeu_si256((__m256i *) p, v); }
+static inline vec8 v8_set1(unsigned char c) { return _mm256_set1_epi8((char) c); }
+static inline vec8 v8_add(vec8 a, vec8 b) { return _mm256_add_epi8(a, b); }
+static inline vec8 v8_sub(vec8 a, vec8 b) { return _mm256_sub_epi8(a, b); }
+static inline vec8 v8_subs(vec8 a, vec8 b) { return _mm256_subs_epu8(a, b); }
+static inline vec8 v8_and(vec8 a, vec8 b) { return _mm256_and_si256(a, b); }
+static inline vec8 v8_andnot(vec8 a, vec8 b) { return _mm256_andnot_si256(a, b); }
+static inline vec8 v8_or(vec8 a, vec8 b) { return _mm256_or_si256(a, b); }
+static inline vec8 v8_xor(vec8 a, vec8 b) { return _mm256_xor_si256(a, b); }
+static inline vec8 v8_eq(vec8 a, vec8 b) { return _mm256_cmpeq_epi8(a, b); }
+static inline vec8 v8_max(vec8 a, vec8 b) { return _mm256_max_epu8(a, b); }
+static inline vec8 v8_select(vec8 m, vec8 a, vec8 b) { return _mm256_blendv_epi8(b, a, m); }
+static inline vec8 v8_srl1(vec8 a) { return _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi8(0x7F)); }
+static inline vec8 v8_srl7(vec8 a) { return _mm256_and_si256(_mm256_srli_epi16(a, 7), _mm256_set1_epi8(0x01)); }
+static inline unsigned v8_count(vec8 m) { return __builtin_popcount((unsigned) _mm256_movemask_epi8(m)); }
+
+static inline vec16 v16_load(const uint16_t *p) { return _mm256_loadu_si256((const __m256i *) p); }
+static inline void v16_store(uint16_t *p, vec16 v) { _mm256_storeu_si256((__m256i *) p, v); }
+static inline vec16 v16_set1(uint16_t c) { return _mm256_set1_epi16((short) c); }
+static inline vec16 v16_add(vec16 a, vec16 b) { return _mm256_add_epi16(a, b); }
+static inline vec16 v16_and(vec16 a, vec16 b) { return _mm256_and_si256(a, b); }
+static inline vec16 v16_eq(vec16 a, vec16 b) { return _mm256_cmpeq_epi16(a, b); }
+static inline vec16 v16_select(vec16 m, vec16 a, vec16 b) { return _mm256_blendv_epi8(b, a, m); }
+static inline vec16 v16_widen(const unsigned char *m) { return _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) m)); }
+static inline vec8 v16_narrow(vec16 lo, vec16 hi) { return _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8); }
+
+#elif defined(__SSE2__)
+
+typedef __m128i vec8;
+typedef __m128i vec16;
+#define VEC8_LANES  16
+#define VEC16_LANES 8
+
+static inline vec8 v8_load(const unsigned char *p) { return _mm_loadu_si128((const __m128i *) p); }
+static inline void v8_store(unsigned char *p, vec8 v) { _mm_storeu_si128((__m128i *) p, v); }
+static inline vec8 v8_set1(unsigned char c) { return _mm_set1_epi8((char) c); }
+static inline vec8 v8_add(vec8 a, vec8 b) { return _mm_add_epi8(a, b); }
+static inline vec8 v8_sub(vec8 a, vec8 b) { return _mm_sub_epi8(a, b); }
+static inline vec8 v8_subs(vec8 a, vec8 b) { return _mm_subs_epu8(a, b); }
+static inline vec8 v8_and(vec8 a, vec8 b) { return _mm_and_si128(a, b); }
+static inline vec8 v8_andnot(vec8 a, vec8 b) { return _mm_andnot_si128(a, b); }
+static inline vec8 v8_or(vec8 a, vec8 b) { return _mm_or_si128(a, b); }
+static inline vec8 v8_xor(vec8 a, vec8 b) { return _mm_xor_si128(a, b); }
+static inline vec8 v8_eq(vec8 a, vec8 b) { return _mm_cmpeq_epi8(a, b); }
+static inline vec8 v8_max(vec8 a, vec8 b) { return _mm_max_epu8(a, b); }
+static inline vec8 v8_select(vec8 m, vec8 a, vec8 b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+static inline vec8 v8_srl1(vec8 a) { return _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7F)); }
+static inline vec8 v8_srl7(vec8 a) { return _mm_and_si128(_mm_srli_epi16(a, 7), _mm_set1_epi8(0x01)); }
+static inline unsigned v8_count(vec8 m) { return __builtin_popcount((unsigned) _mm_movemask_epi8(m)); }
+
+static inline vec16 v16_load(const uint16_t *p) { return _mm_loadu_si128((const __m128i *) p); }
+static inline void v16_store(uint16_t *p, vec16 v) { _mm_storeu_si128((__m128i *) p, v); }
+static inline vec16 v16_set1(uint16_t c) { return _mm_set1_epi16((short) c); }
+static inline vec16 v16_add(vec16 a, vec16 b) { return _mm_add_epi16(a, b); }
+static inline vec16 v16_and(vec16 a, vec16 b) { return _mm_and_si128(a, b); }
+static inline vec16 v16_eq(vec16 a, vec16 b) { return _mm_cmpeq_epi16(a, b); }
+static inline vec16 v16_select(vec16 m, vec16 a, vec16 b) { return v8_select(m, a, b); }
+static inline vec16 v16_widen(const unsigned char *m) { __m128i b = _mm_loadl_epi64((const __m128i *) m); return _mm_unpacklo_epi8(b, b); }
+static inline vec8 v16_narrow(vec16 lo, vec16 hi) { return _mm_packs_epi16(lo, hi); }
+
+#else
+
+typedef unsigned char vec8;
+typedef uint16_t vec16;
+#define VEC8_LANES  1
+#define VEC16_LANES 1
+
+static inline vec8 v8_load(const unsigned char *p) { return *p; }
+static inline void v8_store(unsigned char *p, vec8 v) { *p = v; }
+static inline vec8 v8_set1(unsigned char c) { return c; }
+static inline vec8 v8_add(vec8 a, vec8 b) { return (vec8) (a + b); }
+static inline vec8 v8_sub(vec8 a, vec8 b) { return (vec8) (a - b); }
+static inline vec8 v8_subs(vec8 a, vec8 b) { return a > b ? (vec8) (a - b) : 0; }
+static inline vec8 v8_and(vec8 a, vec8 b) { return a & b; }
+static inline vec8 v8_andnot(vec8 a, vec8 b) { return (vec8) (~a & b); }
+static inline vec8 v8_or(vec8 a, vec8 b) { return a | b; }
+static inline vec8 v8_xor(vec8 a, vec8 b) { return a ^ b; }
+static inline vec8 v8_eq(vec8 a, vec8 b) { return a == b ? 0xFF : 0x00; }
+static inline vec8 v8_max(vec8 a, vec8 b) { return a > b ? a : b; }
+static inline vec8 v8_select(vec8 m, vec8 a, vec8 b) { return m ? a : b; }
+static inline vec8 v8_srl1(vec8 a) { return a >> 1; }
+static inline vec8 v8_srl7(vec8 a) { return a >> 7; }
+static inline unsigned v8_count(vec8 m) { return m ? 1 : 0; }
+
+static inline vec16 v16_load(const uint16_t *p) { return *p; }
+static inline void v16_store(uint16_t *p, vec16 v) { *p = v; }
+static inline vec16 v16_set1(uint16_t c) { return c; }
+static inline vec16 v16_add(vec16 a, vec16 b) { return (vec16) (a + b); }
+static inline vec16 v16_and(vec16 a, vec16 b) { return a & b; }
+static inline vec16 v16_select(vec16 m, vec16 a, vec16 b) { return m ? a : b; }
+static inline vec16 v16_widen(const unsigned char *m) { return *m ? 0xFFFF : 0x0000; }
+
+#endif
+
+// dst = op(i) in the lanes selected by mask, for every vector of lanes in [begin, end)
+template <typename Op>
+static inline void apply(unsigned char *dst, const unsigned char *mask, size_t begin, size_t end, Op op)
+{
+    for (size_t i = begin; i < end; i += VEC8_LANES)
+    {
+        v8_store(dst + i, v8_select(v8_load(mask + i), op(i), v8_load(dst + i)));
+    }
+}
+
+// Sets a 16-bit register (PC or I) to the same value in the selected lanes
+static void setWord(uint16_t *dst, const unsigned char *mask, size_t begin, size_t end, unsigned short value)
+{
+    vec16 v = v16_set1(value);
+    for (size_t i = begin; i < end; i += VEC16_LANES)
+    {
+        v16_store(dst + i, v16_select(v16_widen(mask + i), v, v16_load(dst + i)));
+    }
+}
+
+// PC = pc + 2, or pc + 4 in the lanes where cond is set
+static void skip(uint16_t *pcs, const unsigned char *mask, const unsigned char *cond, size_t begin, size_t end, unsigned short pc)
+{
+    vec16 next = v16_set1((uint16_t) (pc + 2));
+    vec16 two = v16_set1(2);
+    for (size_t i = begin; i < end; i += VEC16_LANES)
+    {
+        vec16 target = v16_add(next, v16_and(v16_widen(cond + i), two));
+        v16_store(pcs + i, v16_select(v16_widen(mask + i), target, v16_load(pcs + i)));
+    }
+}
+
+chip8_lanes::chip8_lanes(size_t count) :
+    count(count),
+    stride((count + CHIP8_LANES_ALIGN - 1) / CHIP8_LANES_ALIGN * CHIP8_LANES_ALIGN),
+    cyclesPerFrame(CHIP8_DEFAULT_CYCLES_PER_FRAME),
+    V(16 * stride), I(stride), PC(stride), delay(stride), sound(stride), sp(stride),
+    stack(16 * stride), rng(stride),
+    memory(4096 * stride), gfx(32 * stride), input(16 * stride),
+    active(stride, 0), lockstep(stride), pending(stride), group(stride), cond(stride)
+{
+    memset(&active[0], 0xFF, count);
+
+    memset(image, 0, sizeof(image));
+    memcpy(image, chip8_fontset, sizeof(unsigned char) * 80);
+
+    seedRandom((uint32_t) time(NULL));
+    reset();
+}
+
+size_t chip8_lanes::size() const
+{
+    return count;
+}
+
+// loadGame() below applies the lanes' own, smaller size limit
+bool chip8_lanes::loadGame(const char *filename)
+{
+    std::vector<unsigned char> rom;
+    return chip8_read_rom(filename, rom) && loadGame(&rom[0], rom.size());
+}
+
+bool chip8_lanes::loadGame(const unsigned char *data, size_t size)
+{
+    if (size > CHIP8_LANES_ROM_MAX_SIZE) {
+        return false;
+    }
+
+    memset(image, 0, sizeof(image));
+    memcpy(image, chip8_fontset, sizeof(unsigned char) * 80);
+    memcpy(image + 0x0200, data, size);
+    reset();
+
+    return true;
+}
+
+// Puts every lane back at 0x200 with the current image loaded
+void chip8_lanes::reset()
+{
+    memset(&V[0], 0, V.size());
+    memset(&I[0], 0, I.size() * sizeof(uint16_t));
+    memset(&delay[0], 0, stride);
+    memset(&sound[0], 0, stride);
+    memset(&sp[0], 0, stride);
+    memset(&stack[0], 0, stack.size() * sizeof(uint16_t));
+    memset(&gfx[0], 0, gfx.size() * sizeof(uint64_t));
+    memset(&input[0], 0, input.size());
+
+    for (size_t i = 0; i < stride; ++i)
+    {
+        PC[i] = 0x0200;
+        memcpy(&memory[i * 4096], image, 4096);
+    }
+
+    memset(decoded, 0, sizeof(decoded));
+
+    total = 0;
+    vectorized = 0;
+}
+
+void chip8_lanes::seedRandom(uint32_t seed)
+{
+    for (size_t i = 0; i < stride; ++i)
+    {
+        // Same rule as chip8::seedRandom(): zero is a fixed point of xorshift
+        uint32_t s = seed + (uint32_t) i;
+        rng[i] = (s != 0) ? s : 0x2545F491u;
+    }
+}
+
+uint32_t chip8_lanes::nextRandom(size_t lane)
+{
+    uint32_t x = rng[lane];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng[lane] = x;
+    return x;
+}
+
+void chip8_lanes::setCyclesPerFrame(unsigned cycles)
+{
+    cyclesPerFrame = cycles;
+}
+
+unsigned char *chip8_lanes::keys(size_t lane)
+{
+    return &input[lane * 16];
+}
+
+void chip8_lanes::runFrames(unsigned frames)
+{
+    for (unsigned f = 0; f < frames; ++f)
+    {
+        memcpy(&lockstep[0], &active[0], stride);
+        for (unsigned c = 0; c < cyclesPerFrame; ++c)
+        {
+            step(cyclesPerFrame - c);
+        }
+        tickTimers();
+    }
+
+    total += (unsigned long long) frames * cyclesPerFrame * count;
+}
+
+unsigned short chip8_lanes::getPC(size_t lane) const
+{
+    return PC[lane];
+}
+
+const uint64_t *chip8_lanes::getFramebuffer(size_t lane) const
+{
+    return &gfx[lane * 32];
+}
+
+uint64_t chip8_lanes::framebufferHash(size_t lane) const
+{
+    return chip8::hashFramebuffer(&gfx[lane * 32]);
+}
+
+unsigned long long chip8_lanes::instructions() const
+{
+    return total;
+}
+
+unsigned long long chip8_lanes::vectorInstructions() const
+{
+    return vectorized;
+}
+
+// Decoded instruction from the loaded image, or OP_PRIVATE
+const chip8_insn &chip8_lanes::fetch(unsigned short pc)
+{
+    chip8_insn &in = decoded[pc];
+    if (in.op == chip8::OP_DECODE) {
+        in = chip8::decode((image[pc] << 8) | image[(pc + 1) & 0x0FFF]);
+    }
+    return in;
+}
+
+/*
+ * Runs one instruction on every lane still in lockstep. A lane that cannot
+ * join a big enough group runs the remaining steps of the frame on its own
+ * (lanes are independent within a frame) and is regrouped at the next one.
+ */
+void chip8_lanes::step(unsigned left)
+{
+    memcpy(&pending[0], &lockstep[0], stride);
+
+    size_t lead = 0;
+    for (;;)
+    {
+        while (lead < count && !pending[lead])
+        {
+            ++lead;
+        }
+        if (lead == count) {
+            break;
+        }
+
+        // Some lane stored to these bytes, lanes may not agree on the instruction
+        unsigned short pc = PC[lead];
+        if (decoded[pc & 0x0FFF].op == OP_PRIVATE) {
+            runAhead(lead, left);
+            pending[lead] = 0;
+            continue;
+        }
+
+        size_t members = gatherGroup(pc, lead);
+        if (members < CHIP8_LANES_MIN_GROUP) {
+            break;
+        }
+
+        if (runVector(fetch(pc & 0x0FFF), pc)) {
+            vectorized += members;
+        } else {
+            for (size_t i = lead; i < groupEnd; ++i)
+            {
+                if (group[i]) {
+                    runLane(i, 1);
+                }
+            }
+        }
+
+        for (size_t i = groupBegin; i < groupEnd; i += VEC8_LANES)
+        {
+            v8_store(&pending[i], v8_andnot(v8_load(&group[i]), v8_load(&pending[i])));
+        }
+    }
+
+    // Lanes that have drifted apart
+    for (size_t i = lead; i < count; ++i)
+    {
+        if (pending[i]) {
+            runAhead(i, left);
+        }
+    }
+}
+
+// Runs a lane on its own for the rest of the frame
+void chip8_lanes::runAhead(size_t lane, unsigned steps)
+{
+    runLane(lane, steps);
+    lockstep[lane] = 0;
+}
+
+/*
+ * group = pending lanes sharing the image whose PC is pc, returns how many
+ * there are. Nothing before lead is pending; the kernels only visit
+ * [groupBegin, groupEnd), the vectors that hold members.
+ */
+size_t chip8_lanes::gatherGroup(unsigned short pc, size_t lead)
+{
+    size_t members = 0;
+
+    groupBegin = lead / VEC8_LANES * VEC8_LANES;
+    groupEnd = groupBegin;
+
+#if VEC8_LANES == 2 * VEC16_LANES
+    vec16 target = v16_set1(pc);
+    for (size_t i = groupBegin; i < stride; i += VEC8_LANES)
+    {
+        vec8 hit = v16_narrow(v16_eq(v16_load(&PC[i]), target),
+                              v16_eq(v16_load(&PC[i + VEC16_LANES]), target));
+        hit = v8_and(hit, v8_load(&pending[i]));
+        v8_store(&group[i], hit);
+
+        unsigned hits = v8_count(hit);
+        if (hits != 0) {
+            members += hits;
+            groupEnd = i + VEC8_LANES;
+        }
+    }
+#else
+    for (size_t i = groupBegin; i < stride; ++i)
+    {
+        group[i] = (PC[i] == pc) ? pending[i] : 0;
+        if (group[i]) {
+            ++members;
+            groupEnd = i + 1;
+        }
+    }
+#endif
+
+    return members;
+}
+
+/*
+ * Runs in on every lane in group, all sitting at pc. Returns false for
+ * opcodes without a vector kernel, which the caller runs lane by lane.
+ * Where the scalar interpreter writes VF before VX the kernels make the
+ * same two passes, so X or Y being F behaves the same.
+ */
+bool chip8_lanes::runVector(const chip8_insn &in, unsigned short pc)
+{
+    const size_t b = groupBegin;
+    const size_t e = groupEnd;
+    const unsigned char *m = &group[0];
+    unsigned char *vx = &V[in.x * stride];
+    unsigned char *vy = &V[in.y * stride];
+    unsigned char *vf = &V[0xF * stride];
+    const vec8 one = v8_set1(1);
+    const vec8 nn = v8_set1(in.nn);
+
+    switch (in.op)
+    {
+    case chip8::OP_1NNN:
+        setWord(&PC[0], m, b, e, in.nnn);
+        return true;
+
+    case chip8::OP_3XNN:
+        apply(&cond[0], m, b, e, [&](size_t i) { return v8_eq(v8_load(vx + i), nn); });
+        break;
+
+    case chip8::OP_4XNN:
+        apply(&cond[0], m, b, e, [&](size_t i) { return v8_andnot(v8_eq(v8_load(vx + i), nn), v8_set1(0xFF)); });
+        break;
+
+    case chip8::OP_5XY0:
+        apply(&cond[0], m, b, e, [&](size_t i) { return v8_eq(v8_load(vx + i), v8_load(vy + i)); });
+        break;
+
+    case chip8::OP_9XY0:
+        apply(&cond[0], m, b, e, [&](size_t i) { return v8_andnot(v8_eq(v8_load(vx + i), v8_load(vy + i)), v8_set1(0xFF)); });
+        break;
+
+    case chip8::OP_6XNN:
+        apply(vx, m, b, e, [&](size_t) { return nn; });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_7XNN:
+        apply(vx, m, b, e, [&](size_t i) { return v8_add(v8_load(vx + i), nn); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XY0:
+        apply(vx, m, b, e, [&](size_t i) { return v8_load(vy + i); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XY1:
+        apply(vx, m, b, e, [&](size_t i) { return v8_or(v8_load(vx + i), v8_load(vy + i)); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XY2:
+        apply(vx, m, b, e, [&](size_t i) { return v8_and(v8_load(vx + i), v8_load(vy + i)); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XY3:
+        apply(vx, m, b, e, [&](size_t i) { return v8_xor(v8_load(vx + i), v8_load(vy + i)); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XY4:
+        // Carry out of x + y: the wrapped sum is smaller than x
+        apply(vf, m, b, e, [&](size_t i) {
+            vec8 x = v8_load(vx + i);
+            vec8 sum = v8_add(x, v8_load(vy + i));
+            return v8_andnot(v8_eq(v8_max(sum, x), sum), one);
+        });
+        apply(vx, m, b, e, [&](size_t i) { return v8_add(v8_load(vx + i), v8_load(vy + i)); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XY5:
+        apply(vf, m, b, e, [&](size_t i) {
+            vec8 x = v8_load(vx + i);
+            return v8_and(v8_eq(v8_max(x, v8_load(vy + i)), x), one);
+        });
+        apply(vx, m, b, e, [&](size_t i) { return v8_sub(v8_load(vx + i), v8_load(vy + i)); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XY6:
+        apply(vf, m, b, e, [&](size_t i) { return v8_and(v8_load(vx + i), one); });
+        apply(vx, m, b, e, [&](size_t i) { return v8_srl1(v8_load(vx + i)); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XY7:
+        apply(vf, m, b, e, [&](size_t i) {
+            vec8 y = v8_load(vy + i);
+            return v8_and(v8_eq(v8_max(v8_load(vx + i), y), y), one);
+        });
+        apply(vx, m, b, e, [&](size_t i) { return v8_sub(v8_load(vy + i), v8_load(vx + i)); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XYE:
+        apply(vf, m, b, e, [&](size_t i) { return v8_srl7(v8_load(vx + i)); });
+        apply(vx, m, b, e, [&](size_t i) { vec8 x = v8_load(vx + i); return v8_add(x, x); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_8XYU:
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_ANNN:
+        setWord(&I[0], m, b, e, in.nnn);
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_FX07:
+        apply(vx, m, b, e, [&](size_t i) { return v8_load(&delay[i]); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_FX15:
+        apply(&delay[0], m, b, e, [&](size_t i) { return v8_load(vx + i); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    case chip8::OP_FX18:
+        apply(&sound[0], m, b, e, [&](size_t i) { return v8_load(vx + i); });
+        setWord(&PC[0], m, b, e, pc + 2);
+        return true;
+
+    default:
+        return false;
+    }
+
+    // Conditional skips
+    skip(&PC[0], m, &cond[0], b, e, pc);
+    return true;
+}
+
+// A store by one lane. Instructions covering the byte are no longer shared.
+void chip8_lanes::store(size_t lane, unsigned short addr, unsigned char value)
+{
+    addr &= 0x0FFF;
+    memory[lane * 4096 + addr] = value;
+    decoded[addr].op = OP_PRIVATE;
+    decoded[(addr - 1) & 0x0FFF].op = OP_PRIVATE;
+}
+
+/*
+ * Scalar reference: runs steps instructions on one lane with the same
+ * semantics as chip8::execute(). The lane fetches from the shared decoded
+ * image unless some lane has stored to the instruction bytes.
+ */
+void chip8_lanes::runLane(size_t lane, unsigned steps)
+{
+    const size_t s = stride;
+    unsigned char *v = &V[lane];
+    unsigned char *mem = &memory[lane * 4096];
+    uint16_t *stk = &stack[lane * 16];
+    const unsigned char *key = &input[lane * 16];
+    unsigned short pc = PC[lane];
+    unsigned short i = I[lane];
+
+#define REG(r) v[(r) * s]
+
+    for (unsigned n = 0; n < steps; ++n)
+    {
+        unsigned short at = pc & 0x0FFF;
+        chip8_insn in = fetch(at);
+        if (in.op == OP_PRIVATE) {
+            in = chip8::decode((mem[at] << 8) | mem[(at + 1) & 0x0FFF]);
+        }
+
+        switch (in.op)
+        {
+        case chip8::OP_00E0:
+            memset(&gfx[lane * 32], 0, sizeof(uint64_t) * 32);
+            pc += 2;
+            break;
+
+        case chip8::OP_00EE:
+            pc = stk[--sp[lane] & 0x0F];
+            pc += 2;
+            break;
+
+        case chip8::OP_1NNN:
+            pc = in.nnn;
+            break;
+
+        case chip8::OP_2NNN:
+            stk[sp[lane]++ & 0x0F] = pc;
+            pc = in.nnn;
+            break;
+
+        case chip8::OP_3XNN:
+            pc += (REG(in.x) == in.nn) ? 4 : 2;
+            break;
+
+        case chip8::OP_4XNN:
+            pc += (REG(in.x) != in.nn) ? 4 : 2;
+            break;
+
+        case chip8::OP_5XY0:
+            pc += (REG(in.x) == REG(in.y)) ? 4 : 2;
+            break;
+
+        case chip8::OP_6XNN:
+            REG(in.x) = in.nn;
+            pc += 2;
+            break;
+
+        case chip8::OP_7XNN:
+            REG(in.x) += in.nn;
+            pc += 2;
+            break;
+
+        case chip8::OP_8XY0:
+            REG(in.x) = REG(in.y);
+            pc += 2;
+            break;
+
+        case chip8::OP_8XY1:
+            REG(in.x) |= REG(in.y);
+            pc += 2;
+            break;
+
+        case chip8::OP_8XY2:
+            REG(in.x) &= REG(in.y);
+            pc += 2;
+            break;
+
+        case chip8::OP_8XY3:
+            REG(in.x) ^= REG(in.y);
+            pc += 2;
+            break;
+
+        case chip8::OP_8XY4:
+            REG(0xF) = REG(in.x) > (0xFF - REG(in.y));
+            REG(in.x) += REG(in.y);
+            pc += 2;
+            break;
+
+        case chip8::OP_8XY5:
+            REG(0xF) = REG(in.x) >= REG(in.y);
+            REG(in.x) -= REG(in.y);
+            pc += 2;
+            break;
+
+        case chip8::OP_8XY6:
+            REG(0xF) = REG(in.x) & 0x1;
+            REG(in.x) >>= 1;
+            pc += 2;
+            break;
+
+        case chip8::OP_8XY7:
+            REG(0xF) = REG(in.x) <= REG(in.y);
+            REG(in.x) = REG(in.y) - REG(in.x);
+            pc += 2;
+            break;
+
+        case chip8::OP_8XYE:
+            REG(0xF) = REG(in.x) >> 7;
+            REG(in.x) <<= 1;
+            pc += 2;
+            break;
+
+        case chip8::OP_8XYU:
+            pc += 2;
+            break;
+
+        case chip8::OP_9XY0:
+            pc += (REG(in.x) != REG(in.y)) ? 4 : 2;
+            break;
+
+        case chip8::OP_ANNN:
+            i = in.nnn;
+            pc += 2;
+            break;
+
+        case chip8::OP_BNNN:
+            pc = in.nnn + REG(0);
+            break;
+
+        case chip8::OP_CXNN:
+            REG(in.x) = (nextRandom(lane) % 0xFF) & in.nn;
+            pc += 2;
+            break;
+
+        case chip8::OP_DXYN:
+        {
+            // Same rotate-and-XOR drawing as chip8::drawSprite()
+            unsigned char x = REG(in.x) & 63;
+            unsigned char y = REG(in.y) & 31;
+            uint64_t *rows = &gfx[lane * 32];
+            uint64_t collision = 0;
+
+            for (int yline = 0; yline < (in.nn & 0x0F); yline++)
+            {
+                uint64_t line = (uint64_t) mem[(i + yline) & 0x0FFF] << 56;
+                if (x != 0) {
+                    line = (line >> x) | (line << (64 - x));
+                }
+
+                uint64_t &row = rows[(y + yline) & 31];
+                collision |= row & line;
+                row ^= line;
+            }
+
+            REG(0xF) = collision != 0;
+            pc += 2;
+        }
+        break;
+
+        case chip8::OP_EX9E:
+            pc += (key[REG(in.x) & 0xF] != 0) ? 4 : 2;
+            break;
+
+        case chip8::OP_EXA1:
+            pc += (key[REG(in.x) & 0xF] == 0) ? 4 : 2;
+            break;
+
+        case chip8::OP_FX07:
+            REG(in.x) = delay[lane];
+            pc += 2;
+            break;
+
+        case chip8::OP_FX0A:
+        {
+            bool keyPress = false;
+
+            for (int k = 0; k < 16; ++k)
+            {
+                if (key[k] != 0)
+                {
+                    REG(in.x) = k;
+                    keyPress = true;
+                }
+            }
+
+            if (keyPress) {
+                pc += 2;
+            }
+        }
+        break;
+
+        case chip8::OP_FX15:
+            delay[lane] = REG(in.x);
+            pc += 2;
+            break;
+
+        case chip8::OP_FX18:
+            sound[lane] = REG(in.x);
+            pc += 2;
+            break;
+
+        case chip8::OP_FX1E:
+            REG(0xF) = (i + REG(in.x)) > 0xFFF;
+            i += REG(in.x);
+            pc += 2;
+            break;
+
+        case chip8::OP_FX29:
+            i = REG(in.x) * 0x5;
+            pc += 2;
+            break;
+
+        case chip8::OP_FX33:
+        {
+            unsigned char vx = REG(in.x);
+            store(lane, i,      vx / 100);
+            store(lane, i + 1, (vx / 10) % 10);
+            store(lane, i + 2,  vx % 10);
+            pc += 2;
+        }
+        break;
+
+        case chip8::OP_FX55:
+            for (int r = 0; r <= in.x; ++r)
+            {
+                store(lane, i + r, REG(r));
+            }
+            i += in.x + 1;
+            pc += 2;
+            break;
+
+        case chip8::OP_FX65:
+            for (int r = 0; r <= in.x; ++r)
+            {
+                REG(r) = mem[(i + r) & 0x0FFF];
+            }
+            i += in.x + 1;
+            pc += 2;
+            break;
+
+        // Unknown opcodes and 0NNN stay where they are
+        default:
+            break;
+        }
+    }
+
+#undef REG
+
+    PC[lane] = pc;
+    I[lane] = i;
+}
+
+// Decrements every lane's timers, called at 60 Hz
+void chip8_lanes::tickTimers()
+{
+    const vec8 one = v8_set1(1);
+    for (size_t i = 0; i < stride; i += VEC8_LANES)
+    {
+        v8_store(&delay[i], v8_subs(v8_load(&delay[i]), one));
+        v8_store(&sound[i], v8_subs(v8_load(&sound[i]), one));
+    }
+}
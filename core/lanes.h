@@ -0,0 +1,102 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "chip8.h"
+
+#define CHIP8_LANES_ALIGN       32  // Lanes are padded to a multiple of the widest vector
+#define CHIP8_LANES_MIN_GROUP   8   // Smaller groups of lanes at one PC run scalar
+#define CHIP8_LANES_ROM_MAX_SIZE    (4096 - 0x0200) // Plain CHIP-8 memory only
+
+/*
+ * Lockstep engine: many instances of the same ROM stored as structure of
+ * arrays (V0 of every lane, then V1, ...), so one decoded instruction can be
+ * applied to every lane sitting at the same PC with SSE2/AVX2 kernels.
+ *
+ * Each step gathers the lanes at a common PC into a byte mask and runs the
+ * instruction on all of them at once. Register, timer and branch opcodes are
+ * vectorized; the rest (drawing, memory, keys, calls, CXNN) loop over the
+ * masked lanes. When lanes have diverged into groups too small to pay for
+ * the mask, or reach code some lane has modified, they finish the frame one
+ * at a time and are regrouped at the start of the next frame.
+ * Every lane behaves exactly like a chip8 instance with the same seed,
+ * as long as the ROM sticks to 64x32 CHIP-8 with the modern quirks.
+ */
+class chip8_lanes
+{
+public:
+    explicit chip8_lanes(size_t count);
+
+    size_t size() const;
+
+    bool loadGame(const char *filename);
+    bool loadGame(const unsigned char *data, size_t size);
+    void seedRandom(uint32_t seed);                 // Lane i gets seed + i
+    void setCyclesPerFrame(unsigned cycles);
+
+    unsigned char *keys(size_t lane);               // Input array of one lane
+    void runFrames(unsigned frames);
+
+    unsigned short getPC(size_t lane) const;
+    const uint64_t *getFramebuffer(size_t lane) const;
+    uint64_t framebufferHash(size_t lane) const;
+
+    unsigned long long instructions() const;        // Total run by all lanes
+    unsigned long long vectorInstructions() const;  // Of those, run by vector kernels
+
+private:
+    size_t count;
+    size_t stride;                                  // count rounded up to CHIP8_LANES_ALIGN
+    unsigned cyclesPerFrame;
+
+    // Per-lane registers, lane-major within each array
+    std::vector<unsigned char> V;                   // 16 * stride, V[x * stride + lane]
+    std::vector<uint16_t> I;
+    std::vector<uint16_t> PC;
+    std::vector<unsigned char> delay;
+    std::vector<unsigned char> sound;
+    std::vector<unsigned char> sp;
+    std::vector<uint16_t> stack;                    // 16 per lane
+    std::vector<uint32_t> rng;
+
+    // Per-lane bulk state, instance-major
+    std::vector<unsigned char> memory;              // 4096 per lane
+    std::vector<uint64_t> gfx;                      // 32 rows per lane
+    std::vector<unsigned char> input;               // 16 keys per lane
+
+    // Step masks, 0xFF or 0x00 per lane
+    std::vector<unsigned char> active;              // Real lanes, not padding
+    std::vector<unsigned char> lockstep;            // Not run ahead this frame
+    std::vector<unsigned char> pending;             // Not stepped yet this cycle
+    std::vector<unsigned char> group;               // Lanes running the current instruction
+    std::vector<unsigned char> cond;                // Skip results
+    size_t groupBegin;                              // Vectors holding group members
+    size_t groupEnd;
+
+    /*
+     * The program as loaded, decoded on demand and shared by all lanes.
+     * A store by any lane turns the entries covering that byte private:
+     * lanes then decode those addresses from their own memory, one by one.
+     */
+    unsigned char image[4096];
+    chip8_insn decoded[4096];
+
+    unsigned long long total;
+    unsigned long long vectorized;
+
+    void reset();
+    void step(unsigned left);
+    void runAhead(size_t lane, unsigned steps);
+    size_t gatherGroup(unsigned short pc, size_t lead);
+    bool runVector(const chip8_insn &in, unsigned short pc);
+    void runLane(size_t lane, unsigned steps);
+    void store(size_t lane, unsigned short addr, unsigned char value);
+    void tickTimers();
+    const chip8_insn &fetch(unsigned short pc);
+    uint32_t nextRandom(size_t lane);
+};
+
+#endif // LANES_H
@@ -0,0 +1,305 @@
+#include "library.h"
+#include "chip8.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+uint64_t chip8_rom_hash(const unsigned char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool chip8_rom_hash(const char *filename, uint64_t &hash)
+{
+    std::vector<unsigned char> rom;
+    if (!chip8_read_rom(filename, rom)) {
+        return false;
+    }
+
+    hash = chip8_rom_hash(&rom[0], rom.size());
+    return true;
+}
+
+bool chip8_read_rom(const char *filename, std::vector<unsigned char> &rom)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    // One byte more than fits, so oversized files are rejected. On the heap:
+    // this runs on GUI and pool threads, whose stacks may be small
+    rom.resize(CHIP8_ROM_MAX_SIZE + 1);
+    size_t size = fread(&rom[0], 1, rom.size(), fp);
+    bool ok = !ferror(fp);
+    fclose(fp);
+
+    if (!ok || size == 0 || size > CHIP8_ROM_MAX_SIZE) {
+        rom.clear();
+        return false;
+    }
+
+    rom.resize(size);
+    return true;
+}
+
+// Case-insensitive, so "pong" finds PONG
+static int compareNames(const char *a, const char *b)
+{
+    for (;; ++a, ++b)
+    {
+        int ca = tolower((unsigned char) *a);
+        int cb = tolower((unsigned char) *b);
+        if (ca != cb || ca == 0) {
+            return ca - cb;
+        }
+    }
+}
+
+chip8_library::chip8_library() : entries(NULL), count(0)
+{
+}
+
+bool chip8_library::open(const char *packFile)
+{
+    close();
+
+    const size_t maxSize = sizeof(chip8_pack_header)
+            + (size_t) CHIP8_PACK_MAX_ROMS * (sizeof(chip8_pack_entry) + CHIP8_ROM_MAX_SIZE);
+    if (!file.open(packFile, maxSize)) {
+        return false;
+    }
+
+    const unsigned char *data = file.data();
+    size_t length = file.size();
+
+    const chip8_pack_header *header = (const chip8_pack_header *) data;
+    if (length < sizeof(chip8_pack_header)
+            || memcmp(header->magic, CHIP8_PACK_MAGIC, 4) != 0
+            || header->version != CHIP8_PACK_VERSION
+            || header->byteOrder != CHIP8_PACK_BYTE_ORDER
+            || header->count > CHIP8_PACK_MAX_ROMS
+            || length < sizeof(chip8_pack_header) + header->count * sizeof(chip8_pack_entry)) {
+        close();
+        return false;
+    }
+
+    // Every ROM must lie inside the file and fit in memory
+    const chip8_pack_entry *table = (const chip8_pack_entry *) (data + sizeof(chip8_pack_header));
+    for (uint32_t i = 0; i < header->count; ++i)
+    {
+        const chip8_pack_entry &e = table[i];
+        if (memchr(e.name, 0, sizeof(e.name)) == NULL
+                || e.size == 0 || e.size > CHIP8_ROM_MAX_SIZE
+                || e.offset > length || e.size > length - e.offset
+                || (i > 0 && compareNames(table[i - 1].name, e.name) > 0)) {
+            close();
+            return false;
+        }
+    }
+
+    entries = table;
+    count = header->count;
+    return true;
+}
+
+void chip8_library::close()
+{
+    file.close();
+    entries = NULL;
+    count = 0;
+}
+
+size_t chip8_library::size() const
+{
+    return count;
+}
+
+const chip8_pack_entry &chip8_library::entry(size_t index) const
+{
+    return entries[index];
+}
+
+const unsigned char *chip8_library::image(const chip8_pack_entry &entry) const
+{
+    return file.data() + entry.offset;
+}
+
+const chip8_pack_entry *chip8_library::find(const char *nameOrHash) const
+{
+    // Entries are sorted by name
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        int c = compareNames(entries[mid].name, nameOrHash);
+        if (c == 0) {
+            return &entries[mid];
+        }
+        if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // Otherwise a hash, or the start of one, in hex
+    const char *digits = nameOrHash;
+    if (digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        digits += 2;
+    }
+    size_t length = strlen(digits);
+    if (length == 0 || length > 16 || strspn(digits, "0123456789abcdefABCDEF") != length) {
+        return NULL;
+    }
+
+    uint64_t prefix = strtoull(digits, NULL, 16);
+    unsigned shift = (unsigned) (16 - length) * 4;
+
+    const chip8_pack_entry *found = NULL;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if ((entries[i].hash >> shift) == prefix) {
+            if (found != NULL && found->hash != entries[i].hash) {
+                return NULL;    // Ambiguous
+            }
+            found = &entries[i];
+        }
+    }
+    return found;
+}
+
+const chip8_pack_entry *chip8_library::findHash(uint64_t hash) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (entries[i].hash == hash) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+bool chip8_list_files(const char *directory, std::vector<std::string> &names)
+{
+#if defined(_WIN32)
+    std::string pattern = std::string(directory) + "\\*";
+    struct _finddata_t found;
+    intptr_t handle = _findfirst(pattern.c_str(), &found);
+    if (handle == -1) {
+        return false;
+    }
+    do
+    {
+        if (!(found.attrib & _A_SUBDIR)) {
+            names.push_back(found.name);
+        }
+    } while (_findnext(handle, &found) == 0);
+    _findclose(handle);
+#else
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        return false;
+    }
+    while (struct dirent *ent = readdir(dir))
+    {
+        std::string path = std::string(directory) + "/" + ent->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            names.push_back(ent->d_name);
+        }
+    }
+    closedir(dir);
+#endif
+    return true;
+}
+
+static bool byName(const chip8_pack_entry &a, const chip8_pack_entry &b)
+{
+    return compareNames(a.name, b.name) < 0;
+}
+
+bool chip8_library::build(const char *directory, const char *packFile, std::vector<std::string> *skipped)
+{
+    std::vector<std::string> names;
+    if (!chip8_list_files(directory, names)) {
+        return false;
+    }
+
+    std::vector<chip8_pack_entry> table;
+    std::vector<std::vector<unsigned char> > images;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        const std::string &name = names[i];
+        std::vector<unsigned char> rom;
+
+        // Hidden files, overlong names and anything that does not fit in memory are left out
+        if (name[0] == '.' || name.size() >= CHIP8_PACK_NAME_LENGTH
+                || table.size() == CHIP8_PACK_MAX_ROMS
+                || !chip8_read_rom((std::string(directory) + "/" + name).c_str(), rom)) {
+            if (skipped != NULL) {
+                skipped->push_back(name);
+            }
+            continue;
+        }
+
+        chip8_pack_entry e;
+        memset(&e, 0, sizeof(e));
+        strcpy(e.name, name.c_str());
+        e.hash = chip8_rom_hash(&rom[0], rom.size());
+        e.size = (uint32_t) rom.size();
+        e.offset = (uint32_t) images.size();    // Index for now, see below
+        table.push_back(e);
+        images.push_back(rom);
+    }
+
+    std::sort(table.begin(), table.end(), byName);
+
+    // Images follow the table in name order
+    uint32_t offset = (uint32_t) (sizeof(chip8_pack_header) + table.size() * sizeof(chip8_pack_entry));
+    std::vector<size_t> order(table.size());
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        order[i] = table[i].offset;
+        table[i].offset = offset;
+        offset += table[i].size;
+    }
+
+    chip8_pack_header header;
+    memcpy(header.magic, CHIP8_PACK_MAGIC, 4);
+    header.version = CHIP8_PACK_VERSION;
+    header.byteOrder = CHIP8_PACK_BYTE_ORDER;
+    header.count = (uint32_t) table.size();
+    header.reserved = 0;
+
+    FILE *fp = fopen(packFile, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+            && (table.empty() || fwrite(&table[0], sizeof(chip8_pack_entry), table.size(), fp) == table.size());
+    for (size_t i = 0; ok && i < table.size(); ++i)
+    {
+        const std::vector<unsigned char> &rom = images[order[i]];
+        ok = fwrite(&rom[0], 1, rom.size(), fp) == rom.size();
+    }
+
+    return (fclose(fp) == 0) && ok;
+}
@@ -0,0 +1,85 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mapfile.h"
+
+#define CHIP8_PACK_MAGIC        "C8PK"
+#define CHIP8_PACK_VERSION      1
+#define CHIP8_PACK_BYTE_ORDER   0x0102
+#define CHIP8_PACK_MAX_ROMS     4096
+#define CHIP8_PACK_NAME_LENGTH  40          // Including the terminating NUL
+
+// FNV-1a over a ROM image, used to identify ROMs independent of their file name
+uint64_t chip8_rom_hash(const unsigned char *data, size_t size);
+bool chip8_rom_hash(const char *filename, uint64_t &hash);
+
+// Reads a ROM file, rejecting empty files and files larger than CHIP8_ROM_MAX_SIZE
+bool chip8_read_rom(const char *filename, std::vector<unsigned char> &rom);
+
+// Names of the regular files in a directory, in no particular order
+bool chip8_list_files(const char *directory, std::vector<std::string> &names);
+
+/*
+ * ROM pack: this header, count entries sorted by name, then the ROM images.
+ * Every entry is validated when the pack is opened, so a ROM from an open
+ * pack can always be loaded as is.
+ */
+struct chip8_pack_header
+{
+    char magic[4];              // CHIP8_PACK_MAGIC, not NUL terminated
+    uint16_t version;           // CHIP8_PACK_VERSION
+    uint16_t byteOrder;         // CHIP8_PACK_BYTE_ORDER as written by the host
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct chip8_pack_entry
+{
+    char name[CHIP8_PACK_NAME_LENGTH];  // File name the ROM was indexed from, NUL terminated
+    uint64_t hash;                      // chip8_rom_hash() of the image
+    uint32_t offset;                    // Of the image, from the start of the pack
+    uint32_t size;                      // 1 to CHIP8_ROM_MAX_SIZE bytes
+    uint32_t reserved[2];
+};
+
+static_assert(sizeof(chip8_pack_header) == 16, "chip8_pack_header must stay 16 bytes");
+static_assert(sizeof(chip8_pack_entry) == 64, "chip8_pack_entry must stay 64 bytes");
+
+/*
+ * A ROM pack opened for reading. The whole pack is memory-mapped once;
+ * switching ROMs afterwards is a lookup and a copy into the machine.
+ */
+class chip8_library
+{
+public:
+    chip8_library();
+
+    bool open(const char *packFile);
+    void close();
+
+    size_t size() const;
+    const chip8_pack_entry &entry(size_t index) const;
+    const unsigned char *image(const chip8_pack_entry &entry) const;
+
+    // By name (case-insensitive), then by hash or a unique hex prefix of one; NULL if none
+    const chip8_pack_entry *find(const char *nameOrHash) const;
+    const chip8_pack_entry *findHash(uint64_t hash) const;
+
+    // Indexes every ROM file in directory into packFile; files that are not ROMs go into skipped
+    static bool build(const char *directory, const char *packFile, std::vector<std::string> *skipped = NULL);
+
+private:
+    chip8_library(const chip8_library &) = delete;
+    chip8_library &operator=(const chip8_library &) = delete;
+
+    chip8_mapped_file file;
+    const chip8_pack_entry *entries;
+    size_t count;
+};
+
+#endif // LIBRARY_H
@@ -0,0 +1,90 @@
+#include "mapfile.h"
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+chip8_mapped_file::chip8_mapped_file() : mapping(NULL), length(0)
+{
+}
+
+chip8_mapped_file::~chip8_mapped_file()
+{
+    close();
+}
+
+bool chip8_mapped_file::open(const char *filename, size_t maxSize)
+{
+    close();
+
+#ifdef CHIP8_HAVE_MMAP
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (unsigned long long) st.st_size > maxSize) {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+
+    mapping = p;
+    length = (size_t) st.st_size;
+#else
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    // One byte more than allowed, so oversized files are caught
+    std::vector<unsigned char> data(maxSize + 1);
+    size_t size = fread(&data[0], 1, data.size(), fp);
+    fclose(fp);
+    if (size == 0 || size > maxSize) {
+        return false;
+    }
+
+    data.resize(size);
+    buffer.swap(data);
+    length = size;
+#endif
+
+    return true;
+}
+
+void chip8_mapped_file::close()
+{
+#ifdef CHIP8_HAVE_MMAP
+    if (mapping != NULL) {
+        munmap(mapping, length);
+    }
+#endif
+    mapping = NULL;
+    length = 0;
+    std::vector<unsigned char>().swap(buffer);
+}
+
+const unsigned char *chip8_mapped_file::data() const
+{
+    if (mapping != NULL) {
+        return (const unsigned char *) mapping;
+    }
+    return buffer.empty() ? NULL : &buffer[0];
+}
+
+size_t chip8_mapped_file::size() const
+{
+    return length;
+}
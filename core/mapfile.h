@@ -0,0 +1,33 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stddef.h>
+#include <vector>
+
+/*
+ * A whole file opened read-only, memory-mapped where the platform allows
+ * it and read into a buffer otherwise. Files larger than maxSize are
+ * rejected before anything is mapped or read.
+ */
+class chip8_mapped_file
+{
+public:
+    chip8_mapped_file();
+    ~chip8_mapped_file();
+
+    bool open(const char *filename, size_t maxSize);
+    void close();
+
+    const unsigned char *data() const;  // NULL unless open() succeeded
+    size_t size() const;
+
+private:
+    chip8_mapped_file(const chip8_mapped_file &) = delete;
+    chip8_mapped_file &operator=(const chip8_mapped_file &) = delete;
+
+    void *mapping;
+    size_t length;
+    std::vector<unsigned char> buffer;
+};
+
+#endif // MAPFILE_H
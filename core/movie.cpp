@@ -0,0 +1,157 @@
+#include "movie.h"
+#include <cstring>
+
+chip8_movie_writer::chip8_movie_writer() : fp(NULL)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+chip8_movie_writer::~chip8_movie_writer()
+{
+    if (fp != NULL) {
+        fclose(fp);
+    }
+}
+
+bool chip8_movie_writer::open(const char *filename, uint32_t seed, unsigned cyclesPerFrame, uint64_t romHash, unsigned quirks)
+{
+    if (fp != NULL) {
+        fclose(fp);
+    }
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHIP8_MOVIE_MAGIC, 4);
+    header.version = CHIP8_MOVIE_VERSION;
+    header.byteOrder = CHIP8_MOVIE_BYTE_ORDER;
+    header.seed = seed;
+    header.cyclesPerFrame = cyclesPerFrame;
+    header.romHash = romHash;
+    header.quirks = quirks;
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        fp = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+bool chip8_movie_writer::writeFrame(const unsigned char key[16])
+{
+    if (fp == NULL) {
+        return false;
+    }
+
+    unsigned mask = 0;
+    for (int k = 0; k < 16; ++k)
+    {
+        if (key[k] != 0) {
+            mask |= 1u << k;
+        }
+    }
+
+    unsigned char bytes[2] = { (unsigned char) (mask & 0xFF), (unsigned char) (mask >> 8) };
+    if (fwrite(bytes, 1, 2, fp) != 2) {
+        return false;
+    }
+
+    ++header.frames;
+    return true;
+}
+
+bool chip8_movie_writer::close(uint64_t finalHash)
+{
+    if (fp == NULL) {
+        return false;
+    }
+
+    header.finalHash = finalHash;
+    bool ok = fseek(fp, 0, SEEK_SET) == 0
+            && fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = (fclose(fp) == 0) && ok;
+    fp = NULL;
+
+    return ok;
+}
+
+bool chip8_movie_writer::isOpen() const
+{
+    return fp != NULL;
+}
+
+uint32_t chip8_movie_writer::frames() const
+{
+    return header.frames;
+}
+
+chip8_movie_reader::chip8_movie_reader() : fp(NULL), read(0)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+chip8_movie_reader::~chip8_movie_reader()
+{
+    close();
+}
+
+bool chip8_movie_reader::open(const char *filename)
+{
+    close();
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1
+            || memcmp(header.magic, CHIP8_MOVIE_MAGIC, 4) != 0
+            || header.version != CHIP8_MOVIE_VERSION
+            || header.byteOrder != CHIP8_MOVIE_BYTE_ORDER
+            || header.cyclesPerFrame == 0) {
+        close();
+        return false;
+    }
+
+    read = 0;
+    return true;
+}
+
+void chip8_movie_reader::close()
+{
+    if (fp != NULL) {
+        fclose(fp);
+        fp = NULL;
+    }
+}
+
+const chip8_movie_header &chip8_movie_reader::getHeader() const
+{
+    return header;
+}
+
+bool chip8_movie_reader::readFrame(unsigned char key[16])
+{
+    if (fp == NULL || (header.frames != 0 && read == header.frames)) {
+        return false;
+    }
+
+    unsigned char bytes[2];
+    if (fread(bytes, 1, 2, fp) != 2) {
+        return false;
+    }
+
+    unsigned mask = bytes[0] | (bytes[1] << 8);
+    for (int k = 0; k < 16; ++k)
+    {
+        key[k] = (mask >> k) & 1;
+    }
+
+    ++read;
+    return true;
+}
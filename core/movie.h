@@ -0,0 +1,78 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "library.h"
+
+#define CHIP8_MOVIE_MAGIC       "C8MV"
+#define CHIP8_MOVIE_VERSION     1
+#define CHIP8_MOVIE_BYTE_ORDER  0x0102
+
+/*
+ * Input movie: this header, then one little-endian 16-bit key mask per
+ * frame (bit k set when key k is down for that frame). A movie starts
+ * from a freshly loaded ROM seeded with seed, so replaying the masks
+ * through setKeys()/runFrame() reproduces the run bit for bit.
+ * frames and finalHash are filled in when the recording is closed; a
+ * movie that was never closed has frames == 0 and is read to its end.
+ */
+struct chip8_movie_header
+{
+    char magic[4];              // CHIP8_MOVIE_MAGIC, not NUL terminated
+    uint16_t version;           // CHIP8_MOVIE_VERSION
+    uint16_t byteOrder;         // CHIP8_MOVIE_BYTE_ORDER as written by the host
+    uint32_t seed;              // chip8::seedRandom() before the first frame
+    uint32_t cyclesPerFrame;
+    uint32_t frames;
+    uint32_t quirks;            // chip8::Quirks the run used, QUIRKS_MODERN (0) in older movies
+    uint64_t romHash;           // chip8_rom_hash() of the ROM image
+    uint64_t finalHash;         // chip8::framebufferHash() after the last frame
+};
+
+static_assert(sizeof(chip8_movie_header) == 40, "chip8_movie_header must stay 40 bytes");
+
+// Streams frames to disk as they are played
+class chip8_movie_writer
+{
+public:
+    chip8_movie_writer();
+    ~chip8_movie_writer();
+
+    bool open(const char *filename, uint32_t seed, unsigned cyclesPerFrame, uint64_t romHash, unsigned quirks);
+    bool writeFrame(const unsigned char key[16]);
+    bool close(uint64_t finalHash);     // Completes the header
+    bool isOpen() const;
+    uint32_t frames() const;
+
+private:
+    chip8_movie_writer(const chip8_movie_writer &) = delete;
+    chip8_movie_writer &operator=(const chip8_movie_writer &) = delete;
+
+    FILE *fp;
+    chip8_movie_header header;
+};
+
+class chip8_movie_reader
+{
+public:
+    chip8_movie_reader();
+    ~chip8_movie_reader();
+
+    bool open(const char *filename);
+    void close();
+    const chip8_movie_header &getHeader() const;
+    bool readFrame(unsigned char key[16]);  // False at the end of the movie
+
+private:
+    chip8_movie_reader(const chip8_movie_reader &) = delete;
+    chip8_movie_reader &operator=(const chip8_movie_reader &) = delete;
+
+    FILE *fp;
+    chip8_movie_header header;
+    uint32_t read;
+};
+
+#endif // MOVIE_H
@@ -0,0 +1,30 @@
+#include "native.h"
+
+// Built on first use, since registrations run during static initialization in any order
+static std::vector<const chip8_native_program *> &registry()
+{
+    static std::vector<const chip8_native_program *> programs;
+    return programs;
+}
+
+chip8_native_registration::chip8_native_registration(const chip8_native_program &program)
+{
+    registry().push_back(&program);
+}
+
+const std::vector<const chip8_native_program *> &chip8_native_programs()
+{
+    return registry();
+}
+
+const chip8_native_program *chip8_native_find(uint64_t romHash)
+{
+    const std::vector<const chip8_native_program *> &programs = registry();
+    for (size_t i = 0; i < programs.size(); ++i)
+    {
+        if (programs[i]->romHash == romHash) {
+            return programs[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,141 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "chip8.h"
+
+#define CHIP8_NATIVE_MAX_LENGTH     64          // Instructions per recompiled block
+
+// What a block returns: where to go on, how many instructions it ran and whether the batch is over
+#define CHIP8_NATIVE_EXIT(pc, ran)  ((uint32_t) (unsigned short) (pc) | (uint32_t) (ran) << 16)
+#define CHIP8_NATIVE_IDLE           0x80000000u // The rest of the batch was skipped as an idle loop
+#define CHIP8_NATIVE_PC(exit)       ((unsigned short) ((exit) & 0xFFFF))
+#define CHIP8_NATIVE_RAN(exit)      (((exit) >> 16) & 0x7FFF)
+
+/*
+ * The machine as recompiled code sees it (see recompiler.h). Blocks work on
+ * the registers and memory in place and call back for whatever they do not
+ * do themselves: drawing and the other display instructions run through
+ * the interpreter one at a time, and stores report whether they overwrote
+ * recompiled code, in which case the block returns right after the store.
+ */
+class chip8_native
+{
+public:
+    explicit chip8_native(chip8 &emu) :
+        V(emu.V), memory(emu.memory), key(emu.key), stack(emu.stack),
+        sp(emu.sp), I(emu.I), delay_timer(emu.delay_timer), sound_timer(emu.sound_timer),
+        position(0), left(0), emu(emu)
+    {
+    }
+
+    unsigned char *const V;
+    unsigned char *const memory;
+    const unsigned char *const key;
+    unsigned short *const stack;
+    unsigned short &sp;
+    unsigned short &I;
+    unsigned char &delay_timer;
+    unsigned char &sound_timer;
+
+    unsigned long long position;        // Index in the batch of the block's first instruction
+    unsigned long long left;            // Instructions the block may run, at least 1
+
+    unsigned char random()
+    {
+        return emu.nextRandom() % 0xFF;
+    }
+
+    // The instruction at pc, run by the interpreter; true if it overwrote recompiled code
+    bool interpret(unsigned short pc)
+    {
+        return emu.nativeStep(pc);
+    }
+
+    // After a store of len bytes at addr; true if it overwrote recompiled code
+    bool written(unsigned short addr, unsigned short len)
+    {
+        emu.nativeStale = false;
+        emu.invalidate(addr, len);
+        return emu.nativeStale;
+    }
+
+    // FX18 at instruction k of the block started or stopped the tone
+    void soundEdge(unsigned k)
+    {
+        emu.soundEdge(position + k);
+    }
+
+    // FX0A: the highest key held goes into VX, false if there is none
+    bool readKey(int x)
+    {
+        bool pressed = false;
+        for (int i = 0; i < 16; ++i)
+        {
+            if (key[i] != 0) {
+                V[x] = i;
+                pressed = true;
+            }
+        }
+        return pressed;
+    }
+
+    // Instruction k stays on itself (FX0A with no key): CHIP8_NATIVE_IDLE if that skips the batch
+    uint32_t stay(unsigned k)
+    {
+        if (!emu.idleSkipping) {
+            return 0;
+        }
+        emu.idleInstructions += left - k - 1;
+        return CHIP8_NATIVE_IDLE;
+    }
+
+    // Instruction k at pc jumps back to loop: true if that is an idle loop, pc is then where the batch ends
+    bool idle(unsigned short &pc, unsigned short loop, unsigned k)
+    {
+        if (!emu.idleSkipping || !emu.nativeIdle(pc, loop, left - k - 1)) {
+            return false;
+        }
+        emu.idleInstructions += left - k - 1;
+        return true;
+    }
+
+private:
+    chip8 &emu;
+};
+
+typedef uint32_t (*chip8_native_code)(chip8_native &m);
+
+struct chip8_native_block
+{
+    unsigned short start;
+    unsigned short end;                 // Address after the last instruction
+    chip8_native_code code;
+};
+
+// The recompiled form of one ROM, for one quirk profile
+struct chip8_native_program
+{
+    const char *name;
+    uint64_t romHash;                   // chip8_rom_hash() of image
+    chip8::Quirks quirks;
+    const unsigned char *image;         // The ROM it was compiled from, loaded at 0x200
+    size_t size;
+    const chip8_native_block *blocks;   // Sorted by start address
+    size_t count;
+};
+
+// Programs linked into the executable register themselves during static initialization
+class chip8_native_registration
+{
+public:
+    explicit chip8_native_registration(const chip8_native_program &program);
+};
+
+const std::vector<const chip8_native_program *> &chip8_native_programs();
+const chip8_native_program *chip8_native_find(uint64_t romHash);    // NULL if none was linked in
+
+#endif // NATIVE_H
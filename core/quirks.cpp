@@ -0,0 +1,26 @@
+#include "quirks.h"
+
+// ROMs known to misbehave without their original platform's quirks
+static const struct
+{
+    uint64_t hash;
+    chip8::Quirks quirks;
+} knownRoms[] = {
+    { 0x29BCAB9B664D212BULL, chip8::QUIRKS_VIP },       // BLITZ: buildings wrap into the bomber without clipping
+    { 0x0FD332D0BC68C9F2ULL, chip8::QUIRKS_SCHIP },     // BLINKY: written for CHIP-48/SUPER-CHIP, expects I to stay put
+};
+
+chip8::Quirks chip8_rom_quirks(uint64_t hash, size_t size)
+{
+    if (size > 4096 - 0x0200) {
+        return chip8::QUIRKS_XOCHIP;
+    }
+
+    for (size_t i = 0; i < sizeof(knownRoms) / sizeof(knownRoms[0]); ++i)
+    {
+        if (knownRoms[i].hash == hash) {
+            return knownRoms[i].quirks;
+        }
+    }
+    return chip8::QUIRKS_MODERN;
+}
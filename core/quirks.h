@@ -0,0 +1,106 @@
+#ifndef QUIRKS_H
+#define QUIRKS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * Quirk profiles: the behaviors CHIP-8 implementations disagree on.
+ * Each profile is a policy for chip8::execute(), so every profile is its
+ * own specialized interpreter and the choices cost nothing at run time.
+ *
+ *   SHIFT_VY       8XY6/8XYE shift VY into VX instead of shifting VX
+ *   LOAD_STORE_I   FX55/FX65 leave I at I + X + 1 (2), I + X (1) or I (0)
+ *   VF_RESET       8XY1/8XY2/8XY3 clear VF
+ *   JUMP_VX        BXNN jumps to XNN + VX instead of NNN + V0
+ *   CLIP_SPRITES   Sprites are cut off at the screen edges instead of wrapping
+ *   FX1E_CARRY     FX1E sets VF when I goes past 0xFFF
+ *   MEMORY_MASK    Data addresses wrap at 4K (0x0FFF) or reach all 64K (0xFFFF)
+ *   LONG_SKIP      Skips step over the whole four-byte F000 NNNN
+ *
+ * The SUPER-CHIP and XO-CHIP display instructions are decoded in every
+ * profile; they never show up in plain CHIP-8 programs.
+ */
+
+// What this interpreter has always done, and what the other engines implement
+struct chip8_quirks_modern
+{
+    enum {
+        SHIFT_VY = 0,
+        LOAD_STORE_I = 2,
+        VF_RESET = 0,
+        JUMP_VX = 0,
+        CLIP_SPRITES = 0,
+        FX1E_CARRY = 1,
+        MEMORY_MASK = 0x0FFF,
+        LONG_SKIP = 0
+    };
+};
+
+// The original COSMAC VIP interpreter
+struct chip8_quirks_vip
+{
+    enum {
+        SHIFT_VY = 1,
+        LOAD_STORE_I = 2,
+        VF_RESET = 1,
+        JUMP_VX = 0,
+        CLIP_SPRITES = 1,
+        FX1E_CARRY = 0,
+        MEMORY_MASK = 0x0FFF,
+        LONG_SKIP = 0
+    };
+};
+
+// CHIP-48 on the HP-48
+struct chip8_quirks_chip48
+{
+    enum {
+        SHIFT_VY = 0,
+        LOAD_STORE_I = 1,
+        VF_RESET = 0,
+        JUMP_VX = 1,
+        CLIP_SPRITES = 1,
+        FX1E_CARRY = 0,
+        MEMORY_MASK = 0x0FFF,
+        LONG_SKIP = 0
+    };
+};
+
+// SUPER-CHIP 1.1
+struct chip8_quirks_schip
+{
+    enum {
+        SHIFT_VY = 0,
+        LOAD_STORE_I = 0,
+        VF_RESET = 0,
+        JUMP_VX = 1,
+        CLIP_SPRITES = 1,
+        FX1E_CARRY = 0,
+        MEMORY_MASK = 0x0FFF,
+        LONG_SKIP = 0
+    };
+};
+
+// XO-CHIP as Octo runs it
+struct chip8_quirks_xochip
+{
+    enum {
+        SHIFT_VY = 1,
+        LOAD_STORE_I = 2,
+        VF_RESET = 0,
+        JUMP_VX = 0,
+        CLIP_SPRITES = 0,
+        FX1E_CARRY = 0,
+        MEMORY_MASK = 0xFFFF,
+        LONG_SKIP = 1
+    };
+};
+
+// Profile a ROM needs, by chip8_rom_hash(); QUIRKS_MODERN for ROMs we know nothing
+// about, QUIRKS_XOCHIP for those that only fit in XO-CHIP memory
+chip8::Quirks chip8_rom_quirks(uint64_t hash, size_t size);
+
+#endif // QUIRKS_H
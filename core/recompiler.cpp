@@ -0,0 +1,527 @@
+#include "recompiler.h"
+#include "disasm.h"
+#include "library.h"
+#include "native.h"
+#include "quirks.h"
+#include <cstring>
+
+// How the recompiler treats each instruction
+enum
+{
+    KIND_INLINE,            // Compiled to C++
+    KIND_INTERPRET,         // Compiled to a call into the interpreter
+    KIND_UNCOMPILED         // Left to the interpreter, ends any block before it
+};
+
+static int insnKind(unsigned char op)
+{
+    switch (op)
+    {
+    case chip8::OP_DECODE:
+    case chip8::OP_UNKNOWN:
+    case chip8::OP_0NNN:
+    case chip8::OP_00FD:
+        return KIND_UNCOMPILED;
+    case chip8::OP_00E0:
+    case chip8::OP_DXYN:
+    case chip8::OP_8XYU:
+    case chip8::OP_00CN:
+    case chip8::OP_00DN:
+    case chip8::OP_00FB:
+    case chip8::OP_00FC:
+    case chip8::OP_00FE:
+    case chip8::OP_00FF:
+    case chip8::OP_5XY2:
+    case chip8::OP_5XY3:
+    case chip8::OP_FX30:
+    case chip8::OP_FX75:
+    case chip8::OP_FX85:
+    case chip8::OP_FN01:
+    case chip8::OP_F002:
+    case chip8::OP_FX3A:
+        return KIND_INTERPRET;
+    }
+    return KIND_INLINE;
+}
+
+// A jump back by at most four instructions, which the interpreter checks for an idle loop
+static bool idleCandidate(unsigned short addr, const chip8_insn &in)
+{
+    return in.op == chip8::OP_1NNN && in.nnn <= addr && addr - in.nnn <= 8;
+}
+
+static bool isSkip(unsigned char op)
+{
+    return op == chip8::OP_3XNN || op == chip8::OP_4XNN || op == chip8::OP_5XY0
+        || op == chip8::OP_9XY0 || op == chip8::OP_EX9E || op == chip8::OP_EXA1;
+}
+
+chip8_recompiler::chip8_recompiler() : quirks(chip8::QUIRKS_MODERN), romHash(0)
+{
+    setProfile<chip8_quirks_modern>();
+    memset(&stats, 0, sizeof(stats));
+}
+
+template <class Quirks>
+void chip8_recompiler::setProfile()
+{
+    profile.shiftVY = Quirks::SHIFT_VY != 0;
+    profile.loadStoreI = Quirks::LOAD_STORE_I;
+    profile.vfReset = Quirks::VF_RESET != 0;
+    profile.jumpVX = Quirks::JUMP_VX != 0;
+    profile.carry = Quirks::FX1E_CARRY != 0;
+    profile.memoryMask = Quirks::MEMORY_MASK;
+    profile.longSkip = Quirks::LONG_SKIP != 0;
+}
+
+void chip8_recompiler::analyze(const unsigned char *data, size_t size, chip8::Quirks quirks)
+{
+    image.assign(data, data + size);
+    romHash = chip8_rom_hash(data, size);
+    this->quirks = quirks;
+    switch (quirks)
+    {
+    case chip8::QUIRKS_VIP:
+        setProfile<chip8_quirks_vip>();
+        break;
+    case chip8::QUIRKS_CHIP48:
+        setProfile<chip8_quirks_chip48>();
+        break;
+    case chip8::QUIRKS_SCHIP:
+        setProfile<chip8_quirks_schip>();
+        break;
+    case chip8::QUIRKS_XOCHIP:
+        setProfile<chip8_quirks_xochip>();
+        break;
+    default:
+        setProfile<chip8_quirks_modern>();
+        break;
+    }
+
+    blocks.clear();
+    memset(&stats, 0, sizeof(stats));
+
+    // Every instruction reachable from 0x200, and the addresses that start a block
+    std::vector<unsigned char> reached(4096, 0);
+    std::vector<unsigned char> leader(4096, 0);
+    std::vector<unsigned short> work(1, 0x0200);
+    std::vector<unsigned short> next;
+    leader[0x0200] = 1;
+
+    while (!work.empty())
+    {
+        unsigned short addr = work.back();
+        work.pop_back();
+
+        chip8_insn in;
+        if (reached[addr] || !decodeAt(addr, in)) {
+            continue;
+        }
+        reached[addr] = 1;
+        ++stats.reachable;
+        if (insnKind(in.op) == KIND_UNCOMPILED) {
+            ++stats.uncompiled;
+            continue;
+        }
+
+        // FX0A comes back to itself while no key is held
+        if (in.op == chip8::OP_FX0A) {
+            leader[addr] = 1;
+        }
+
+        bool ends;
+        successors(addr, in, next, ends);
+        for (size_t i = 0; i < next.size(); ++i)
+        {
+            if (next[i] < 4096) {
+                leader[next[i]] |= ends;
+                work.push_back(next[i]);
+            }
+        }
+    }
+
+    // Blocks run from each start to a branch, or up to the next start or uncompiled instruction
+    for (unsigned start = 0x0200; start < 4096; ++start)
+    {
+        chip8_insn in;
+        if (!leader[start] || !reached[start] || !decodeAt(start, in) || insnKind(in.op) == KIND_UNCOMPILED) {
+            continue;
+        }
+
+        Block block;
+        block.start = (unsigned short) start;
+        block.dynamic = false;
+
+        unsigned addr = start;
+        for (;;)
+        {
+            block.code.push_back((unsigned short) addr);
+            if (insnKind(in.op) == KIND_INTERPRET) {
+                ++stats.interpreted;
+            }
+
+            bool ends;
+            successors((unsigned short) addr, in, next, ends);
+            addr += length(in);
+            if (ends) {
+                block.successors = next;
+                block.dynamic = (in.op == chip8::OP_00EE || in.op == chip8::OP_BNNN);
+                break;
+            }
+
+            if (addr >= 4096 || !reached[addr] || leader[addr] || !decodeAt(addr, in)
+                    || insnKind(in.op) == KIND_UNCOMPILED || block.code.size() == CHIP8_NATIVE_MAX_LENGTH) {
+                // A block cut off at its maximum length is continued by another one
+                if (addr < 4096 && reached[addr] && block.code.size() == CHIP8_NATIVE_MAX_LENGTH) {
+                    leader[addr] = 1;
+                }
+                block.successors.assign(1, (unsigned short) addr);
+                break;
+            }
+        }
+
+        block.end = (unsigned short) addr;
+        stats.instructions += (unsigned) block.code.size();
+        stats.dynamic += block.dynamic;
+        blocks.push_back(block);
+    }
+    stats.blocks = (unsigned) blocks.size();
+}
+
+const chip8_recompiler_stats &chip8_recompiler::getStats() const
+{
+    return stats;
+}
+
+// The instruction at addr as the machine would see it right after loading the ROM
+bool chip8_recompiler::decodeAt(unsigned addr, chip8_insn &in) const
+{
+    if (addr < 0x0200 || addr + 1 >= 0x0200 + image.size() || addr + 1 > 0x0FFF) {
+        return false;
+    }
+
+    in = chip8::decode((unsigned short) ((image[addr - 0x0200] << 8) | image[addr + 1 - 0x0200]));
+    if (in.op == chip8::OP_F000) {
+        // The whole operand has to be in the image too
+        if (addr + 3 >= 0x0200 + image.size() || addr + 3 > 0x0FFF) {
+            return false;
+        }
+        in.nnn = (unsigned short) ((image[addr + 2 - 0x0200] << 8) | image[addr + 3 - 0x0200]);
+    }
+    return true;
+}
+
+unsigned chip8_recompiler::length(const chip8_insn &in) const
+{
+    return (in.op == chip8::OP_F000) ? 4 : 2;
+}
+
+// Bytes a taken skip at addr moves by, going by the image
+unsigned chip8_recompiler::skipLength(unsigned short addr) const
+{
+    unsigned next = addr + 2;
+    if (profile.longSkip && next + 1 < 0x0200 + image.size()
+            && image[next - 0x0200] == 0xF0 && image[next + 1 - 0x0200] == 0x00) {
+        return 6;
+    }
+    return 4;
+}
+
+// Where control can go after the instruction at addr; ends is set for branches
+void chip8_recompiler::successors(unsigned short addr, const chip8_insn &in, std::vector<unsigned short> &out, bool &ends) const
+{
+    out.clear();
+    ends = true;
+
+    switch (in.op)
+    {
+    case chip8::OP_1NNN:
+        out.push_back(in.nnn);
+        break;
+    case chip8::OP_2NNN:
+        out.push_back(in.nnn);
+        out.push_back(addr + 2);
+        break;
+    case chip8::OP_00EE:
+    case chip8::OP_BNNN:
+        break;
+    case chip8::OP_FX0A:
+        out.push_back(addr + 2);
+        out.push_back(addr);
+        break;
+    default:
+        if (isSkip(in.op)) {
+            out.push_back(addr + 2);
+            out.push_back(addr + skipLength(addr));
+        } else {
+            out.push_back(addr + length(in));
+            ends = false;
+        }
+        break;
+    }
+}
+
+void chip8_recompiler::listBlocks(FILE *out) const
+{
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+        const Block &block = blocks[b];
+        fprintf(out, "%03X-%03X  %3u instructions  ->", block.start, block.end, (unsigned) block.code.size());
+        for (size_t i = 0; i < block.successors.size(); ++i)
+        {
+            fprintf(out, " %03X", block.successors[i]);
+        }
+        fprintf(out, "%s\n", block.dynamic ? " (run time)" : "");
+    }
+}
+
+void chip8_recompiler::emit(FILE *out, const char *name) const
+{
+    static const char *const quirksEnum[chip8::QUIRKS_COUNT] = {
+        "QUIRKS_MODERN", "QUIRKS_VIP", "QUIRKS_CHIP48", "QUIRKS_SCHIP", "QUIRKS_XOCHIP"
+    };
+
+    fprintf(out, "namespace {\nnamespace rom_%s {\n\n", name);
+    fprintf(out, "// %u bytes for %s quirks: %u blocks, %u of %u reachable instructions\n",
+            (unsigned) image.size(), chip8::quirksName(quirks), stats.blocks, stats.instructions, stats.reachable);
+    fprintf(out, "const unsigned char image[%u] = {", (unsigned) image.size());
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+        fprintf(out, "%s0x%02X%s", (i % 12 == 0) ? "\n    " : " ", image[i], (i + 1 < image.size()) ? "," : "");
+    }
+    fprintf(out, "\n};\n");
+
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+        emitBlock(out, blocks[b]);
+    }
+
+    if (blocks.empty()) {
+        fprintf(out, "\nconst chip8_native_block *const blocks = NULL;\nconst size_t count = 0;\n");
+    } else {
+        fprintf(out, "\nconst chip8_native_block blocks[] = {\n");
+        for (size_t b = 0; b < blocks.size(); ++b)
+        {
+            fprintf(out, "    { 0x%03X, 0x%03X, block_%03X },\n", blocks[b].start, blocks[b].end, blocks[b].start);
+        }
+        fprintf(out, "};\nconst size_t count = sizeof(blocks) / sizeof(blocks[0]);\n");
+    }
+
+    fprintf(out, "\nconst chip8_native_program program = {\n");
+    fprintf(out, "    \"%s\", 0x%016llXULL, chip8::%s, image, sizeof(image), blocks, count\n",
+            name, (unsigned long long) romHash, quirksEnum[quirks < chip8::QUIRKS_COUNT ? quirks : 0]);
+    fprintf(out, "};\n\nconst chip8_native_registration registration(program);\n\n");
+    fprintf(out, "} // namespace rom_%s\n} // namespace\n", name);
+}
+
+void chip8_recompiler::emitBlock(FILE *out, const Block &block) const
+{
+    fprintf(out, "\n// %03X-%03X ->", block.start, block.end);
+    for (size_t i = 0; i < block.successors.size(); ++i)
+    {
+        fprintf(out, " %03X", block.successors[i]);
+    }
+    fprintf(out, "%s\n", block.dynamic ? " (run time)" : "");
+
+    // A plain jump on its own leaves the machine alone
+    chip8_insn first;
+    decodeAt(block.start, first);
+    bool jumpOnly = block.code.size() == 1 && first.op == chip8::OP_1NNN && !idleCandidate(block.start, first);
+    fprintf(out, "uint32_t block_%03X(chip8_native &%s)\n{\n", block.start, jumpOnly ? "" : "m");
+
+    // Stops where the batch does, which may be part way through
+    if (block.code.size() > 1) {
+        fprintf(out, "    const unsigned long long left = m.left;\n");
+    }
+
+    unsigned addr = block.start;
+    for (unsigned k = 0; k < block.code.size(); ++k)
+    {
+        addr = block.code[k];
+        if (k != 0) {
+            fprintf(out, "    if (left <= %u) return CHIP8_NATIVE_EXIT(0x%03X, %u);\n", k, addr, k);
+        }
+
+        chip8_insn in;
+        decodeAt(addr, in);
+        emitInsn(out, (unsigned short) addr, in, k);
+    }
+
+    // Branches have returned already
+    bool ends;
+    std::vector<unsigned short> next;
+    chip8_insn last;
+    decodeAt(addr, last);
+    successors((unsigned short) addr, last, next, ends);
+    if (!ends) {
+        fprintf(out, "    return CHIP8_NATIVE_EXIT(0x%03X, %u);\n", block.end, (unsigned) block.code.size());
+    }
+    fprintf(out, "}\n");
+}
+
+// Instruction k of its block; the statements follow the interpreter's exactly
+void chip8_recompiler::emitInsn(FILE *out, unsigned short addr, const chip8_insn &in, unsigned k) const
+{
+    char text[32];
+    chip8_disassemble(in.opcode, text, sizeof(text));
+    fprintf(out, "    // %03X: %04X  %s\n", addr, in.opcode, text);
+
+    const unsigned x = in.x;
+    const unsigned y = in.y;
+    const unsigned ran = k + 1;
+    const unsigned next = addr + 2;
+    const unsigned mask = profile.memoryMask;
+    const unsigned advance = (profile.loadStoreI == 2) ? x + 1 : (profile.loadStoreI == 1) ? x : 0;
+
+    if (insnKind(in.op) == KIND_INTERPRET) {
+        fprintf(out, "    if (m.interpret(0x%03X)) return CHIP8_NATIVE_EXIT(0x%03X, %u);\n", addr, next, ran);
+        return;
+    }
+
+    if (isSkip(in.op)) {
+        const char *cond = "";
+        char buf[64];
+        switch (in.op)
+        {
+        case chip8::OP_3XNN: snprintf(buf, sizeof(buf), "m.V[0x%X] == 0x%02X", x, in.nn); break;
+        case chip8::OP_4XNN: snprintf(buf, sizeof(buf), "m.V[0x%X] != 0x%02X", x, in.nn); break;
+        case chip8::OP_5XY0: snprintf(buf, sizeof(buf), "m.V[0x%X] == m.V[0x%X]", x, y); break;
+        case chip8::OP_9XY0: snprintf(buf, sizeof(buf), "m.V[0x%X] != m.V[0x%X]", x, y); break;
+        case chip8::OP_EX9E: snprintf(buf, sizeof(buf), "m.key[m.V[0x%X] & 0xF] != 0", x); break;
+        default:             snprintf(buf, sizeof(buf), "m.key[m.V[0x%X] & 0xF] == 0", x); break;
+        }
+        cond = buf;
+
+        // With LONG_SKIP the length depends on what is in memory when the skip runs
+        if (profile.longSkip) {
+            fprintf(out, "    return CHIP8_NATIVE_EXIT((%s) ? ((m.memory[0x%03X] == 0xF0 && m.memory[0x%03X] == 0x00) ? 0x%03X : 0x%03X) : 0x%03X, %u);\n",
+                    cond, (addr + 2) & 0x0FFF, (addr + 3) & 0x0FFF, addr + 6, addr + 4, next, ran);
+        } else {
+            fprintf(out, "    return CHIP8_NATIVE_EXIT((%s) ? 0x%03X : 0x%03X, %u);\n", cond, addr + 4, next, ran);
+        }
+        return;
+    }
+
+    switch (in.op)
+    {
+    case chip8::OP_00EE:
+        fprintf(out, "    return CHIP8_NATIVE_EXIT(m.stack[--m.sp] + 2, %u);\n", ran);
+        break;
+    case chip8::OP_1NNN:
+        // The interpreter's idle loop test, see chip8::idleLoop()
+        if (idleCandidate(addr, in)) {
+            fprintf(out, "    {\n");
+            fprintf(out, "        unsigned short pc = 0x%03X;\n", addr);
+            fprintf(out, "        if (m.idle(pc, 0x%03X, %u)) return CHIP8_NATIVE_EXIT(pc, %u) | CHIP8_NATIVE_IDLE;\n", in.nnn, k, ran);
+            fprintf(out, "    }\n");
+        }
+        fprintf(out, "    return CHIP8_NATIVE_EXIT(0x%03X, %u);\n", in.nnn, ran);
+        break;
+    case chip8::OP_2NNN:
+        fprintf(out, "    m.stack[m.sp++] = 0x%03X;\n", addr);
+        fprintf(out, "    return CHIP8_NATIVE_EXIT(0x%03X, %u);\n", in.nnn, ran);
+        break;
+    case chip8::OP_6XNN:
+        fprintf(out, "    m.V[0x%X] = 0x%02X;\n", x, in.nn);
+        break;
+    case chip8::OP_7XNN:
+        fprintf(out, "    m.V[0x%X] += 0x%02X;\n", x, in.nn);
+        break;
+    case chip8::OP_8XY0:
+        fprintf(out, "    m.V[0x%X] = m.V[0x%X];\n", x, y);
+        break;
+    case chip8::OP_8XY1:
+    case chip8::OP_8XY2:
+    case chip8::OP_8XY3:
+        fprintf(out, "    m.V[0x%X] %s= m.V[0x%X];\n", x, in.op == chip8::OP_8XY1 ? "|" : in.op == chip8::OP_8XY2 ? "&" : "^", y);
+        if (profile.vfReset) {
+            fprintf(out, "    m.V[0xF] = 0;\n");
+        }
+        break;
+    case chip8::OP_8XY4:
+        fprintf(out, "    m.V[0xF] = m.V[0x%X] > (0xFF - m.V[0x%X]);\n", x, y);
+        fprintf(out, "    m.V[0x%X] += m.V[0x%X];\n", x, y);
+        break;
+    case chip8::OP_8XY5:
+        fprintf(out, "    m.V[0xF] = m.V[0x%X] >= m.V[0x%X];\n", x, y);
+        fprintf(out, "    m.V[0x%X] -= m.V[0x%X];\n", x, y);
+        break;
+    case chip8::OP_8XY6:
+    case chip8::OP_8XYE:
+        fprintf(out, "    {\n");
+        fprintf(out, "        unsigned char src = m.V[0x%X];\n", profile.shiftVY ? y : x);
+        if (in.op == chip8::OP_8XY6) {
+            fprintf(out, "        m.V[0xF] = src & 0x1;\n");
+            fprintf(out, "        m.V[0x%X] = src >> 1;\n", x);
+        } else {
+            fprintf(out, "        m.V[0xF] = src >> 7;\n");
+            fprintf(out, "        m.V[0x%X] = src << 1;\n", x);
+        }
+        fprintf(out, "    }\n");
+        break;
+    case chip8::OP_8XY7:
+        fprintf(out, "    m.V[0xF] = m.V[0x%X] <= m.V[0x%X];\n", x, y);
+        fprintf(out, "    m.V[0x%X] = m.V[0x%X] - m.V[0x%X];\n", x, y, x);
+        break;
+    case chip8::OP_ANNN:
+        fprintf(out, "    m.I = 0x%03X;\n", in.nnn);
+        break;
+    case chip8::OP_BNNN:
+        fprintf(out, "    return CHIP8_NATIVE_EXIT(0x%03X + m.V[0x%X], %u);\n", in.nnn, profile.jumpVX ? x : 0, ran);
+        break;
+    case chip8::OP_CXNN:
+        fprintf(out, "    m.V[0x%X] = m.random() & 0x%02X;\n", x, in.nn);
+        break;
+    case chip8::OP_FX07:
+        fprintf(out, "    m.V[0x%X] = m.delay_timer;\n", x);
+        break;
+    case chip8::OP_FX0A:
+        fprintf(out, "    if (!m.readKey(0x%X)) return CHIP8_NATIVE_EXIT(0x%03X, %u) | m.stay(%u);\n", x, addr, ran, k);
+        fprintf(out, "    return CHIP8_NATIVE_EXIT(0x%03X, %u);\n", next, ran);
+        break;
+    case chip8::OP_FX15:
+        fprintf(out, "    m.delay_timer = m.V[0x%X];\n", x);
+        break;
+    case chip8::OP_FX18:
+        fprintf(out, "    if ((m.sound_timer == 0) != (m.V[0x%X] == 0)) m.soundEdge(%u);\n", x, k);
+        fprintf(out, "    m.sound_timer = m.V[0x%X];\n", x);
+        break;
+    case chip8::OP_FX1E:
+        if (profile.carry) {
+            fprintf(out, "    m.V[0xF] = (m.I + m.V[0x%X]) > 0xFFF;\n", x);
+        }
+        fprintf(out, "    m.I += m.V[0x%X];\n", x);
+        break;
+    case chip8::OP_FX29:
+        fprintf(out, "    m.I = m.V[0x%X] * 0x5;\n", x);
+        break;
+    case chip8::OP_FX33:
+        fprintf(out, "    {\n");
+        fprintf(out, "        unsigned char vx = m.V[0x%X];\n", x);
+        fprintf(out, "        m.memory[m.I & 0x%04X] = vx / 100;\n", mask);
+        fprintf(out, "        m.memory[(m.I + 1) & 0x%04X] = (vx / 10) %% 10;\n", mask);
+        fprintf(out, "        m.memory[(m.I + 2) & 0x%04X] = vx %% 10;\n", mask);
+        fprintf(out, "        if (m.written(m.I, 3)) return CHIP8_NATIVE_EXIT(0x%03X, %u);\n", next, ran);
+        fprintf(out, "    }\n");
+        break;
+    case chip8::OP_FX55:
+        fprintf(out, "    {\n");
+        fprintf(out, "        for (int i = 0; i <= 0x%X; ++i) m.memory[(m.I + i) & 0x%04X] = m.V[i];\n", x, mask);
+        fprintf(out, "        bool stale = m.written(m.I, %u);\n", x + 1);
+        if (advance != 0) {
+            fprintf(out, "        m.I += %u;\n", advance);
+        }
+        fprintf(out, "        if (stale) return CHIP8_NATIVE_EXIT(0x%03X, %u);\n", next, ran);
+        fprintf(out, "    }\n");
+        break;
+    case chip8::OP_FX65:
+        fprintf(out, "    for (int i = 0; i <= 0x%X; ++i) m.V[i] = m.memory[(m.I + i) & 0x%04X];\n", x, mask);
+        if (advance != 0) {
+            fprintf(out, "    m.I += %u;\n", advance);
+        }
+        break;
+    case chip8::OP_F000:
+        fprintf(out, "    m.I = 0x%04X;\n", in.nnn);
+        break;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef RECOMPILER_H
+#define RECOMPILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "chip8.h"
+
+struct chip8_recompiler_stats
+{
+    unsigned reachable;         // Instructions found from 0x200
+    unsigned blocks;
+    unsigned instructions;      // In blocks
+    unsigned interpreted;       // In blocks, but run through the interpreter (display and XO-CHIP instructions)
+    unsigned dynamic;           // 00EE and BNNN, which only know where they go at run time
+    unsigned uncompiled;        // Reachable but left to the interpreter (0NNN, 00FD, unknown)
+};
+
+/*
+ * Ahead-of-time recompiler for ENGINE_NATIVE (see native.h).
+ *
+ * analyze() follows every path from 0x200 through the ROM image: jumps,
+ * calls and the return from each call, and both ways out of every skip.
+ * Their targets start basic blocks. A block ends at a branch, before the
+ * start of another block or an instruction it cannot compile, or after
+ * CHIP8_NATIVE_MAX_LENGTH instructions. Returns and computed jumps (BNNN)
+ * leave their block for wherever they go at run time, which is the
+ * interpreter unless it is the start of a block.
+ *
+ * emit() writes the blocks as C++, one function per block, with the quirk
+ * choices of the profile already made, followed by the program table and
+ * a registration that makes it available to any executable linking it in.
+ * The image goes along, so a machine only uses blocks whose code is in
+ * memory unchanged.
+ */
+class chip8_recompiler
+{
+public:
+    chip8_recompiler();
+
+    void analyze(const unsigned char *image, size_t size, chip8::Quirks quirks);
+    void emit(FILE *out, const char *name) const;       // name: the program's name and a C++ identifier
+    void listBlocks(FILE *out) const;                   // The control-flow graph, one block per line
+
+    const chip8_recompiler_stats &getStats() const;
+
+private:
+    struct Block
+    {
+        unsigned short start;
+        unsigned short end;                             // Address after the last instruction
+        std::vector<unsigned short> code;               // Instruction addresses
+        std::vector<unsigned short> successors;         // Known at compile time
+        bool dynamic;                                   // Also goes somewhere only known at run time
+    };
+
+    struct Profile
+    {
+        bool shiftVY;
+        int loadStoreI;
+        bool vfReset;
+        bool jumpVX;
+        bool carry;
+        unsigned memoryMask;
+        bool longSkip;
+    };
+
+    std::vector<unsigned char> image;
+    chip8::Quirks quirks;
+    Profile profile;
+    uint64_t romHash;
+    std::vector<Block> blocks;
+    chip8_recompiler_stats stats;
+
+    template <class Quirks>
+    void setProfile();
+    bool decodeAt(unsigned addr, chip8_insn &in) const;
+    unsigned length(const chip8_insn &in) const;
+    unsigned skipLength(unsigned short addr) const;
+    void successors(unsigned short addr, const chip8_insn &in, std::vector<unsigned short> &out, bool &ends) const;
+    void emitBlock(FILE *out, const Block &block) const;
+    void emitInsn(FILE *out, unsigned short addr, const chip8_insn &in, unsigned k) const;
+};
+
+#endif // RECOMPILER_H
@@ -0,0 +1,234 @@
+#include "rewind.h"
+#include <cstring>
+
+#define CHIP8_STATE_WORDS   (sizeof(chip8_state) / sizeof(uint64_t))
+
+static_assert(sizeof(chip8_state) % sizeof(uint64_t) == 0, "chip8_state must be whole words");
+
+static inline uint64_t loadWord(const unsigned char *p, size_t index)
+{
+    uint64_t w;
+    memcpy(&w, p + index * sizeof(uint64_t), sizeof(uint64_t));
+    return w;
+}
+
+static inline void storeWord(unsigned char *p, size_t index, uint64_t w)
+{
+    memcpy(p + index * sizeof(uint64_t), &w, sizeof(uint64_t));
+}
+
+// What a keyframe is coded against
+static const unsigned char zeroState[sizeof(chip8_state)] = { 0 };
+
+#define SKIP_WORDS  8       // Unchanged stretches are skipped a cache line at a time
+
+// First word from w on where cur and base differ, or CHIP8_STATE_WORDS
+static inline size_t skipEqual(const unsigned char *cur, const unsigned char *base, size_t w)
+{
+    const size_t chunk = SKIP_WORDS * sizeof(uint64_t);
+    while (w + SKIP_WORDS <= CHIP8_STATE_WORDS
+           && memcmp(cur + w * sizeof(uint64_t), base + w * sizeof(uint64_t), chunk) == 0)
+    {
+        w += SKIP_WORDS;
+    }
+    while (w < CHIP8_STATE_WORDS && loadWord(cur, w) == loadWord(base, w))
+    {
+        ++w;
+    }
+    return w;
+}
+
+chip8_rewind::chip8_rewind(size_t capacity, unsigned keyframeInterval) :
+    ring(capacity), keyframeInterval(keyframeInterval ? keyframeInterval : 1),
+    sinceKeyframe(0), used(0),
+    // Worst case: every literal run is one word long
+    scratch(CHIP8_STATE_WORDS * (2 * sizeof(uint16_t) + sizeof(uint64_t)))
+{
+    memset(&keyState, 0, sizeof(keyState));
+}
+
+void chip8_rewind::clear()
+{
+    entries.clear();
+    sinceKeyframe = 0;
+    used = 0;
+}
+
+// Stores a snapshot, normally called once per frame
+void chip8_rewind::record(const chip8_state &state)
+{
+    bool keyframe = entries.empty() || sinceKeyframe + 1 >= keyframeInterval;
+    size_t length = encode(state, keyframe);
+    if (length > ring.size()) {
+        clear();
+        return;
+    }
+
+    size_t offset = reserve(length);
+
+    // Making room dropped the keyframe this delta was taken against
+    if (!keyframe && entries.empty()) {
+        keyframe = true;
+        length = encode(state, true);
+        if (length > ring.size()) {
+            return;
+        }
+        offset = reserve(length);
+    }
+
+    memcpy(&ring[offset], &scratch[0], length);
+
+    chip8_rewind_entry entry;
+    entry.offset = offset;
+    entry.length = (uint32_t) length;
+    entry.keyframe = keyframe;
+    entries.push_back(entry);
+    used += length;
+
+    if (keyframe) {
+        keyState = state;
+        sinceKeyframe = 0;
+    } else {
+        ++sinceKeyframe;
+    }
+}
+
+bool chip8_rewind::pop(chip8_state &state)
+{
+    if (entries.empty()) {
+        return false;
+    }
+
+    chip8_rewind_entry entry = entries.back();
+    decode(entry, state);
+    entries.pop_back();
+    used -= entry.length;
+
+    if (!entry.keyframe) {
+        --sinceKeyframe;
+        return true;
+    }
+
+    // Back into the previous group: its keyframe becomes the base again
+    sinceKeyframe = 0;
+    for (size_t i = entries.size(); i-- > 0; )
+    {
+        if (entries[i].keyframe) {
+            decode(entries[i], keyState);
+            break;
+        }
+        ++sinceKeyframe;
+    }
+
+    return true;
+}
+
+size_t chip8_rewind::size() const
+{
+    return entries.size();
+}
+
+size_t chip8_rewind::bytesUsed() const
+{
+    return used;
+}
+
+// Run-length codes state (XOR keyState for deltas) into scratch, returns the length
+size_t chip8_rewind::encode(const chip8_state &state, bool keyframe)
+{
+    const unsigned char *cur = (const unsigned char *) &state;
+    const unsigned char *base = keyframe ? zeroState : (const unsigned char *) &keyState;
+    unsigned char *out = &scratch[0];
+    size_t length = 0;
+
+    size_t w = 0;
+    while (w < CHIP8_STATE_WORDS)
+    {
+        size_t zeroStart = w;
+        w = skipEqual(cur, base, w);
+
+        size_t literalStart = w;
+        while (w < CHIP8_STATE_WORDS && loadWord(cur, w) != loadWord(base, w))
+        {
+            ++w;
+        }
+
+        // Trailing zero words need no token
+        if (w == literalStart) {
+            break;
+        }
+
+        uint16_t run[2] = { (uint16_t) (literalStart - zeroStart), (uint16_t) (w - literalStart) };
+        memcpy(out + length, run, sizeof(run));
+        length += sizeof(run);
+
+        for (size_t i = literalStart; i < w; ++i)
+        {
+            storeWord(out + length, 0, loadWord(cur, i) ^ loadWord(base, i));
+            length += sizeof(uint64_t);
+        }
+    }
+
+    return length;
+}
+
+void chip8_rewind::decode(const chip8_rewind_entry &entry, chip8_state &state) const
+{
+    unsigned char *dst = (unsigned char *) &state;
+    if (entry.keyframe) {
+        memset(dst, 0, sizeof(chip8_state));
+    } else {
+        state = keyState;
+    }
+
+    const unsigned char *in = &ring[entry.offset];
+    const unsigned char *end = in + entry.length;
+    size_t w = 0;
+    while (in < end)
+    {
+        uint16_t run[2];
+        memcpy(run, in, sizeof(run));
+        in += sizeof(run);
+
+        w += run[0];
+        for (uint16_t i = 0; i < run[1]; ++i, ++w)
+        {
+            storeWord(dst, w, loadWord(dst, w) ^ loadWord(in, i));
+        }
+        in += run[1] * sizeof(uint64_t);
+    }
+}
+
+// Finds room for length bytes after the newest entry, dropping the oldest groups it overlaps
+size_t chip8_rewind::reserve(size_t length)
+{
+    size_t pos = 0;
+    if (!entries.empty()) {
+        pos = entries.back().offset + entries.back().length;
+    }
+    if (pos + length > ring.size()) {
+        pos = 0;
+    }
+
+    while (!entries.empty())
+    {
+        const chip8_rewind_entry &oldest = entries.front();
+        if (oldest.offset < pos + length && pos < oldest.offset + oldest.length) {
+            dropOldest();
+        } else {
+            break;
+        }
+    }
+
+    return pos;
+}
+
+// Drops the oldest keyframe and every delta taken against it
+void chip8_rewind::dropOldest()
+{
+    do
+    {
+        used -= entries.front().length;
+        entries.pop_front();
+    } while (!entries.empty() && !entries.front().keyframe);
+}
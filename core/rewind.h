@@ -0,0 +1,61 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#include "chip8.h"
+
+#define CHIP8_REWIND_DEFAULT_CAPACITY   (4 * 1024 * 1024)   // Bytes of history
+#define CHIP8_REWIND_KEYFRAME_INTERVAL  60                  // Snapshots per keyframe
+
+// One snapshot in the ring
+struct chip8_rewind_entry
+{
+    size_t offset;              // Start in the ring buffer
+    uint32_t length;            // Encoded bytes
+    bool keyframe;
+};
+
+/*
+ * Bounded history of machine states for stepping backwards.
+ *
+ * Every KEYFRAME_INTERVAL snapshots a keyframe is stored; the snapshots in
+ * between are stored as the XOR against that keyframe, which is almost all
+ * zero. Both are run-length coded on 64-bit words as
+ *   { uint16 zero words, uint16 literal words, literal words... }
+ * into one byte ring. When the ring is full the oldest keyframe is dropped
+ * together with the deltas that depend on it.
+ */
+class chip8_rewind
+{
+public:
+    explicit chip8_rewind(size_t capacity = CHIP8_REWIND_DEFAULT_CAPACITY,
+                          unsigned keyframeInterval = CHIP8_REWIND_KEYFRAME_INTERVAL);
+
+    void clear();
+    void record(const chip8_state &state);
+    bool pop(chip8_state &state);           // Newest snapshot, removed from the history
+
+    size_t size() const;                    // Snapshots held
+    size_t bytesUsed() const;
+
+private:
+    std::vector<unsigned char> ring;
+    std::deque<chip8_rewind_entry> entries;
+    unsigned keyframeInterval;
+    unsigned sinceKeyframe;                 // Deltas stored since the newest keyframe
+    size_t used;
+
+    chip8_state keyState;                   // Decoded newest keyframe
+    std::vector<unsigned char> scratch;     // Encoder output before it goes into the ring
+
+    size_t encode(const chip8_state &state, bool keyframe);
+    void decode(const chip8_rewind_entry &entry, chip8_state &state) const;
+    size_t reserve(size_t length);
+    void dropOldest();
+};
+
+#endif // REWIND_H
@@ -0,0 +1,476 @@
+#include "search.h"
+#include "state.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#define GOLDEN  0x9E3779B97F4A7C15ULL
+
+// MurmurHash3's finalizer
+static inline uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hash of length bytes, a multiple of 8, taken a word at a time
+static uint64_t hashBytes(const unsigned char *p, size_t length)
+{
+    uint64_t h = GOLDEN ^ length;
+    for (size_t i = 0; i < length; i += sizeof(uint64_t))
+    {
+        uint64_t w;
+        memcpy(&w, p + i, sizeof(w));
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    return mix(h);
+}
+
+// What a page (or, at CHIP8_SEARCH_PAGES, the tail) adds to the state hash
+static inline uint64_t term(int position, uint64_t hash)
+{
+    return mix(hash + (uint64_t) (position + 1) * GOLDEN);
+}
+
+static_assert(CHIP8_SEARCH_TAIL_SIZE % sizeof(uint64_t) == 0, "the tail must be whole words");
+
+chip8_search::Index::Index() :
+    slots(1024, 0), count(0)
+{
+}
+
+void chip8_search::Index::clear()
+{
+    slots.assign(1024, 0);
+    count = 0;
+}
+
+size_t chip8_search::Index::bytes() const
+{
+    return slots.size() * sizeof(uint64_t);
+}
+
+template <class Equal>
+uint32_t chip8_search::Index::find(uint64_t hash, const Equal &equal) const
+{
+    const size_t mask = slots.size() - 1;
+    const uint32_t tag = (uint32_t) hash;
+    for (size_t i = tag & mask; slots[i] != 0; i = (i + 1) & mask)
+    {
+        if ((uint32_t) (slots[i] >> 32) == tag && equal((uint32_t) slots[i] - 1)) {
+            return (uint32_t) slots[i] - 1;
+        }
+    }
+    return CHIP8_SEARCH_NONE;
+}
+
+void chip8_search::Index::insert(uint64_t hash, uint32_t item)
+{
+    // Kept at most half full so probes stay short
+    if ((count + 1) * 2 > slots.size()) {
+        std::vector<uint64_t> old(slots.size() * 2, 0);
+        old.swap(slots);
+        const size_t mask = slots.size() - 1;
+        for (size_t j = 0; j < old.size(); ++j)
+        {
+            if (old[j] != 0) {
+                size_t i = (old[j] >> 32) & mask;
+                while (slots[i] != 0)
+                {
+                    i = (i + 1) & mask;
+                }
+                slots[i] = old[j];
+            }
+        }
+    }
+
+    const size_t mask = slots.size() - 1;
+    size_t i = (uint32_t) hash & mask;
+    while (slots[i] != 0)
+    {
+        i = (i + 1) & mask;
+    }
+    slots[i] = ((uint64_t) (uint32_t) hash << 32) | (item + 1);
+    ++count;
+}
+
+chip8_search::chip8_search(chip8_thread_pool &pool) :
+    pool(pool), framesPerStep(1), stateLimit((size_t) -1),
+    machines(pool.size()), scratch(2 * pool.size()), executed(pool.size(), 0),
+    successors(CHIP8_SEARCH_BATCH * CHIP8_SEARCH_KEYS)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].initialize();
+    }
+    memset(&stats, 0, sizeof(stats));
+}
+
+void chip8_search::setFramesPerStep(unsigned frames)
+{
+    framesPerStep = frames ? frames : 1;
+}
+
+void chip8_search::setCyclesPerFrame(unsigned cycles)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].setCyclesPerFrame(cycles);
+    }
+}
+
+void chip8_search::setIdleSkipping(bool enabled)
+{
+    for (size_t i = 0; i < machines.size(); ++i)
+    {
+        machines[i].setIdleSkipping(enabled);
+    }
+}
+
+// Checked between batches, so a level may overshoot it by up to a batch of successors
+void chip8_search::setStateLimit(size_t states)
+{
+    stateLimit = states ? states : (size_t) -1;
+}
+
+bool chip8_search::reset(const chip8_state &root)
+{
+    if (!chip8_state_valid(root)) {
+        return false;
+    }
+
+    pages.clear();
+    groups.clear();
+    nodes.clear();
+    pageIndex.clear();
+    groupIndex.clear();
+    nodeIndex.clear();
+    current.clear();
+    std::fill(executed.begin(), executed.end(), 0);
+    memset(&stats, 0, sizeof(stats));
+
+    chip8_state &state = scratch[0];
+    state = root;
+    memset(state.key, 0, sizeof(state.key));
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&state);
+
+    Node &node = nodes.append();
+    node.hash = 0;
+    for (int g = 0; g < CHIP8_SEARCH_GROUPS; ++g)
+    {
+        Group group;
+        group.hash = 0;
+        for (int j = 0; j < CHIP8_SEARCH_GROUP_PAGES; ++j)
+        {
+            int p = g * CHIP8_SEARCH_GROUP_PAGES + j;
+            Page page;
+            memcpy(page.bytes, bytes + p * CHIP8_SEARCH_PAGE_SIZE, CHIP8_SEARCH_PAGE_SIZE);
+            page.hash = hashBytes(page.bytes, CHIP8_SEARCH_PAGE_SIZE);
+            group.pages[j] = internPage(page);
+            group.hash += term(p, page.hash);
+        }
+        node.groups[g] = internGroup(group);
+        node.hash += group.hash;
+    }
+    memcpy(node.tail, bytes + CHIP8_SEARCH_PAGES * CHIP8_SEARCH_PAGE_SIZE, CHIP8_SEARCH_TAIL_SIZE);
+    node.hash += term(CHIP8_SEARCH_PAGES, hashBytes(node.tail, CHIP8_SEARCH_TAIL_SIZE));
+    node.parent = CHIP8_SEARCH_NONE;
+    node.depth = 0;
+    node.key = 0;
+
+    nodeIndex.insert(node.hash, 0);
+    current.push_back(0);
+
+    stats.states = 1;
+    stats.frontier = 1;
+    stats.pages = pages.size();
+    stats.groups = groups.size();
+    updateBytes();
+    return true;
+}
+
+size_t chip8_search::expand()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> next;
+    size_t added = 0;
+    size_t done = 0;
+    while (done < current.size() && nodes.size() < stateLimit)
+    {
+        const size_t count = std::min((size_t) CHIP8_SEARCH_BATCH, current.size() - done);
+
+        // Every worker slot gets one machine and pulls parents until the batch is gone
+        std::atomic<size_t> claimed(0);
+        pool.parallelFor(machines.size(), 1, [this, &claimed, count, done](size_t worker, size_t) {
+            for (size_t i = claimed++; i < count; i = claimed++)
+            {
+                expandOne((unsigned) worker, current[done + i], &successors[i * CHIP8_SEARCH_KEYS]);
+            }
+        });
+
+        for (size_t i = 0; i < count * CHIP8_SEARCH_KEYS; ++i)
+        {
+            if (merge(successors[i])) {
+                next.push_back((uint32_t) (nodes.size() - 1));
+                ++added;
+            }
+        }
+        stats.successors += count * CHIP8_SEARCH_KEYS;
+        stats.expanded += count;
+        done += count;
+    }
+
+    // Anything left over by the state limit stays ahead of the new level
+    current.erase(current.begin(), current.begin() + done);
+    current.insert(current.end(), next.begin(), next.end());
+
+    stats.states = nodes.size();
+    stats.duplicates = stats.successors - (stats.states - 1);
+    stats.pages = pages.size();
+    stats.groups = groups.size();
+    stats.frontier = current.size();
+    stats.instructions = 0;
+    for (size_t i = 0; i < executed.size(); ++i)
+    {
+        stats.instructions += executed[i];
+    }
+    if (!next.empty()) {
+        stats.depth = nodes[next.back()].depth;
+    }
+    stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    updateBytes();
+
+    return added;
+}
+
+size_t chip8_search::size() const
+{
+    return nodes.size();
+}
+
+const std::vector<uint32_t> &chip8_search::frontier() const
+{
+    return current;
+}
+
+uint32_t chip8_search::find(const chip8_state &state) const
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&state);
+
+    uint32_t ids[CHIP8_SEARCH_GROUPS];
+    uint64_t hash = 0;
+    for (int g = 0; g < CHIP8_SEARCH_GROUPS; ++g)
+    {
+        Group group;
+        group.hash = 0;
+        for (int j = 0; j < CHIP8_SEARCH_GROUP_PAGES; ++j)
+        {
+            int p = g * CHIP8_SEARCH_GROUP_PAGES + j;
+            const unsigned char *contents = bytes + p * CHIP8_SEARCH_PAGE_SIZE;
+            uint64_t pageHash = hashBytes(contents, CHIP8_SEARCH_PAGE_SIZE);
+            group.pages[j] = pageIndex.find(pageHash, [this, contents](uint32_t i) {
+                return memcmp(pages[i].bytes, contents, CHIP8_SEARCH_PAGE_SIZE) == 0;
+            });
+            if (group.pages[j] == CHIP8_SEARCH_NONE) {
+                return CHIP8_SEARCH_NONE;
+            }
+            group.hash += term(p, pageHash);
+        }
+        ids[g] = groupIndex.find(group.hash, [this, &group](uint32_t i) {
+            return memcmp(groups[i].pages, group.pages, sizeof(group.pages)) == 0;
+        });
+        if (ids[g] == CHIP8_SEARCH_NONE) {
+            return CHIP8_SEARCH_NONE;
+        }
+        hash += group.hash;
+    }
+
+    // The keys held are not part of the state
+    unsigned char tail[CHIP8_SEARCH_TAIL_SIZE];
+    memcpy(tail, bytes + CHIP8_SEARCH_PAGES * CHIP8_SEARCH_PAGE_SIZE, CHIP8_SEARCH_TAIL_SIZE);
+    memset(tail + offsetof(chip8_state, key) - offsetof(chip8_state, V), 0, sizeof(state.key));
+    hash += term(CHIP8_SEARCH_PAGES, hashBytes(tail, CHIP8_SEARCH_TAIL_SIZE));
+
+    return nodeIndex.find(hash, [this, &ids, &tail](uint32_t i) {
+        return memcmp(nodes[i].groups, ids, sizeof(ids)) == 0 && memcmp(nodes[i].tail, tail, sizeof(tail)) == 0;
+    });
+}
+
+void chip8_search::state(uint32_t index, chip8_state &state) const
+{
+    restore(nodes[index], state);
+}
+
+uint64_t chip8_search::hash(uint32_t index) const
+{
+    return nodes[index].hash;
+}
+
+uint32_t chip8_search::parent(uint32_t index) const
+{
+    return nodes[index].parent;
+}
+
+unsigned chip8_search::depth(uint32_t index) const
+{
+    return nodes[index].depth;
+}
+
+void chip8_search::path(uint32_t index, std::vector<unsigned char> &keys) const
+{
+    keys.clear();
+    for (uint32_t i = index; nodes[i].parent != CHIP8_SEARCH_NONE; i = nodes[i].parent)
+    {
+        keys.push_back(nodes[i].key);
+    }
+    std::reverse(keys.begin(), keys.end());
+}
+
+const chip8_search_stats &chip8_search::getStats() const
+{
+    return stats;
+}
+
+const chip8_search::Page &chip8_search::page(const Node &node, int index) const
+{
+    const Group &group = groups[node.groups[index / CHIP8_SEARCH_GROUP_PAGES]];
+    return pages[group.pages[index % CHIP8_SEARCH_GROUP_PAGES]];
+}
+
+void chip8_search::restore(const Node &node, chip8_state &state) const
+{
+    unsigned char *bytes = reinterpret_cast<unsigned char *>(&state);
+    for (int p = 0; p < CHIP8_SEARCH_PAGES; ++p)
+    {
+        memcpy(bytes + p * CHIP8_SEARCH_PAGE_SIZE, page(node, p).bytes, CHIP8_SEARCH_PAGE_SIZE);
+    }
+    memcpy(bytes + CHIP8_SEARCH_PAGES * CHIP8_SEARCH_PAGE_SIZE, node.tail, CHIP8_SEARCH_TAIL_SIZE);
+}
+
+// Runs on a worker: fills out[0..15] with what holding each key for a step does to parent
+void chip8_search::expandOne(unsigned worker, uint32_t parent, Successor *out)
+{
+    chip8 &emu = machines[worker];
+    chip8_state &before = scratch[2 * worker];
+    chip8_state &after = scratch[2 * worker + 1];
+    const unsigned char *from = reinterpret_cast<const unsigned char *>(&before);
+    const unsigned char *to = reinterpret_cast<const unsigned char *>(&after);
+
+    const Node &node = nodes[parent];
+    restore(node, before);
+    const uint64_t base = node.hash - term(CHIP8_SEARCH_PAGES, hashBytes(node.tail, CHIP8_SEARCH_TAIL_SIZE));
+
+    for (int k = 0; k < CHIP8_SEARCH_KEYS; ++k)
+    {
+        unsigned char keys[16] = { 0 };
+        keys[k] = 1;
+        emu.loadState(before);      // Reached from a root reset() checked, so always valid
+        emu.setKeys(keys);
+        executed[worker] += emu.runFrames(framesPerStep).instructions;
+        emu.saveState(after);
+        memset(after.key, 0, sizeof(after.key));
+
+        Successor &s = out[k];
+        s.parent = parent;
+        s.key = (unsigned char) k;
+        s.changed.clear();
+        s.pages.clear();
+
+        uint64_t hash = base;
+        for (int p = 0; p < CHIP8_SEARCH_PAGES; ++p)
+        {
+            const size_t offset = (size_t) p * CHIP8_SEARCH_PAGE_SIZE;
+            if (memcmp(to + offset, from + offset, CHIP8_SEARCH_PAGE_SIZE) == 0) {
+                continue;
+            }
+            s.pages.push_back(Page());
+            Page &changed = s.pages.back();
+            memcpy(changed.bytes, to + offset, CHIP8_SEARCH_PAGE_SIZE);
+            changed.hash = hashBytes(changed.bytes, CHIP8_SEARCH_PAGE_SIZE);
+            s.changed.push_back((uint16_t) p);
+            hash += term(p, changed.hash) - term(p, page(node, p).hash);
+        }
+        memcpy(s.tail, to + CHIP8_SEARCH_PAGES * CHIP8_SEARCH_PAGE_SIZE, CHIP8_SEARCH_TAIL_SIZE);
+        s.hash = hash + term(CHIP8_SEARCH_PAGES, hashBytes(s.tail, CHIP8_SEARCH_TAIL_SIZE));
+    }
+}
+
+uint32_t chip8_search::internPage(const Page &page)
+{
+    uint32_t id = pageIndex.find(page.hash, [this, &page](uint32_t i) {
+        return pages[i].hash == page.hash && memcmp(pages[i].bytes, page.bytes, CHIP8_SEARCH_PAGE_SIZE) == 0;
+    });
+    if (id == CHIP8_SEARCH_NONE) {
+        id = (uint32_t) pages.size();
+        pages.append() = page;
+        pageIndex.insert(page.hash, id);
+    }
+    return id;
+}
+
+uint32_t chip8_search::internGroup(const Group &group)
+{
+    uint32_t id = groupIndex.find(group.hash, [this, &group](uint32_t i) {
+        return groups[i].hash == group.hash && memcmp(groups[i].pages, group.pages, sizeof(group.pages)) == 0;
+    });
+    if (id == CHIP8_SEARCH_NONE) {
+        id = (uint32_t) groups.size();
+        groups.append() = group;
+        groupIndex.insert(group.hash, id);
+    }
+    return id;
+}
+
+// Stores a successor unless an equal state is known; true if it was new
+bool chip8_search::merge(const Successor &s)
+{
+    const Node &parent = nodes[s.parent];
+
+    // Only groups holding a changed page need a new entry; a duplicate state finds all of them stored
+    uint32_t ids[CHIP8_SEARCH_GROUPS];
+    memcpy(ids, parent.groups, sizeof(ids));
+    for (size_t c = 0; c < s.changed.size(); )
+    {
+        const int g = s.changed[c] / CHIP8_SEARCH_GROUP_PAGES;
+        Group group = groups[ids[g]];
+        for (; c < s.changed.size() && s.changed[c] / CHIP8_SEARCH_GROUP_PAGES == g; ++c)
+        {
+            const int p = s.changed[c];
+            const int j = p % CHIP8_SEARCH_GROUP_PAGES;
+            group.hash += term(p, s.pages[c].hash) - term(p, pages[group.pages[j]].hash);
+            group.pages[j] = internPage(s.pages[c]);
+        }
+        ids[g] = internGroup(group);
+    }
+
+    uint32_t known = nodeIndex.find(s.hash, [this, &ids, &s](uint32_t i) {
+        return memcmp(nodes[i].groups, ids, sizeof(ids)) == 0 && memcmp(nodes[i].tail, s.tail, sizeof(s.tail)) == 0;
+    });
+    if (known != CHIP8_SEARCH_NONE) {
+        return false;
+    }
+
+    const uint32_t index = (uint32_t) nodes.size();
+    Node &node = nodes.append();
+    node.hash = s.hash;
+    memcpy(node.groups, ids, sizeof(ids));
+    node.parent = s.parent;
+    node.depth = parent.depth + 1;
+    node.key = s.key;
+    memcpy(node.tail, s.tail, sizeof(s.tail));
+    nodeIndex.insert(s.hash, index);
+    return true;
+}
+
+void chip8_search::updateBytes()
+{
+    stats.bytes = pages.bytes() + groups.bytes() + nodes.bytes()
+            + pageIndex.bytes() + groupIndex.bytes() + nodeIndex.bytes();
+}
@@ -0,0 +1,211 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "chip8.h"
+#include "thread_pool.h"
+
+/*
+ * A chip8_state is the packed framebuffer and memory, which split evenly
+ * into pages, followed by a short tail of registers and timers. Pages are
+ * stored once each and referred to by number; runs of
+ * CHIP8_SEARCH_GROUP_PAGES page numbers are stored once each again, so a
+ * state is CHIP8_SEARCH_GROUPS group numbers plus its tail.
+ */
+#define CHIP8_SEARCH_PAGE_SIZE      256
+#define CHIP8_SEARCH_PAGES          ((int) ((sizeof(chip8_state::gfx) + sizeof(chip8_state::memory)) / CHIP8_SEARCH_PAGE_SIZE))
+#define CHIP8_SEARCH_GROUP_PAGES    8
+#define CHIP8_SEARCH_GROUPS         (CHIP8_SEARCH_PAGES / CHIP8_SEARCH_GROUP_PAGES)
+#define CHIP8_SEARCH_TAIL_SIZE      ((int) (sizeof(chip8_state) - CHIP8_SEARCH_PAGES * CHIP8_SEARCH_PAGE_SIZE))
+
+#define CHIP8_SEARCH_KEYS           16          // Successors per state: key 0 to F held
+#define CHIP8_SEARCH_BATCH          256         // States expanded between merges into the store
+#define CHIP8_SEARCH_NONE           0xFFFFFFFFu // No such state
+
+static_assert(CHIP8_SEARCH_GROUPS * CHIP8_SEARCH_GROUP_PAGES == CHIP8_SEARCH_PAGES, "pages must fill whole groups");
+static_assert(offsetof(chip8_state, memory) == sizeof(chip8_state::gfx)
+              && offsetof(chip8_state, V) == CHIP8_SEARCH_PAGES * CHIP8_SEARCH_PAGE_SIZE,
+              "chip8_state must start with the framebuffer and memory");
+
+struct chip8_search_stats
+{
+    unsigned long long states;          // Distinct states reached, the root included
+    unsigned long long expanded;        // States whose successors were generated
+    unsigned long long successors;      // Generated, duplicates included
+    unsigned long long duplicates;      // Successors that were already known
+    unsigned long long pages;           // Distinct pages stored
+    unsigned long long groups;          // Distinct page groups stored
+    unsigned long long instructions;    // Emulated while expanding
+    unsigned long long frontier;        // States not expanded yet
+    unsigned depth;                     // Deepest level reached
+    double seconds;                     // Spent in expand()
+    size_t bytes;                       // Held by the store and its indexes
+};
+
+/*
+ * Breadth-first exploration of the states a ROM can reach.
+ *
+ * Each state is expanded into CHIP8_SEARCH_KEYS successors by holding one
+ * key for a number of frames. States are hash-consed: a successor only
+ * stores the pages that differ from its parent's, and a state that was
+ * reached before is recognized by its hash and one comparison of group
+ * numbers and tail, so a state costs a few hundred bytes instead of a
+ * whole chip8_state.
+ *
+ * The state hash is a sum of one term per page and one for the tail, each
+ * mixed with its position, so a successor's hash is its parent's with the
+ * terms of the changed pages swapped. Keys are not part of a state; they
+ * are set afresh for every step.
+ *
+ * expand() runs the emulation on the thread pool: each worker restores a
+ * parent into its own machine, runs it once per key and hashes what
+ * changed. The successors are then merged into the store in order on the
+ * calling thread, so state numbers do not depend on the number of threads.
+ */
+class chip8_search
+{
+public:
+    explicit chip8_search(chip8_thread_pool &pool);
+
+    void setFramesPerStep(unsigned frames);     // How long each key is held (default 1)
+    void setCyclesPerFrame(unsigned cycles);
+    void setIdleSkipping(bool enabled);
+    void setStateLimit(size_t states);          // expand() stops adding states here (default: none)
+
+    bool reset(const chip8_state &root);        // Forgets everything, root becomes state 0; false if root is invalid
+    size_t expand();                            // Expands the frontier by one level, returns the new states
+
+    size_t size() const;                        // States reached
+    const std::vector<uint32_t> &frontier() const;  // States of the deepest level, not expanded yet
+    uint32_t find(const chip8_state &state) const;  // The number of an equal state, or CHIP8_SEARCH_NONE
+
+    void state(uint32_t index, chip8_state &state) const;
+    uint64_t hash(uint32_t index) const;
+    uint32_t parent(uint32_t index) const;      // CHIP8_SEARCH_NONE for the root
+    unsigned depth(uint32_t index) const;
+    void path(uint32_t index, std::vector<unsigned char> &keys) const;  // Keys held from the root, one per step
+
+    const chip8_search_stats &getStats() const;
+
+private:
+    chip8_search(const chip8_search &) = delete;
+    chip8_search &operator=(const chip8_search &) = delete;
+
+    struct Page
+    {
+        unsigned char bytes[CHIP8_SEARCH_PAGE_SIZE];
+        uint64_t hash;                          // Of the contents alone
+    };
+
+    struct Group
+    {
+        uint32_t pages[CHIP8_SEARCH_GROUP_PAGES];
+        uint64_t hash;                          // Sum of the page terms, so it depends on the position
+    };
+
+    struct Node
+    {
+        uint64_t hash;
+        uint32_t groups[CHIP8_SEARCH_GROUPS];
+        uint32_t parent;
+        uint32_t depth;
+        unsigned char key;                      // Held from parent to here
+        unsigned char tail[CHIP8_SEARCH_TAIL_SIZE];     // The state after the pages, keys zeroed
+    };
+
+    // A successor between expanding and merging
+    struct Successor
+    {
+        uint64_t hash;
+        uint32_t parent;
+        unsigned char key;
+        unsigned char tail[CHIP8_SEARCH_TAIL_SIZE];
+        std::vector<uint16_t> changed;          // Pages that differ from the parent, in order
+        std::vector<Page> pages;                // Their new contents
+    };
+
+    // Append-only array in fixed chunks, so growing never copies or doubles
+    template <class T>
+    class Store
+    {
+    public:
+        Store() : count(0) {}
+
+        size_t size() const { return count; }
+        size_t bytes() const { return chunks.size() * CHUNK * sizeof(T); }
+        const T &operator[](size_t i) const { return chunks[i / CHUNK][i % CHUNK]; }
+        T &operator[](size_t i) { return chunks[i / CHUNK][i % CHUNK]; }
+
+        T &append()
+        {
+            if (count == chunks.size() * CHUNK) {
+                chunks.push_back(std::unique_ptr<T[]>(new T[CHUNK]));
+            }
+            ++count;
+            return (*this)[count - 1];
+        }
+
+        void clear()
+        {
+            chunks.clear();
+            count = 0;
+        }
+
+    private:
+        static const size_t CHUNK = 4096;
+        std::vector<std::unique_ptr<T[]> > chunks;
+        size_t count;
+    };
+
+    /*
+     * Open-addressed hash set of item numbers. Each slot keeps the low half
+     * of the item's hash next to its number, which is enough to place it
+     * when growing and to skip most mismatches without touching the item.
+     */
+    class Index
+    {
+    public:
+        Index();
+
+        void clear();
+        size_t bytes() const;
+        template <class Equal> uint32_t find(uint64_t hash, const Equal &equal) const;
+        void insert(uint64_t hash, uint32_t item);
+
+    private:
+        std::vector<uint64_t> slots;            // (hash << 32) | (item + 1), 0 when empty
+        size_t count;
+    };
+
+    chip8_thread_pool &pool;
+    unsigned framesPerStep;
+    size_t stateLimit;
+
+    Store<Page> pages;
+    Store<Group> groups;
+    Store<Node> nodes;
+    Index pageIndex;
+    Index groupIndex;
+    Index nodeIndex;
+
+    std::vector<uint32_t> current;              // The frontier
+    std::vector<chip8> machines;                // One per worker
+    std::vector<chip8_state> scratch;           // Two per worker: the parent and a successor
+    std::vector<unsigned long long> executed;   // Instructions per worker
+    std::vector<Successor> successors;          // One batch
+    chip8_search_stats stats;
+
+    const Page &page(const Node &node, int index) const;
+    void restore(const Node &node, chip8_state &state) const;
+    void expandOne(unsigned worker, uint32_t parent, Successor *out);
+    uint32_t internPage(const Page &page);
+    uint32_t internGroup(const Group &group);
+    bool merge(const Successor &successor);
+    void updateBytes();
+};
+
+#endif // SEARCH_H
@@ -0,0 +1,282 @@
+#include "shm.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_HAVE_SHM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static inline void cpuRelax()
+{
+#ifdef __SSE2__
+    _mm_pause();
+#endif
+}
+
+// Spins briefly, then yields, then sleeps, so a waiter that is not answered soon gives up its core
+static void backoff(unsigned &spins)
+{
+    if (spins < 256) {
+        cpuRelax();
+        ++spins;
+    } else if (spins < 4096) {
+        std::this_thread::yield();
+        ++spins;
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+chip8_shm::chip8_shm() : mapping(NULL), length(0), owner(false)
+{
+    name[0] = '\0';
+}
+
+chip8_shm::~chip8_shm()
+{
+    close();
+}
+
+// POSIX names are "/something"; the slash is added if it was left out
+static void shmName(char *out, size_t size, const char *name)
+{
+    snprintf(out, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+bool chip8_shm::create(const char *name, unsigned slots, unsigned mode, uint64_t romHash)
+{
+    close();
+    if (slots == 0) {
+        return false;
+    }
+
+#ifdef CHIP8_HAVE_SHM
+    shmName(this->name, sizeof(this->name), name);
+
+    // A region left behind by an emulator that died is replaced
+    shm_unlink(this->name);
+    int fd = shm_open(this->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t size = sizeof(chip8_shm_header) + slots * sizeof(chip8_shm_slot);
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, (off_t) size) == 0) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(this->name);
+        return false;
+    }
+
+    mapping = p;
+    length = size;
+    owner = true;
+
+    // The new object is zero filled, which is every counter's starting value
+    chip8_shm_header *h = header();
+    memcpy(h->magic, CHIP8_SHM_MAGIC, 4);
+    h->version = CHIP8_SHM_VERSION;
+    h->byteOrder = CHIP8_SHM_BYTE_ORDER;
+    h->headerSize = sizeof(chip8_shm_header);
+    h->slotSize = sizeof(chip8_shm_slot);
+    h->slots = slots;
+    h->mode = mode;
+    h->romHash = romHash;
+    h->serving.store(1, std::memory_order_release);
+    return true;
+#else
+    (void) name;
+    (void) mode;
+    (void) romHash;
+    return false;
+#endif
+}
+
+bool chip8_shm::attach(const char *name)
+{
+    close();
+
+#ifdef CHIP8_HAVE_SHM
+    shmName(this->name, sizeof(this->name), name);
+    int fd = shm_open(this->name, O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(chip8_shm_header)) {
+        p = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+
+    mapping = p;
+    length = (size_t) st.st_size;
+    owner = false;
+
+    const chip8_shm_header *h = header();
+    if (memcmp(h->magic, CHIP8_SHM_MAGIC, 4) != 0
+            || h->version != CHIP8_SHM_VERSION
+            || h->byteOrder != CHIP8_SHM_BYTE_ORDER
+            || h->headerSize != sizeof(chip8_shm_header)
+            || h->slotSize != sizeof(chip8_shm_slot)
+            || h->slots == 0
+            || length != sizeof(chip8_shm_header) + (size_t) h->slots * sizeof(chip8_shm_slot)) {
+        close();
+        return false;
+    }
+    return true;
+#else
+    (void) name;
+    return false;
+#endif
+}
+
+void chip8_shm::close()
+{
+#ifdef CHIP8_HAVE_SHM
+    if (mapping != NULL) {
+        if (owner) {
+            header()->serving.store(0, std::memory_order_release);
+        }
+        munmap(mapping, length);
+        if (owner) {
+            shm_unlink(name);
+        }
+    }
+#endif
+    mapping = NULL;
+    length = 0;
+    owner = false;
+}
+
+bool chip8_shm::isOpen() const
+{
+    return mapping != NULL;
+}
+
+unsigned chip8_shm::slots() const
+{
+    return mapping ? header()->slots : 0;
+}
+
+unsigned chip8_shm::mode() const
+{
+    return mapping ? header()->mode : CHIP8_SHM_FREE;
+}
+
+chip8_shm_header *chip8_shm::header() const
+{
+    return (chip8_shm_header *) mapping;
+}
+
+chip8_shm_slot *chip8_shm::slot(unsigned index) const
+{
+    return (chip8_shm_slot *) ((unsigned char *) mapping + sizeof(chip8_shm_header)) + index;
+}
+
+unsigned chip8_shm::keys(unsigned index) const
+{
+    return slot(index)->keys.load(std::memory_order_relaxed) & 0xFFFF;
+}
+
+// Writes the frame that just ran under the slot's seqlock
+void chip8_shm::publish(unsigned index, const chip8 &emu, uint64_t frameNumber)
+{
+    chip8_shm_slot *s = slot(index);
+    uint32_t sequence = s->sequence.load(std::memory_order_relaxed);
+    s->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    chip8_shm_frame &f = s->frame;
+    f.number = frameNumber;
+    f.hash = emu.framebufferHash();
+    f.flags = (emu.isHires() ? CHIP8_SHM_HIRES : 0) | (emu.getSoundTimer() > 0 ? CHIP8_SHM_BEEP : 0);
+    f.pc = emu.getPC();
+    f.soundTimer = emu.getSoundTimer();
+    f.delayTimer = emu.getDelayTimer();
+    memcpy(f.rows, emu.getFramebuffer(), sizeof(f.rows));
+
+    s->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool chip8_shm::waitRequest(unsigned index, uint32_t &request)
+{
+    chip8_shm_slot *s = slot(index);
+    uint32_t done = s->done.load(std::memory_order_relaxed);
+    unsigned spins = 0;
+    for (;;)
+    {
+        uint32_t r = s->request.load(std::memory_order_acquire);
+        if (r != done) {
+            request = r;
+            return true;
+        }
+        if (header()->stop.load(std::memory_order_relaxed) != 0) {
+            return false;
+        }
+        backoff(spins);
+    }
+}
+
+void chip8_shm::complete(unsigned index, uint32_t request)
+{
+    slot(index)->done.store(request, std::memory_order_release);
+}
+
+bool chip8_shm::step(unsigned index, unsigned keys)
+{
+    chip8_shm_slot *s = slot(index);
+    s->keys.store(keys & 0xFFFF, std::memory_order_relaxed);
+    uint32_t request = s->request.load(std::memory_order_relaxed) + 1;
+    s->request.store(request, std::memory_order_release);
+
+    unsigned spins = 0;
+    while (s->done.load(std::memory_order_acquire) != request)
+    {
+        if (header()->serving.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        backoff(spins);
+    }
+    return true;
+}
+
+void chip8_shm::read(unsigned index, chip8_shm_frame &frame) const
+{
+    const chip8_shm_slot *s = slot(index);
+    for (;;)
+    {
+        uint32_t before = s->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            cpuRelax();
+            continue;
+        }
+        memcpy(&frame, &s->frame, sizeof(frame));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s->sequence.load(std::memory_order_relaxed) == before) {
+            return;
+        }
+    }
+}
+
+void chip8_shm::requestStop()
+{
+    header()->stop.store(1, std::memory_order_release);
+}
@@ -0,0 +1,130 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "chip8.h"
+
+#define CHIP8_SHM_MAGIC         "C8SH"
+#define CHIP8_SHM_VERSION       1
+#define CHIP8_SHM_BYTE_ORDER    0x0102
+
+// chip8_shm_header::mode
+#define CHIP8_SHM_FREE          0       // The emulator runs at its own pace and reads keys every frame
+#define CHIP8_SHM_STEPPED       1       // The emulator runs one frame per agent request
+
+// chip8_shm_frame::flags
+#define CHIP8_SHM_HIRES         1       // 128x64
+#define CHIP8_SHM_BEEP          2       // Sound timer running
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory needs lock-free 32-bit atomics");
+
+/*
+ * Shared-memory interface for agents in other processes.
+ *
+ * The region is this header followed by slots copies of chip8_shm_slot,
+ * one per machine, with the layout fixed by the static_asserts below so
+ * agents in any language can map it. Atomics are plain aligned 32-bit
+ * words.
+ *
+ * Each slot's frame is published under a seqlock: the emulator makes
+ * sequence odd, writes the frame, then makes it even again. A reader
+ * that may race the emulator (CHIP8_SHM_FREE) reads sequence, the frame,
+ * and sequence again, and retries if they differ or were odd.
+ *
+ * In CHIP8_SHM_STEPPED mode the emulator waits for the agent instead:
+ * the agent writes keys and then increments request; the emulator runs
+ * one frame with those keys, publishes it and sets done to request.
+ * Between done == request and the next request nothing writes the slot,
+ * so the agent can read the frame in place with no retry and no copy.
+ */
+struct chip8_shm_header
+{
+    char magic[4];                      // CHIP8_SHM_MAGIC, not NUL terminated
+    uint16_t version;                   // CHIP8_SHM_VERSION
+    uint16_t byteOrder;                 // CHIP8_SHM_BYTE_ORDER as written by the host
+    uint32_t headerSize;                // sizeof(chip8_shm_header), the first slot starts here
+    uint32_t slotSize;                  // sizeof(chip8_shm_slot)
+    uint32_t slots;
+    uint32_t mode;                      // CHIP8_SHM_FREE or CHIP8_SHM_STEPPED
+    std::atomic<uint32_t> serving;      // 1 while the emulator is attached, 0 once it has left
+    std::atomic<uint32_t> stop;         // Set by an agent to ask a stepped emulator to quit
+    uint64_t romHash;                   // chip8_rom_hash() of the ROM the machines run
+    uint32_t reserved[6];
+};
+
+static_assert(sizeof(chip8_shm_header) == 64, "chip8_shm_header must stay 64 bytes");
+
+// What the emulator publishes after each frame
+struct chip8_shm_frame
+{
+    uint64_t number;                    // Frames run since the emulator started
+    uint64_t hash;                      // chip8::framebufferHash()
+    uint32_t flags;                     // CHIP8_SHM_HIRES, CHIP8_SHM_BEEP
+    uint16_t pc;
+    uint8_t soundTimer;
+    uint8_t delayTimer;
+    uint64_t rows[CHIP8_PLANES * CHIP8_FB_PLANE_WORDS];    // Packed framebuffer, see CHIP8_FB_ROWS
+};
+
+struct chip8_shm_slot
+{
+    // Written by the emulator
+    alignas(64) std::atomic<uint32_t> sequence;     // Seqlock over frame, odd while it is written
+    std::atomic<uint32_t> done;                     // STEPPED: the request the published frame answers
+    chip8_shm_frame frame;
+
+    // Written by the agent, on their own cache line
+    alignas(64) std::atomic<uint32_t> keys;         // Bit k set while key k is down
+    std::atomic<uint32_t> request;                  // STEPPED: incremented to run one more frame
+};
+
+static_assert(sizeof(chip8_shm_frame) == 24 + 8 * CHIP8_PLANES * CHIP8_FB_PLANE_WORDS, "chip8_shm_frame layout changed");
+static_assert(offsetof(chip8_shm_slot, frame) == 8, "chip8_shm_slot layout changed");
+static_assert(offsetof(chip8_shm_slot, keys) % 64 == 0 && sizeof(chip8_shm_slot) % 64 == 0, "chip8_shm_slot layout changed");
+
+/*
+ * A mapped region, from either end. The emulator create()s it and removes
+ * the name again on close(); agents attach() to it by name. POSIX only,
+ * elsewhere both fail.
+ */
+class chip8_shm
+{
+public:
+    chip8_shm();
+    ~chip8_shm();
+
+    bool create(const char *name, unsigned slots, unsigned mode, uint64_t romHash);
+    bool attach(const char *name);
+    void close();
+    bool isOpen() const;
+
+    unsigned slots() const;
+    unsigned mode() const;
+    chip8_shm_header *header() const;
+    chip8_shm_slot *slot(unsigned index) const;
+
+    // Emulator side
+    unsigned keys(unsigned index) const;
+    void publish(unsigned index, const chip8 &emu, uint64_t frameNumber);
+    bool waitRequest(unsigned index, uint32_t &request);    // STEPPED, false once an agent asked to stop
+    void complete(unsigned index, uint32_t request);        // STEPPED, after publish()
+
+    // Agent side
+    bool step(unsigned index, unsigned keys);               // STEPPED: runs one frame, false if the emulator left
+    void read(unsigned index, chip8_shm_frame &frame) const;   // Consistent copy in either mode
+    void requestStop();
+
+private:
+    chip8_shm(const chip8_shm &) = delete;
+    chip8_shm &operator=(const chip8_shm &) = delete;
+
+    void *mapping;
+    size_t length;
+    bool owner;
+    char name[64];
+};
+
+#endif // SHM_H
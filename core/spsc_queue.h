@@ -0,0 +1,62 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+
+/*
+ * Bounded lock-free queue for exactly one producer and one consumer thread.
+ * Size must be a power of two; one slot is kept free to tell full from empty.
+ */
+template <typename T, unsigned Size>
+class chip8_spsc_queue
+{
+    static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+public:
+    chip8_spsc_queue() : head(0), tail(0)
+    {
+    }
+
+    // Producer side, returns false if the queue is full
+    bool push(const T &item)
+    {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        unsigned next = (t + 1) & (Size - 1);
+        if (next == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        items[t] = item;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false if the queue is empty
+    bool pop(T &item)
+    {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[h];
+        head.store((h + 1) & (Size - 1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    // Items waiting, possibly already out of date on the other side
+    unsigned size() const
+    {
+        return (tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire)) & (Size - 1);
+    }
+
+private:
+    T items[Size];
+    alignas(64) std::atomic<unsigned> head;     // Next slot to read, written by the consumer
+    alignas(64) std::atomic<unsigned> tail;     // Next slot to write, written by the producer
+};
+
+#endif // SPSC_QUEUE_H
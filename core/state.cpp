@@ -0,0 +1,96 @@
+#include "state.h"
+#include <cstdio>
+#include <cstring>
+
+chip8_state_file::chip8_state_file() : data(NULL)
+{
+}
+
+chip8_state_file::~chip8_state_file()
+{
+    close();
+}
+
+// Savestates are untrusted files: anything used as an index or a mode is checked before it is copied in.
+// Every pitch value is valid (FX3A takes any byte) and PC and I are masked where they are used
+bool chip8_state_valid(const chip8_state &state)
+{
+    for (size_t i = 0; i < sizeof(state.pad); ++i)
+    {
+        if (state.pad[i] != 0) {
+            return false;
+        }
+    }
+
+    return state.sp <= 16
+        && state.hires <= 1
+        && state.planes <= 0x03
+        && state.quirks < chip8::QUIRKS_COUNT;
+}
+
+// Checks the header and returns the state that follows it, or NULL
+static const chip8_state *validate(const unsigned char *file, size_t size)
+{
+    if (size != sizeof(chip8_state_header) + sizeof(chip8_state)) {
+        return NULL;
+    }
+
+    const chip8_state_header *header = (const chip8_state_header *) file;
+    if (memcmp(header->magic, CHIP8_STATE_MAGIC, 4) != 0
+            || header->version != CHIP8_STATE_VERSION
+            || header->byteOrder != CHIP8_STATE_BYTE_ORDER
+            || header->size != sizeof(chip8_state)) {
+        return NULL;
+    }
+
+    const chip8_state *state = (const chip8_state *) (file + sizeof(chip8_state_header));
+    return chip8_state_valid(*state) ? state : NULL;
+}
+
+bool chip8_state_file::open(const char *filename)
+{
+    close();
+
+    if (!file.open(filename, sizeof(chip8_state_header) + sizeof(chip8_state))) {
+        return false;
+    }
+
+    data = validate(file.data(), file.size());
+    if (data == NULL) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void chip8_state_file::close()
+{
+    file.close();
+    data = NULL;
+}
+
+const chip8_state *chip8_state_file::state() const
+{
+    return data;
+}
+
+bool chip8_state_file::write(const char *filename, const chip8_state &state)
+{
+    chip8_state_header header;
+    memcpy(header.magic, CHIP8_STATE_MAGIC, 4);
+    header.version = CHIP8_STATE_VERSION;
+    header.byteOrder = CHIP8_STATE_BYTE_ORDER;
+    header.size = sizeof(chip8_state);
+    header.reserved = 0;
+
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+            && fwrite(&state, sizeof(state), 1, fp) == 1;
+
+    return (fclose(fp) == 0) && ok;
+}
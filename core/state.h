@@ -0,0 +1,56 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "mapfile.h"
+
+#define CHIP8_STATE_MAGIC       "C8ST"
+#define CHIP8_STATE_BYTE_ORDER  0x0102      // Reads back as 0x0201 on the other endianness
+
+/*
+ * Savestate file: this header followed by a raw chip8_state. The header is
+ * 16 bytes so the state stays 8-byte aligned inside a page-aligned mapping.
+ */
+struct chip8_state_header
+{
+    char magic[4];              // CHIP8_STATE_MAGIC, not NUL terminated
+    uint16_t version;           // CHIP8_STATE_VERSION
+    uint16_t byteOrder;         // CHIP8_STATE_BYTE_ORDER as written by the host
+    uint32_t size;              // sizeof(chip8_state)
+    uint32_t reserved;
+};
+
+static_assert(sizeof(chip8_state_header) == 16, "chip8_state_header must stay 16 bytes");
+
+// False if the state holds values no machine can reach (stack pointer past the stack, unknown modes)
+bool chip8_state_valid(const chip8_state &state);
+
+/*
+ * A savestate opened for reading. The file is memory-mapped where the
+ * platform allows it (read into a buffer otherwise) and validated once, so
+ * any number of machines can be restored from state() with one copy each.
+ */
+class chip8_state_file
+{
+public:
+    chip8_state_file();
+    ~chip8_state_file();
+
+    bool open(const char *filename);
+    void close();
+    const chip8_state *state() const;   // NULL unless open() succeeded
+
+    static bool write(const char *filename, const chip8_state &state);
+
+private:
+    chip8_state_file(const chip8_state_file &) = delete;
+    chip8_state_file &operator=(const chip8_state_file &) = delete;
+
+    chip8_mapped_file file;
+    const chip8_state *data;
+};
+
+#endif // STATE_H
@@ -0,0 +1,154 @@
+#include "thread_pool.h"
+
+chip8_thread_pool::chip8_thread_pool(unsigned threads) :
+    generation(0), quit(false), job(NULL), remaining(0)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        workers.push_back(new Worker());
+    }
+
+    // Worker 0 is whoever calls parallelFor()
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        this->threads.push_back(std::thread(&chip8_thread_pool::workerLoop, this, i));
+    }
+}
+
+chip8_thread_pool::~chip8_thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        quit = true;
+    }
+    jobReady.notify_all();
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        delete workers[i];
+    }
+}
+
+unsigned chip8_thread_pool::size() const
+{
+    return (unsigned) workers.size();
+}
+
+void chip8_thread_pool::parallelFor(size_t count, size_t chunk, const std::function<void(size_t, size_t)> &fn)
+{
+    if (count == 0) {
+        return;
+    }
+    if (chunk == 0) {
+        chunk = 1;
+    }
+
+    if (workers.size() == 1) {
+        for (size_t begin = 0; begin < count; begin += chunk)
+        {
+            fn(begin, (begin + chunk < count) ? begin + chunk : count);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+
+        // Publish the job before any task: a worker still draining may pick one up early
+        job = &fn;
+        remaining.store((count + chunk - 1) / chunk);
+
+        // Deal chunks round-robin so every worker starts with local work
+        size_t n = 0;
+        for (size_t begin = 0; begin < count; begin += chunk, ++n)
+        {
+            Range range;
+            range.begin = begin;
+            range.end = (begin + chunk < count) ? begin + chunk : count;
+
+            Worker *worker = workers[n % workers.size()];
+            std::lock_guard<std::mutex> workerGuard(worker->lock);
+            worker->tasks.push_back(range);
+        }
+
+        ++generation;
+    }
+    jobReady.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock<std::mutex> guard(jobLock);
+    jobDone.wait(guard, [this] { return remaining.load() == 0; });
+    job = NULL;
+}
+
+void chip8_thread_pool::workerLoop(unsigned index)
+{
+    unsigned long long seen = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(jobLock);
+            jobReady.wait(guard, [&] { return quit || generation != seen; });
+            if (quit) {
+                return;
+            }
+            seen = generation;
+        }
+
+        runTasks(index);
+    }
+}
+
+void chip8_thread_pool::runTasks(unsigned index)
+{
+    Range range;
+    while (takeTask(index, range))
+    {
+        (*job)(range.begin, range.end);
+
+        if (remaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> guard(jobLock);
+            jobDone.notify_all();
+        }
+    }
+}
+
+// Own deque from the back first, then steal from the front of the others
+bool chip8_thread_pool::takeTask(unsigned index, Range &range)
+{
+    {
+        Worker *own = workers[index];
+        std::lock_guard<std::mutex> guard(own->lock);
+        if (!own->tasks.empty()) {
+            range = own->tasks.back();
+            own->tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers.size(); ++i)
+    {
+        Worker *victim = workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if (!victim->tasks.empty()) {
+            range = victim->tasks.front();
+            victim->tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed-size work-stealing thread pool for data-parallel loops.
+ * parallelFor() cuts the index range into chunks and deals them out to
+ * per-worker deques. Each worker drains its own deque from the back and,
+ * once empty, steals from the front of the others. The calling thread
+ * takes part as worker 0, so a pool of size 1 runs everything inline.
+ */
+class chip8_thread_pool
+{
+public:
+    explicit chip8_thread_pool(unsigned threads = 0);  // 0: one per hardware thread
+    ~chip8_thread_pool();
+
+    unsigned size() const;
+
+    // Calls fn(begin, end) over [0, count) in chunks of at most chunk indices
+    void parallelFor(size_t count, size_t chunk, const std::function<void(size_t, size_t)> &fn);
+
+private:
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Range> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    void runTasks(unsigned index);
+    bool takeTask(unsigned index, Range &range);
+
+    std::vector<std::thread> threads;
+    std::vector<Worker *> workers;
+
+    std::mutex jobLock;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    unsigned long long generation;
+    bool quit;
+
+    const std::function<void(size_t, size_t)> *job;
+    std::atomic<size_t> remaining;      // Chunks not finished yet
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,204 @@
+#include "trace.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_HAVE_SIGNALS
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#ifdef CHIP8_HAVE_SIGNALS
+static const chip8_trace *crashTrace = NULL;
+static char crashFile[1024];
+static const int crashSignals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+#endif
+
+chip8_trace::chip8_trace(size_t entries) : count(0)
+{
+    // Round up to a power of two so the ring index is a mask
+    size_t size = 1;
+    while (size < entries)
+    {
+        size <<= 1;
+    }
+    this->entries.resize(size);
+    mask = size - 1;
+}
+
+chip8_trace::~chip8_trace()
+{
+#ifdef CHIP8_HAVE_SIGNALS
+    if (crashTrace == this) {
+        crashTrace = NULL;
+    }
+#endif
+}
+
+void chip8_trace::clear()
+{
+    count.store(0, std::memory_order_release);
+}
+
+uint64_t chip8_trace::total() const
+{
+    return count.load(std::memory_order_acquire);
+}
+
+uint64_t chip8_trace::snapshot(std::vector<chip8_trace_entry> &out) const
+{
+    uint64_t size = entries.size();
+    uint64_t end = count.load(std::memory_order_acquire);
+    uint64_t begin = (end > size) ? end - size : 0;
+
+    out.resize((size_t) (end - begin));
+    for (uint64_t i = begin; i < end; ++i)
+    {
+        out[(size_t) (i - begin)] = entries[i & mask];
+    }
+
+    // The writer is working on entry `after`, which shares a slot with after - size
+    uint64_t after = count.load(std::memory_order_acquire);
+    if (after + 1 > begin + size) {
+        uint64_t lost = after + 1 - size - begin;
+        if (lost > out.size()) {
+            lost = out.size();
+        }
+        out.erase(out.begin(), out.begin() + (size_t) lost);
+        begin += lost;
+    }
+
+    return begin;
+}
+
+// Writes the header and the given entries, used by dump() and the crash handler
+static bool writeTrace(FILE *fp, uint64_t first, const chip8_trace_entry *data, uint64_t n)
+{
+    chip8_trace_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHIP8_TRACE_MAGIC, 4);
+    header.version = CHIP8_TRACE_VERSION;
+    header.byteOrder = CHIP8_TRACE_BYTE_ORDER;
+    header.entrySize = sizeof(chip8_trace_entry);
+    header.total = first + n;
+    header.count = n;
+
+    return fwrite(&header, sizeof(header), 1, fp) == 1
+            && (n == 0 || fwrite(data, sizeof(chip8_trace_entry), (size_t) n, fp) == n);
+}
+
+bool chip8_trace::dump(const char *filename) const
+{
+    std::vector<chip8_trace_entry> out;
+    uint64_t first = snapshot(out);
+
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    bool ok = writeTrace(fp, first, out.empty() ? NULL : &out[0], out.size());
+    return (fclose(fp) == 0) && ok;
+}
+
+bool chip8_trace::load(const char *filename, chip8_trace_header &header, std::vector<chip8_trace_entry> &entries)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1
+            && memcmp(header.magic, CHIP8_TRACE_MAGIC, 4) == 0
+            && header.version == CHIP8_TRACE_VERSION
+            && header.byteOrder == CHIP8_TRACE_BYTE_ORDER
+            && header.entrySize == sizeof(chip8_trace_entry)
+            && header.count <= header.total;
+
+    if (ok) {
+        entries.resize((size_t) header.count);
+        ok = header.count == 0 || fread(&entries[0], sizeof(chip8_trace_entry), entries.size(), fp) == entries.size();
+    }
+    fclose(fp);
+
+    return ok;
+}
+
+/*
+ * Crash dumps. The handler only uses async-signal-safe calls: it writes
+ * straight from the ring with write(2), then re-raises the signal with the default action.
+ */
+#ifdef CHIP8_HAVE_SIGNALS
+static void writeAll(int fd, const void *data, size_t length)
+{
+    const char *p = (const char *) data;
+    while (length > 0)
+    {
+        ssize_t n = write(fd, p, length);
+        if (n <= 0) {
+            return;
+        }
+        p += n;
+        length -= (size_t) n;
+    }
+}
+
+struct chip8_trace_crash
+{
+    static void handler(int sig)
+    {
+        const chip8_trace *trace = crashTrace;
+        int fd = (trace != NULL) ? open(crashFile, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+        if (fd >= 0) {
+            uint64_t size = trace->entries.size();
+            // Entries are published before they run, so this includes the one that crashed
+            uint64_t end = trace->count.load(std::memory_order_acquire);
+            uint64_t begin = (end > size) ? end - size : 0;
+
+            chip8_trace_header header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, CHIP8_TRACE_MAGIC, 4);
+            header.version = CHIP8_TRACE_VERSION;
+            header.byteOrder = CHIP8_TRACE_BYTE_ORDER;
+            header.entrySize = sizeof(chip8_trace_entry);
+            header.total = end;
+            header.count = end - begin;
+            writeAll(fd, &header, sizeof(header));
+
+            // The ring in at most two pieces
+            uint64_t first = begin & trace->mask;
+            uint64_t n = end - begin;
+            uint64_t tail = (first + n > size) ? size - first : n;
+            writeAll(fd, &trace->entries[first], tail * sizeof(chip8_trace_entry));
+            if (n > tail) {
+                writeAll(fd, &trace->entries[0], (n - tail) * sizeof(chip8_trace_entry));
+            }
+            close(fd);
+        }
+
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+};
+#endif
+
+bool chip8_trace::dumpOnCrash(const char *filename)
+{
+#ifdef CHIP8_HAVE_SIGNALS
+    if (strlen(filename) >= sizeof(crashFile)) {
+        return false;
+    }
+    strcpy(crashFile, filename);
+    crashTrace = this;
+
+    for (size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); ++i)
+    {
+        signal(crashSignals[i], chip8_trace_crash::handler);
+    }
+    return true;
+#else
+    (void) filename;
+    return false;
+#endif
+}
@@ -0,0 +1,107 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#define CHIP8_TRACE_MAGIC           "C8TR"
+#define CHIP8_TRACE_VERSION         1
+#define CHIP8_TRACE_BYTE_ORDER      0x0102
+#define CHIP8_TRACE_DEFAULT_ENTRIES (1 << 20)   // 8 MB, must be a power of two
+
+#define CHIP8_TRACE_NO_REG          0xFF
+
+// One executed instruction
+struct chip8_trace_entry
+{
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t I;                 // Before the instruction ran
+    uint8_t reg;                // Register the instruction writes, or CHIP8_TRACE_NO_REG
+    uint8_t value;              // Its value afterwards
+};
+
+static_assert(sizeof(chip8_trace_entry) == 8, "chip8_trace_entry must stay 8 bytes");
+
+// A dump: this header, then count entries oldest first
+struct chip8_trace_header
+{
+    char magic[4];              // CHIP8_TRACE_MAGIC, not NUL terminated
+    uint16_t version;           // CHIP8_TRACE_VERSION
+    uint16_t byteOrder;         // CHIP8_TRACE_BYTE_ORDER as written by the host
+    uint32_t entrySize;         // sizeof(chip8_trace_entry)
+    uint32_t reserved;
+    uint64_t total;             // Instructions traced in all, the first entry is number total - count
+    uint64_t count;
+};
+
+static_assert(sizeof(chip8_trace_header) == 32, "chip8_trace_header must stay 32 bytes");
+
+/*
+ * Ring of the most recently executed instructions, attached to one machine
+ * with chip8::setTrace().
+ *
+ * Only the emulating thread writes. Each entry is filled in and then
+ * published with a release store of the entry count, so other threads
+ * (and a crash handler) can take a snapshot at any time without locking:
+ * entries the writer may have overwritten meanwhile are dropped from it.
+ * The value of the newest entry is filled in when the next instruction
+ * starts or the batch ends, so a snapshot taken mid-batch may show the
+ * register as it was before that instruction.
+ */
+class chip8_trace
+{
+public:
+    explicit chip8_trace(size_t entries = CHIP8_TRACE_DEFAULT_ENTRIES);
+    ~chip8_trace();
+
+    void clear();                           // Only while no machine is writing
+    uint64_t total() const;
+
+    // Copies the newest entries out, oldest first; returns the number traced before them
+    uint64_t snapshot(std::vector<chip8_trace_entry> &out) const;
+    bool dump(const char *filename) const;
+    static bool load(const char *filename, chip8_trace_header &header, std::vector<chip8_trace_entry> &entries);
+
+    // Dumps this trace to filename if the process dies on a fatal signal
+    bool dumpOnCrash(const char *filename);
+
+    /*
+     * Writer side, for the engines: they keep the ring, mask and count in
+     * registers for a batch, fill in entry count & mask, then publish
+     * count + 1.
+     */
+    chip8_trace_entry *ring()
+    {
+        return &entries[0];
+    }
+
+    uint64_t ringMask() const
+    {
+        return mask;
+    }
+
+    uint64_t written() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    void publish(uint64_t n)
+    {
+        count.store(n, std::memory_order_release);
+    }
+
+private:
+    friend struct chip8_trace_crash;
+
+    chip8_trace(const chip8_trace &) = delete;
+    chip8_trace &operator=(const chip8_trace &) = delete;
+
+    std::vector<chip8_trace_entry> entries;
+    uint64_t mask;
+    std::atomic<uint64_t> count;            // Entries published so far
+};
+
+#endif // TRACE_H
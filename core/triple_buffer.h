@@ -0,0 +1,57 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+/*
+ * Lock-free triple buffer for one producer and one consumer.
+ * The producer fills writeBuffer() and calls publish(); the consumer calls
+ * consume() and, if it returns true, reads the newest value in readBuffer().
+ * Neither side ever waits, intermediate values are simply dropped.
+ */
+template <typename T>
+class chip8_triple_buffer
+{
+public:
+    chip8_triple_buffer() : writeIndex(0), middle(1), readIndex(2)
+    {
+    }
+
+    // Producer side
+    T &writeBuffer()
+    {
+        return slots[writeIndex];
+    }
+
+    void publish()
+    {
+        unsigned previous = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX;
+    }
+
+    // Consumer side
+    bool consume()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        unsigned previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX;
+        return true;
+    }
+
+    const T &readBuffer() const
+    {
+        return slots[readIndex];
+    }
+
+private:
+    enum { INDEX = 0x3, FRESH = 0x4 };
+
+    T slots[3];
+    unsigned writeIndex;                            // Owned by the producer
+    alignas(64) std::atomic<unsigned> middle;       // Shared: index | FRESH
+    alignas(64) unsigned readIndex;                 // Owned by the consumer
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,411 @@
+#include "video.h"
+#include <chrono>
+#include <cstring>
+
+#define FRAME_BYTES     (CHIP8_VIDEO_FRAME_WORDS * sizeof(uint64_t))
+#define MAX_DELTA       (4 * FRAME_BYTES)  // Generous bound on one encoded picture
+#define LITERAL_GAP     3                   // Equal bytes a literal run absorbs rather than split
+
+#define RECORD_HEAD     32                  // Type, flags and varints ahead of the delta
+
+// Writes v at out, returns the bytes used (at most 10)
+static size_t putVarint(unsigned char *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (unsigned char) v;
+    return n;
+}
+
+static bool getVarint(FILE *fp, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int c = fgetc(fp);
+        if (c == EOF) {
+            return false;
+        }
+        v |= (uint64_t) (c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool getVarint(const unsigned char *&in, const unsigned char *end, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7)
+    {
+        unsigned char c = *in++;
+        v |= (uint64_t) (c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+chip8_video_writer::chip8_video_writer() :
+    fp(NULL), last(new chip8_video_frame), held(0),
+    frameCount(0), pictureCount(0), stallCount(0),
+    sleeping(false), written(0), failed(false)
+{
+    memset(&header, 0, sizeof(header));
+    memset(last.get(), 0, sizeof(chip8_video_frame));
+    memset(previous, 0, sizeof(previous));
+    scratch.resize(RECORD_HEAD + MAX_DELTA);
+}
+
+chip8_video_writer::~chip8_video_writer()
+{
+    close();
+}
+
+bool chip8_video_writer::open(const char *filename, uint64_t romHash)
+{
+    close();
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1 << 16);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHIP8_VIDEO_MAGIC, 4);
+    header.version = CHIP8_VIDEO_VERSION;
+    header.byteOrder = CHIP8_VIDEO_BYTE_ORDER;
+    header.frameWords = CHIP8_VIDEO_FRAME_WORDS;
+    header.romHash = romHash;
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        fp = NULL;
+        return false;
+    }
+
+    held = 0;
+    frameCount = 0;
+    pictureCount = 0;
+    stallCount = 0;
+    memset(previous, 0, sizeof(previous));
+    written.store(sizeof(header));
+    failed.store(false);
+
+    writer = std::thread(&chip8_video_writer::run, this);
+    return true;
+}
+
+// Called at the end of every frame; only changed pictures go to the writer
+void chip8_video_writer::writeFrame(const chip8 &emu)
+{
+    if (fp == NULL) {
+        return;
+    }
+
+    const uint64_t *fb = emu.getFramebuffer();
+    uint8_t flags = emu.isHires() ? CHIP8_VIDEO_HIRES : 0;
+    if (frameCount++ != 0 && flags == last->flags && memcmp(fb, last->rows, sizeof(last->rows)) == 0) {
+        ++held;
+        return;
+    }
+
+    memcpy(last->rows, fb, sizeof(last->rows));
+    last->flags = flags;
+    last->held = held;
+    last->end = 0;
+    push(*last);
+
+    held = 1;
+    ++pictureCount;
+}
+
+bool chip8_video_writer::close()
+{
+    if (fp == NULL) {
+        return false;
+    }
+
+    last->held = held;
+    last->end = 1;
+    push(*last);
+    writer.join();
+
+    // A pipe cannot seek back and keeps frames == 0
+    bool ok = !failed.load();
+    header.frames = frameCount;
+    if (fseek(fp, 0, SEEK_SET) == 0) {
+        ok = (fwrite(&header, sizeof(header), 1, fp) == 1) && ok;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    fp = NULL;
+
+    return ok;
+}
+
+bool chip8_video_writer::isOpen() const
+{
+    return fp != NULL;
+}
+
+uint64_t chip8_video_writer::frames() const
+{
+    return frameCount;
+}
+
+uint64_t chip8_video_writer::pictures() const
+{
+    return pictureCount;
+}
+
+uint64_t chip8_video_writer::stalls() const
+{
+    return stallCount;
+}
+
+uint64_t chip8_video_writer::bytes() const
+{
+    return written.load();
+}
+
+// Waits for room only if the writer is a whole queue behind
+void chip8_video_writer::push(const chip8_video_frame &frame)
+{
+    if (!queue.push(frame)) {
+        ++stallCount;
+        while (!queue.push(frame))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // The writer checks back every millisecond anyway; only hurry it when the queue fills up
+    if (sleeping.load() && queue.size() >= CHIP8_VIDEO_QUEUE / 2) {
+        std::lock_guard<std::mutex> guard(wakeLock);
+        wake.notify_one();
+    }
+}
+
+// Writer thread: encodes pictures until the end item
+void chip8_video_writer::run()
+{
+    chip8_video_frame frame;
+    for (;;)
+    {
+        // The timeout covers a push that lands between the check and the wait
+        if (!queue.pop(frame)) {
+            std::unique_lock<std::mutex> guard(wakeLock);
+            sleeping.store(true);
+            wake.wait_for(guard, std::chrono::milliseconds(1), [this] { return !queue.empty(); });
+            sleeping.store(false);
+            continue;
+        }
+
+        // After a write error the queue is still drained so the emulator never blocks
+        if (!failed.load(std::memory_order_relaxed) && !encode(frame)) {
+            failed.store(true);
+        }
+        if (frame.end) {
+            break;
+        }
+    }
+}
+
+// Writes one record for frame, see chip8_video_header
+bool chip8_video_writer::encode(const chip8_video_frame &frame)
+{
+    unsigned char head[RECORD_HEAD];
+    size_t headLength = 0;
+    head[headLength++] = frame.end ? CHIP8_VIDEO_END : CHIP8_VIDEO_PICTURE;
+    headLength += putVarint(head + headLength, frame.held);
+    if (frame.end) {
+        written += headLength;
+        return fwrite(head, 1, headLength, fp) == headLength;
+    }
+    head[headLength++] = frame.flags;
+
+    // Runs go into scratch after room for the head, so the record is one write
+    unsigned char *delta = &scratch[RECORD_HEAD];
+    size_t length = 0;
+    const unsigned char *cur = (const unsigned char *) frame.rows;
+    const unsigned char *base = (const unsigned char *) previous;
+    size_t i = 0;
+    while (i < FRAME_BYTES)
+    {
+        size_t zeroStart = i;
+        while (i < FRAME_BYTES && (i & 7) != 0 && cur[i] == base[i])
+        {
+            ++i;
+        }
+        while (i + 8 <= FRAME_BYTES && (i & 7) == 0 && memcmp(cur + i, base + i, 8) == 0)
+        {
+            i += 8;
+        }
+        while (i < FRAME_BYTES && cur[i] == base[i])
+        {
+            ++i;
+        }
+        if (i == FRAME_BYTES) {
+            break;
+        }
+
+        // A literal run carries on over short stretches of equal bytes
+        size_t literalStart = i;
+        while (i < FRAME_BYTES)
+        {
+            if (cur[i] != base[i]) {
+                ++i;
+                continue;
+            }
+            size_t j = i;
+            while (j < FRAME_BYTES && j < i + LITERAL_GAP && cur[j] == base[j])
+            {
+                ++j;
+            }
+            if (j == FRAME_BYTES || j == i + LITERAL_GAP) {
+                break;
+            }
+            i = j;
+        }
+
+        length += putVarint(delta + length, literalStart - zeroStart);
+        length += putVarint(delta + length, i - literalStart);
+        for (size_t k = literalStart; k < i; ++k)
+        {
+            delta[length++] = cur[k] ^ base[k];
+        }
+    }
+    memcpy(previous, frame.rows, sizeof(previous));
+
+    headLength += putVarint(head + headLength, length);
+    unsigned char *record = delta - headLength;
+    memcpy(record, head, headLength);
+    length += headLength;
+
+    written += length;
+    return fwrite(record, 1, length, fp) == length;
+}
+
+chip8_video_reader::chip8_video_reader() :
+    fp(NULL), piped(false), nextHires(false), nextHeld(0), pending(false)
+{
+    memset(&header, 0, sizeof(header));
+    memset(next, 0, sizeof(next));
+}
+
+chip8_video_reader::~chip8_video_reader()
+{
+    close();
+}
+
+bool chip8_video_reader::open(const char *filename)
+{
+    close();
+
+    piped = strcmp(filename, "-") == 0;
+    fp = piped ? stdin : fopen(filename, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    memset(next, 0, sizeof(next));
+    pending = false;
+    if (fread(&header, sizeof(header), 1, fp) != 1
+            || memcmp(header.magic, CHIP8_VIDEO_MAGIC, 4) != 0
+            || header.version != CHIP8_VIDEO_VERSION
+            || header.byteOrder != CHIP8_VIDEO_BYTE_ORDER
+            || header.frameWords != CHIP8_VIDEO_FRAME_WORDS
+            || !readRecord()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void chip8_video_reader::close()
+{
+    if (fp != NULL && !piped) {
+        fclose(fp);
+    }
+    fp = NULL;
+    pending = false;
+}
+
+const chip8_video_header &chip8_video_reader::getHeader() const
+{
+    return header;
+}
+
+bool chip8_video_reader::readPicture(uint64_t rows[CHIP8_VIDEO_FRAME_WORDS], bool &hires, uint32_t &frames)
+{
+    if (fp == NULL || !pending) {
+        return false;
+    }
+
+    memcpy(rows, next, sizeof(next));
+    hires = nextHires;
+    if (!readRecord()) {
+        pending = false;
+        return false;
+    }
+
+    frames = nextHeld;
+    return true;
+}
+
+// Reads the next record, decoding a picture into next on top of the previous one
+bool chip8_video_reader::readRecord()
+{
+    int type = fgetc(fp);
+    uint64_t held;
+    if (type == EOF || !getVarint(fp, held) || held > UINT32_MAX) {
+        return false;
+    }
+    nextHeld = (uint32_t) held;
+
+    if (type == CHIP8_VIDEO_END) {
+        pending = false;
+        return true;
+    }
+
+    int flags = fgetc(fp);
+    uint64_t length;
+    if (type != CHIP8_VIDEO_PICTURE || flags == EOF || !getVarint(fp, length) || length > MAX_DELTA) {
+        return false;
+    }
+    scratch.resize((size_t) length);
+    if (length != 0 && fread(&scratch[0], 1, (size_t) length, fp) != length) {
+        return false;
+    }
+
+    unsigned char *dst = (unsigned char *) next;
+    const unsigned char *in = scratch.empty() ? NULL : &scratch[0];
+    const unsigned char *end = in + length;
+    size_t pos = 0;
+    while (in < end)
+    {
+        uint64_t zeros, literals;
+        if (!getVarint(in, end, zeros) || !getVarint(in, end, literals)
+                || zeros > FRAME_BYTES - pos || literals > FRAME_BYTES - pos - zeros
+                || literals > (uint64_t) (end - in)) {
+            return false;
+        }
+        pos += (size_t) zeros;
+        for (uint64_t k = 0; k < literals; ++k)
+        {
+            dst[pos++] ^= *in++;
+        }
+    }
+
+    nextHires = (flags & CHIP8_VIDEO_HIRES) != 0;
+    pending = true;
+    return true;
+}
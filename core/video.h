@@ -0,0 +1,153 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chip8.h"
+#include "spsc_queue.h"
+
+#define CHIP8_VIDEO_MAGIC       "C8VD"
+#define CHIP8_VIDEO_VERSION     1
+#define CHIP8_VIDEO_BYTE_ORDER  0x0102
+#define CHIP8_VIDEO_QUEUE       64      // Frames in flight to the writer thread, a power of two
+
+#define CHIP8_VIDEO_FRAME_WORDS (CHIP8_PLANES * CHIP8_FB_PLANE_WORDS)
+
+// Record types
+#define CHIP8_VIDEO_PICTURE     0
+#define CHIP8_VIDEO_END         1
+
+#define CHIP8_VIDEO_HIRES       1       // Picture flag: 128x64
+
+/*
+ * Framebuffer video: this header, then one record per distinct picture.
+ * Numbers in records are LEB128 varints.
+ *   PICTURE: type, held, flags, length, length bytes of delta
+ *   END:     type, held
+ * held is how many frames the previous picture stayed on screen (0 before
+ * the first picture), so runs of identical frames cost a few bytes. The
+ * delta codes the framebuffer words, in host byte order, XOR the previous
+ * picture (all zero before the first) as { zero bytes, literal bytes,
+ * literals... } runs; trailing zeros need no run.
+ * frames is filled in when the recording is closed on a seekable file;
+ * streams written to a pipe have frames == 0. Either way they are read to
+ * their END record.
+ */
+struct chip8_video_header
+{
+    char magic[4];              // CHIP8_VIDEO_MAGIC, not NUL terminated
+    uint16_t version;           // CHIP8_VIDEO_VERSION
+    uint16_t byteOrder;         // CHIP8_VIDEO_BYTE_ORDER as written by the host
+    uint32_t frameWords;        // CHIP8_VIDEO_FRAME_WORDS
+    uint32_t reserved;
+    uint64_t romHash;           // chip8_rom_hash() of the ROM image
+    uint64_t frames;
+};
+
+static_assert(sizeof(chip8_video_header) == 32, "chip8_video_header must stay 32 bytes");
+
+// A frame handed from the emulator to the writer thread
+struct chip8_video_frame
+{
+    uint64_t rows[CHIP8_VIDEO_FRAME_WORDS];
+    uint32_t held;              // Frames the previous picture was shown
+    uint8_t flags;              // CHIP8_VIDEO_HIRES
+    uint8_t end;                // Last item of the recording, rows unused
+};
+
+/*
+ * Records the framebuffer at the end of every frame.
+ *
+ * writeFrame() only compares the framebuffer with the last picture sent and,
+ * if it changed, copies it into a single-producer/single-consumer queue; a
+ * repeated frame just bumps a counter. A writer thread encodes the queued
+ * pictures and writes them through a buffered FILE, so the emulator never
+ * waits on I/O. It only waits if the writer falls CHIP8_VIDEO_QUEUE pictures
+ * behind, which stalls() counts.
+ */
+class chip8_video_writer
+{
+public:
+    chip8_video_writer();
+    ~chip8_video_writer();
+
+    bool open(const char *filename, uint64_t romHash);  // A file or a named pipe
+    void writeFrame(const chip8 &emu);
+    bool close();               // Waits for the writer, then completes the header if it can
+    bool isOpen() const;
+
+    uint64_t frames() const;
+    uint64_t pictures() const;  // Frames that differed from the one before
+    uint64_t stalls() const;
+    uint64_t bytes() const;     // Written so far, exact after close()
+
+private:
+    chip8_video_writer(const chip8_video_writer &) = delete;
+    chip8_video_writer &operator=(const chip8_video_writer &) = delete;
+
+    void push(const chip8_video_frame &frame);
+    void run();
+    bool encode(const chip8_video_frame &frame);
+
+    FILE *fp;
+    chip8_video_header header;
+
+    // Emulator side
+    std::unique_ptr<chip8_video_frame> last;
+    uint32_t held;
+    uint64_t frameCount;
+    uint64_t pictureCount;
+    uint64_t stallCount;
+
+    // Writer side, woken by push() if it sleeps while the queue fills
+    chip8_spsc_queue<chip8_video_frame, CHIP8_VIDEO_QUEUE> queue;
+    std::thread writer;
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::atomic<bool> sleeping;
+    uint64_t previous[CHIP8_VIDEO_FRAME_WORDS];
+    std::vector<unsigned char> scratch;
+    std::atomic<uint64_t> written;
+    std::atomic<bool> failed;
+};
+
+class chip8_video_reader
+{
+public:
+    chip8_video_reader();
+    ~chip8_video_reader();
+
+    bool open(const char *filename);    // "-" reads from stdin
+    void close();
+    const chip8_video_header &getHeader() const;
+
+    // The next picture and how many frames it is shown for; false at the end or on a damaged stream
+    bool readPicture(uint64_t rows[CHIP8_VIDEO_FRAME_WORDS], bool &hires, uint32_t &frames);
+
+private:
+    chip8_video_reader(const chip8_video_reader &) = delete;
+    chip8_video_reader &operator=(const chip8_video_reader &) = delete;
+
+    bool readRecord();
+
+    FILE *fp;
+    bool piped;
+    chip8_video_header header;
+
+    // Pictures are decoded one record ahead, since how long one is shown is in the next record
+    uint64_t next[CHIP8_VIDEO_FRAME_WORDS];
+    bool nextHires;
+    uint32_t nextHeld;
+    bool pending;               // next holds a picture not returned yet
+    std::vector<unsigned char> scratch;
+};
+
+#endif // VIDEO_H
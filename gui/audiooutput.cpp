@@ -0,0 +1,109 @@
+#include "audiooutput.h"
+
+#include <QAudioDeviceInfo>
+#include <QAudioFormat>
+#include <QAudioOutput>
+#include <QSysInfo>
+#include <cstring>
+
+AudioStream::AudioStream(AudioQueue *queue, QObject *parent) : QIODevice(parent),
+    queue(queue)
+{
+}
+
+bool AudioStream::isSequential() const
+{
+    return true;
+}
+
+// Always fills the request, with silence past what the emulator has produced
+qint64 AudioStream::readData(char *data, qint64 maxlen)
+{
+    qint64 count = maxlen / (qint64) sizeof(int16_t);
+    qint64 i = 0;
+    int16_t sample;
+    while (i < count && queue->pop(sample))
+    {
+        memcpy(data + i * sizeof(int16_t), &sample, sizeof(int16_t));
+        ++i;
+    }
+    memset(data + i * sizeof(int16_t), 0, (size_t) (count - i) * sizeof(int16_t));
+
+    return count * (qint64) sizeof(int16_t);
+}
+
+qint64 AudioStream::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+AudioOutput::AudioOutput() : stream(&queue), output(NULL), queueLimit(0), deviceSamples(0)
+{
+}
+
+AudioOutput::~AudioOutput()
+{
+    stop();
+}
+
+bool AudioOutput::start(unsigned rate)
+{
+    stop();
+
+    QAudioFormat format;
+    format.setSampleRate((int) rate);
+    format.setChannelCount(1);
+    format.setSampleSize(16);
+    format.setCodec("audio/pcm");
+    format.setByteOrder(QSysInfo::ByteOrder == QSysInfo::LittleEndian ? QAudioFormat::LittleEndian
+                                                                       : QAudioFormat::BigEndian);
+    format.setSampleType(QAudioFormat::SignedInt);
+
+    QAudioDeviceInfo device = QAudioDeviceInfo::defaultOutputDevice();
+    if (device.isNull() || !device.isFormatSupported(format)) {
+        return false;
+    }
+
+    output = new QAudioOutput(device, format);
+    output->setBufferSize((int) (rate / 120 * sizeof(int16_t)));
+    stream.open(QIODevice::ReadOnly);
+    output->start(&stream);
+    if (output->error() != QAudio::NoError) {
+        stop();
+        return false;
+    }
+
+    // The device may round the buffer up; measure against what it really holds
+    deviceSamples = (unsigned) (output->bufferSize() / (int) sizeof(int16_t));
+    queueLimit = rate / 40;
+    return true;
+}
+
+void AudioOutput::stop()
+{
+    if (output != NULL) {
+        output->stop();
+        delete output;
+        output = NULL;
+    }
+    stream.close();
+}
+
+size_t AudioOutput::write(const int16_t *samples, size_t count)
+{
+    unsigned held = queue.size();
+    size_t room = (held < queueLimit) ? queueLimit - held : 0;
+
+    size_t n = 0;
+    while (n < count && n < room && queue.push(samples[n]))
+    {
+        ++n;
+    }
+    return n;
+}
+
+// Upper bound: assumes the device buffer is full
+size_t AudioOutput::queued() const
+{
+    return queue.size() + deviceSamples;
+}
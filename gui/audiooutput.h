@@ -0,0 +1,64 @@
+#ifndef AUDIOOUTPUT_H
+#define AUDIOOUTPUT_H
+
+#include <QIODevice>
+#include <stdint.h>
+
+#include "audio.h"
+#include "spsc_queue.h"
+
+class QAudioOutput;
+
+#define AUDIO_QUEUE_SIZE    4096        // Samples, about 85 ms at 48 kHz
+
+typedef chip8_spsc_queue<int16_t, AUDIO_QUEUE_SIZE> AudioQueue;
+
+// The device end of the queue: QAudioOutput pulls samples from here
+class AudioStream : public QIODevice
+{
+public:
+    explicit AudioStream(AudioQueue *queue, QObject *parent = 0);
+
+    bool isSequential() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen);
+    qint64 writeData(const char *data, qint64 len);
+
+private:
+    AudioQueue *queue;
+};
+
+/*
+ * Plays the synthesized frames through QAudioOutput in pull mode.
+ * The emulator thread pushes each frame into a lock-free queue and the
+ * device pulls from it, getting silence whenever it runs dry, so neither
+ * side waits for the other. The device buffer is kept to half a frame and
+ * the queue to a frame and a half, which bounds the latency from FX18 to
+ * the speaker; samples beyond that are dropped instead of piling up.
+ */
+class AudioOutput : public chip8_audio_sink
+{
+public:
+    AudioOutput();
+    ~AudioOutput();
+
+    bool start(unsigned rate);          // False if there is no device that plays 16-bit mono
+    void stop();
+
+    // Emulator thread
+    size_t write(const int16_t *samples, size_t count);
+    size_t queued() const;
+
+private:
+    AudioOutput(const AudioOutput &) = delete;
+    AudioOutput &operator=(const AudioOutput &) = delete;
+
+    AudioQueue queue;
+    AudioStream stream;
+    QAudioOutput *output;
+    unsigned queueLimit;                // Samples the queue may hold after a write
+    unsigned deviceSamples;             // Device buffer, fixed once started
+};
+
+#endif // AUDIOOUTPUT_H
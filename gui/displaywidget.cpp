@@ -0,0 +1,113 @@
+#include "displaywidget.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <cstring>
+
+#include "chip8.h"
+
+// Pixel bytes for a byte of one plane: bit 7 first, each byte 0 or 1
+static unsigned char spread[256][8];
+
+DisplayWidget::DisplayWidget(QWidget *parent) : QWidget(parent),
+    image(64, 32, QImage::Format_Indexed8)
+{
+    for (int b = 0; b < 256; ++b)
+    {
+        for (int k = 0; k < 8; ++k)
+        {
+            spread[b][k] = (b >> (7 - k)) & 1;
+        }
+    }
+
+    // Index is plane 0 | plane 1 << 1; plain CHIP-8 only uses the first two
+    image.setColorCount(4);
+    image.setColor(0, qRgb(0, 0, 0));
+    image.setColor(1, qRgb(255, 255, 255));
+    image.setColor(2, qRgb(255, 102, 0));
+    image.setColor(3, qRgb(255, 204, 0));
+    image.fill(0);
+
+    // Every pixel is painted by paintEvent()
+    this->setAttribute(Qt::WA_OpaquePaintEvent);
+    this->setMinimumSize(64, 32);
+}
+
+void DisplayWidget::updateRows(const uint64_t *planes, bool hires, uint64_t dirty)
+{
+    int width = hires ? 128 : 64;
+    int height = hires ? 64 : 32;
+    if (image.width() != width) {
+        QImage resized(width, height, QImage::Format_Indexed8);
+        resized.setColorTable(image.colorTable());
+        image = resized;
+        dirty = ~0ULL;
+    }
+
+    if (dirty == 0) {
+        return;
+    }
+
+    int first = -1;
+    int last = -1;
+
+    for (int y = 0; y < height; ++y)
+    {
+        if ((dirty & (1ULL << y)) == 0) {
+            continue;
+        }
+
+        // Eight pixels at a time: both planes' bits spread to bytes and merged
+        uchar *line = image.scanLine(y);
+        const uint64_t *row0 = planes + y * CHIP8_FB_ROW_WORDS;
+        const uint64_t *row1 = row0 + CHIP8_FB_PLANE_WORDS;
+        for (int b = 0; b < width / 8; ++b)
+        {
+            int shift = 56 - 8 * (b & 7);
+            uint64_t p0, p1;
+            memcpy(&p0, spread[(row0[b >> 3] >> shift) & 0xFF], 8);
+            memcpy(&p1, spread[(row1[b >> 3] >> shift) & 0xFF], 8);
+            p0 |= p1 << 1;
+            memcpy(line + 8 * b, &p0, 8);
+        }
+
+        if (first < 0) {
+            first = y;
+        }
+        last = y;
+    }
+
+    this->update(rowsRect(first, last));
+}
+
+void DisplayWidget::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    QRect target = targetRect();
+
+    // Letterbox around the scaled image
+    QRegion border = QRegion(event->rect()) - QRegion(target);
+    for (const QRect &r : border.rects())
+    {
+        painter.fillRect(r, Qt::black);
+    }
+
+    painter.drawImage(target, image);
+}
+
+// Largest 2:1 rectangle centered in the widget, in whole pixels per cell
+QRect DisplayWidget::targetRect() const
+{
+    int scale = qMax(1, qMin(this->width() / image.width(), this->height() / image.height()));
+    int w = image.width() * scale;
+    int h = image.height() * scale;
+    return QRect((this->width() - w) / 2, (this->height() - h) / 2, w, h);
+}
+
+QRect DisplayWidget::rowsRect(int first, int last) const
+{
+    QRect target = targetRect();
+    int scale = target.height() / image.height();
+    return QRect(target.left(), target.top() + first * scale,
+                 target.width(), (last - first + 1) * scale);
+}
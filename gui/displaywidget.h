@@ -0,0 +1,30 @@
+#ifndef DISPLAYWIDGET_H
+#define DISPLAYWIDGET_H
+
+#include <QWidget>
+#include <QImage>
+#include <stdint.h>
+
+// Shows the chip8 framebuffer as a scaled image, one color per combination of planes
+class DisplayWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    DisplayWidget(QWidget *parent = 0);
+
+    // Copies the given rows (bit n = row n) from a packed framebuffer and repaints them.
+    // A change between 64x32 and 128x64 repaints everything.
+    void updateRows(const uint64_t *planes, bool hires, uint64_t dirty);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private:
+    QRect targetRect() const;
+    QRect rowsRect(int first, int last) const;
+
+    QImage image;
+};
+
+#endif // DISPLAYWIDGET_H
@@ -0,0 +1,265 @@
+#include "emulatorthread.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+EmulatorThread::EmulatorThread(chip8 *emu, QObject *parent) : QThread(parent),
+    emu(emu), running(false), frameNumber(0), rewinding(false), movie(NULL), shared(NULL),
+    paused(false), midFrame(false), runUntil(0)
+{
+    memset(key, 0, sizeof(char) * 16);
+    trace.dumpOnCrash("chip8-crash.c8t");
+    emu->setDebugger(&debugger);
+}
+
+EmulatorThread::~EmulatorThread()
+{
+    stop();
+}
+
+void EmulatorThread::startEmulation()
+{
+    running.store(true);
+    this->start(QThread::TimeCriticalPriority);
+}
+
+void EmulatorThread::stop()
+{
+    running.store(false);
+    this->wait();
+}
+
+void EmulatorThread::clearHistory()
+{
+    history.clear();
+    midFrame = false;
+}
+
+void EmulatorThread::setMovie(chip8_movie_writer *movie)
+{
+    this->movie = movie;
+}
+
+void EmulatorThread::setAudioSink(chip8_audio_sink *sink)
+{
+    audio.setSink(sink);
+}
+
+void EmulatorThread::setSharedMemory(chip8_shm *shm)
+{
+    shared = shm;
+}
+
+bool EmulatorThread::pushEvent(const EmulatorEvent &event)
+{
+    return events.push(event);
+}
+
+bool EmulatorThread::dumpTrace(const char *filename) const
+{
+    return trace.dump(filename);
+}
+
+const EmulatorFrame *EmulatorThread::takeFrame()
+{
+    if (!frames.consume()) {
+        return NULL;
+    }
+    return &frames.readBuffer();
+}
+
+void EmulatorThread::run()
+{
+    typedef std::chrono::steady_clock clock;
+    const clock::duration period = std::chrono::nanoseconds(1000000000 / 60);
+
+    frameNumber = 0;
+    memset(key, 0, sizeof(char) * 16);
+    rewinding = false;
+    runUntil = 0;
+    audio.reset();
+
+    clock::time_point next = clock::now();
+    while (running.load(std::memory_order_relaxed))
+    {
+        EmulatorEvent event;
+        while (events.pop(event))
+        {
+            applyEvent(event);
+        }
+
+        // Rewinding replays recorded states newest first at the normal frame rate
+        chip8_state state;
+        if (rewinding) {
+            if (history.pop(state) && emu->loadState(state)) {
+                midFrame = false;
+            }
+            audio.renderSilence();
+            ++frameNumber;
+        } else if (paused) {
+            audio.renderSilence();
+        } else {
+            // The rest of a frame the debugger stopped keeps the keys it started with
+            if (!midFrame) {
+                unsigned char pressed[16];
+                unsigned agentKeys = (shared != NULL) ? shared->keys(0) : 0;
+                for (int k = 0; k < 16; ++k)
+                {
+                    pressed[k] = key[k] | ((agentKeys >> k) & 1);
+                }
+
+                if (movie != NULL) {
+                    movie->writeFrame(pressed);
+                }
+                emu->setKeys(pressed);
+            }
+            audio.beginFrame();
+            chip8_frame result = emu->runFrame();
+            midFrame = result.stopped;
+            if (result.stopped) {
+                paused = true;
+                audio.renderSilence();
+            } else {
+                audio.renderFrame(*emu, result);
+                emu->saveState(state);
+                history.record(state);
+                ++frameNumber;
+                if (frameNumber == runUntil) {
+                    paused = true;
+                    runUntil = 0;
+                }
+            }
+        }
+        publishFrame();
+
+        // Fixed 60 Hz schedule; after a long stall resync instead of catching up in a burst
+        next += period;
+        clock::time_point now = clock::now();
+        if (now > next + 4 * period) {
+            next = now;
+        } else {
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+void EmulatorThread::applyEvent(const EmulatorEvent &event)
+{
+    switch (event.type)
+    {
+    case EmulatorEvent::KEY_DOWN:
+        key[event.value & 0xF] = 1;
+        break;
+    case EmulatorEvent::KEY_UP:
+        key[event.value & 0xF] = 0;
+        break;
+    case EmulatorEvent::REWIND_START:
+        // A movie only holds inputs, so it cannot go back in time
+        rewinding = (movie == NULL);
+        break;
+    case EmulatorEvent::REWIND_STOP:
+        rewinding = false;
+        break;
+    case EmulatorEvent::PROFILE:
+        emu->setProfiling(event.value != 0);
+        break;
+    case EmulatorEvent::TRACE:
+        // Safe here: this thread is the only writer
+        if (event.value != 0) {
+            trace.clear();
+        }
+        emu->setTrace(event.value != 0 ? &trace : NULL);
+        break;
+    case EmulatorEvent::BREAKPOINT:
+        debugger.setBreakpoint(event.address, event.value != 0);
+        break;
+    case EmulatorEvent::CLEAR_BREAKPOINTS:
+        debugger.clearBreakpoints();
+        break;
+    case EmulatorEvent::WATCH_MEMORY:
+        debugger.watchMemory(event.address, event.length);
+        break;
+    case EmulatorEvent::WATCH_REGISTER:
+        debugger.watchRegister(event.value, event.length != 0 ? event.address : CHIP8_DEBUG_ANY_VALUE);
+        break;
+    case EmulatorEvent::CLEAR_WATCHES:
+        debugger.clearMemoryWatches();
+        debugger.clearRegisterWatches();
+        break;
+    case EmulatorEvent::PAUSE:
+        paused = true;
+        runUntil = 0;
+        break;
+    case EmulatorEvent::CONTINUE:
+        debugger.resume();
+        paused = false;
+        runUntil = 0;
+        break;
+    case EmulatorEvent::STEP:
+    case EmulatorEvent::STEP_OVER:
+        if (paused && !rewinding) {
+            if (event.type == EmulatorEvent::STEP) {
+                debugger.step();
+            } else {
+                debugger.stepOver(*emu);
+            }
+            paused = false;
+            runUntil = 0;
+        }
+        break;
+    case EmulatorEvent::RUN_FRAMES:
+        if (event.address != 0) {
+            debugger.resume();
+            paused = false;
+            runUntil = frameNumber + event.address;
+        }
+        break;
+    }
+}
+
+void EmulatorThread::publishFrame()
+{
+    EmulatorFrame &frame = frames.writeBuffer();
+    memcpy(frame.rows, emu->getFramebuffer(), sizeof(frame.rows));
+    frame.hires = emu->isHires();
+    frame.number = frameNumber;
+    frame.pc = emu->getPC();
+    frame.audio = audio.getStats();
+    frame.rewinding = rewinding;
+    frame.history = (unsigned) history.size();
+
+    const chip8_profile *profile = emu->getProfile();
+    frame.profiling = (profile != NULL);
+    if (profile != NULL) {
+        frame.profile = *profile;
+    }
+
+    frame.paused = paused;
+    frame.stopReason = (unsigned char) debugger.getReason();
+    frame.stopAddress = (debugger.getReason() == chip8_debugger::STOP_REGISTER) ? (unsigned short) debugger.getStopRegister()
+                                                                              : debugger.getStopAddress();
+    memcpy(frame.V, emu->getRegisters(), sizeof(frame.V));
+    frame.I = emu->getI();
+    frame.sp = emu->getSP();
+    memcpy(frame.stack, emu->getStack(), sizeof(frame.stack));
+    frame.delayTimer = emu->getDelayTimer();
+    frame.soundTimer = emu->getSoundTimer();
+
+    // Programs run from the first 4K, so the listing wraps there like PC does
+    frame.listingStart = (unsigned short) ((frame.pc - 16) & 0x0FFF);
+    frame.listingBreakpoints = 0;
+    for (int i = 0; i < EMULATOR_LISTING_BYTES; ++i)
+    {
+        unsigned short addr = (frame.listingStart + i) & 0x0FFF;
+        frame.listing[i] = emu->getMemory()[addr];
+        if (debugger.hasBreakpoint(addr)) {
+            frame.listingBreakpoints |= 1ULL << i;
+        }
+    }
+    frames.publish();
+
+    if (shared != NULL) {
+        shared->publish(0, *emu, frameNumber);
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef EMULATORTHREAD_H
+#define EMULATORTHREAD_H
+
+#include <QThread>
+#include <atomic>
+#include <stdint.h>
+
+#include "audio.h"
+#include "chip8.h"
+#include "debugger.h"
+#include "movie.h"
+#include "rewind.h"
+#include "shm.h"
+#include "spsc_queue.h"
+#include "trace.h"
+#include "triple_buffer.h"
+
+#define EMULATOR_LISTING_BYTES  48      // Memory around PC published for the disassembly
+
+// A finished frame as published by the emulator thread
+struct EmulatorFrame
+{
+    uint64_t rows[CHIP8_PLANES * CHIP8_FB_PLANE_WORDS];    // Packed framebuffer, see chip8::getFramebuffer()
+    bool hires;                 // 128x64 rather than 64x32
+    unsigned long long number;  // Frames run since start()
+    unsigned short pc;
+    chip8_audio_stats audio;    // Tone latency and dropped samples since start()
+    bool rewinding;
+    unsigned history;           // Frames that can be rewound
+
+    // Profiler summary, only filled in while profiling
+    bool profiling;
+    chip8_profile profile;
+
+    // Debugger view
+    bool paused;
+    unsigned char stopReason;   // chip8_debugger::Reason of the last stop
+    unsigned short stopAddress; // Watched byte written, or watched register, for that stop
+    unsigned char V[16];
+    unsigned short I;
+    unsigned short sp;
+    unsigned short stack[16];
+    unsigned char delayTimer;
+    unsigned char soundTimer;
+    unsigned short listingStart;                    // A few instructions before PC
+    unsigned char listing[EMULATOR_LISTING_BYTES];
+    uint64_t listingBreakpoints;                    // Bit n: breakpoint at listingStart + n
+};
+
+// Input sent from the UI thread
+struct EmulatorEvent
+{
+    enum Type {
+        KEY_DOWN,
+        KEY_UP,
+        REWIND_START,           // Step back one recorded frame per frame until REWIND_STOP
+        REWIND_STOP,
+        PROFILE,                // value 1 starts counting from zero, 0 stops
+        TRACE,                  // value 1 starts a fresh trace, 0 stops
+        BREAKPOINT,             // At address, value 1 sets and 0 clears it
+        CLEAR_BREAKPOINTS,
+        WATCH_MEMORY,           // length bytes from address
+        WATCH_REGISTER,         // Register value (16 is I); stops at address if length is 1, on any change if 0
+        CLEAR_WATCHES,
+        PAUSE,
+        CONTINUE,
+        STEP,                   // One instruction, only while paused
+        STEP_OVER,              // One instruction, or a whole CALL, only while paused
+        RUN_FRAMES              // Run address frames, then pause
+    };
+
+    unsigned char type;
+    unsigned char value;        // Key index for KEY_DOWN/KEY_UP, on/off for PROFILE/TRACE/BREAKPOINT
+    unsigned short address;
+    unsigned short length;
+};
+
+/*
+ * Runs a chip8 at 60 frames per second on its own thread.
+ * Frames go out through a triple buffer and input comes in through a
+ * single-producer/single-consumer queue, so neither side ever blocks the
+ * other and UI stalls do not affect emulation pacing.
+ * The chip8 must only be touched by other threads while the thread is stopped.
+ *
+ * The thread owns the chip8's debugger. A breakpoint or watchpoint pauses
+ * it, possibly in the middle of a frame; it then keeps publishing the same
+ * machine every frame until CONTINUE, a step or RUN_FRAMES. The rest of a
+ * frame that was stopped part way runs with the keys it started with, and
+ * only a finished frame goes into the history and the movie.
+ */
+class EmulatorThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    EmulatorThread(chip8 *emu, QObject *parent = 0);
+    ~EmulatorThread();
+
+    void startEmulation();
+    void stop();
+    void clearHistory();                // Only while stopped, e.g. after loading a ROM or a state
+    void setMovie(chip8_movie_writer *movie);   // Only while stopped, NULL stops recording
+    void setAudioSink(chip8_audio_sink *sink);  // Only while stopped, NULL is silent
+    void setSharedMemory(chip8_shm *shm);       // Only while stopped, a CHIP8_SHM_FREE region or NULL
+
+    // UI thread side
+    bool pushEvent(const EmulatorEvent &event);
+    const EmulatorFrame *takeFrame();   // Newest frame, or NULL if nothing new
+    bool dumpTrace(const char *filename) const;     // Any time, even while running
+
+protected:
+    void run();
+
+private:
+    void applyEvent(const EmulatorEvent &event);
+    void publishFrame();
+
+    chip8 *emu;
+    std::atomic<bool> running;
+    unsigned long long frameNumber;
+    unsigned char key[16];
+
+    chip8_rewind history;               // Every frame is recorded unless rewinding
+    bool rewinding;
+
+    chip8_movie_writer *movie;          // Gets the keys of every frame run, or NULL
+    chip8_shm *shared;                  // Gets every frame, its agent's keys count as pressed; or NULL
+    chip8_trace trace;                  // Attached to emu while tracing, dumped on a crash
+    chip8_audio audio;                  // Renders every frame, silence while rewinding or paused
+
+    chip8_debugger debugger;            // Attached to emu for as long as the thread exists
+    bool paused;
+    bool midFrame;                      // The debugger stopped emu part way through a frame
+    unsigned long long runUntil;        // Frame number RUN_FRAMES pauses at, 0 for none
+
+    chip8_spsc_queue<EmulatorEvent, 256> events;
+    chip8_triple_buffer<EmulatorFrame> frames;
+};
+
+#endif // EMULATORTHREAD_H
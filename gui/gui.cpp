@@ -0,0 +1,872 @@
+#include "gui.h"
+#include "displaywidget.h"
+
+#include <QApplication>
+#include <QString>
+#include <QTimer>
+#include <QEvent>
+#include <QKeyEvent>
+
+#include <QMenuBar>
+#include <QMessageBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QInputDialog>
+#include <QDockWidget>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QPushButton>
+#include <QToolButton>
+
+#include "disasm.h"
+
+#include <cstring>
+#include <ctime>
+
+GUI::GUI(QWidget *parent) : QMainWindow(parent)
+{
+    this->setMinimumSize(640, 480);
+    this->setWindowTitle(tr("Chip8Emulator"));
+
+    this->createActions();
+    this->createMenus();
+
+    display = new DisplayWidget(this);
+
+    dockWidget = new QDockWidget(tr("Emulator state"), this);
+    infoView = new QTextBrowser(this);
+    infoView->setFontPointSize(10);
+    dockWidget->setWidget(infoView);
+
+    this->setCentralWidget(display);
+    this->addDockWidget(Qt::BottomDockWidgetArea, dockWidget);
+    this->createDebugger();
+
+    chip8_emu = new chip8();
+    emuThread = new EmulatorThread(chip8_emu, this);
+    memset(shownRows, 0, sizeof(shownRows));
+    shownHires = false;
+    if (audioOutput.start(CHIP8_AUDIO_RATE)) {
+        emuThread->setAudioSink(&audioOutput);
+    } else {
+        emuThread->setAudioSink(&noAudio);
+    }
+
+    // The emulator paces itself; this only picks up finished frames
+    timer = new QTimer(this);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, SIGNAL(timeout()), this, SLOT(refreshFrame()));
+}
+
+GUI::~GUI()
+{
+    timer->stop();
+    emuThread->stop();
+    finishMovie();
+    delete chip8_emu;
+}
+
+void GUI::createActions()
+{
+    openAct = new QAction(QIcon(":/images/open.png"), tr("&Open..."), this);
+    openAct->setShortcuts(QKeySequence::Open);
+    openAct->setStatusTip(tr("Open an existing file"));
+    connect(openAct, SIGNAL(triggered()), this, SLOT(open()));
+
+    openLibraryAct = new QAction(tr("Open &Library..."), this);
+    openLibraryAct->setStatusTip(tr("Open a ROM pack and list its ROMs"));
+    connect(openLibraryAct, SIGNAL(triggered()), this, SLOT(openLibrary()));
+
+    buildLibraryAct = new QAction(tr("&Build Library..."), this);
+    buildLibraryAct->setStatusTip(tr("Pack every ROM in a folder into one file"));
+    connect(buildLibraryAct, SIGNAL(triggered()), this, SLOT(buildLibrary()));
+
+    findRomAct = new QAction(tr("&Find ROM..."), this);
+    findRomAct->setShortcuts(QKeySequence::Find);
+    findRomAct->setStatusTip(tr("Switch to a ROM of the library by name or hash"));
+    connect(findRomAct, SIGNAL(triggered()), this, SLOT(findRom()));
+
+    saveStateAct = new QAction(tr("&Save State..."), this);
+    saveStateAct->setShortcuts(QKeySequence::Save);
+    saveStateAct->setStatusTip(tr("Save the machine state to a file"));
+    connect(saveStateAct, SIGNAL(triggered()), this, SLOT(saveState()));
+
+    loadStateAct = new QAction(tr("&Load State..."), this);
+    loadStateAct->setShortcut(QKeySequence(tr("Ctrl+L")));
+    loadStateAct->setStatusTip(tr("Resume from a saved machine state"));
+    connect(loadStateAct, SIGNAL(triggered()), this, SLOT(loadState()));
+
+    recordMovieAct = new QAction(tr("&Record Movie..."), this);
+    recordMovieAct->setStatusTip(tr("Restart the ROM and record every frame's input"));
+    connect(recordMovieAct, SIGNAL(triggered()), this, SLOT(recordMovie()));
+
+    stopMovieAct = new QAction(tr("S&top Recording"), this);
+    stopMovieAct->setStatusTip(tr("Finish the movie being recorded"));
+    stopMovieAct->setEnabled(false);
+    connect(stopMovieAct, SIGNAL(triggered()), this, SLOT(stopMovie()));
+
+    profileAct = new QAction(tr("&Profile"), this);
+    profileAct->setCheckable(true);
+    profileAct->setStatusTip(tr("Count instructions per opcode class and address"));
+    connect(profileAct, SIGNAL(toggled(bool)), this, SLOT(toggleProfiling(bool)));
+
+    traceAct = new QAction(tr("&Trace"), this);
+    traceAct->setCheckable(true);
+    traceAct->setStatusTip(tr("Record recent instructions, dumped to chip8-crash.c8t on a crash"));
+    connect(traceAct, SIGNAL(toggled(bool)), this, SLOT(toggleTracing(bool)));
+
+    dumpTraceAct = new QAction(tr("&Dump Trace..."), this);
+    dumpTraceAct->setStatusTip(tr("Write the recorded instructions to a file"));
+    connect(dumpTraceAct, SIGNAL(triggered()), this, SLOT(dumpTrace()));
+
+    shareAct = new QAction(tr("&Share Memory"), this);
+    shareAct->setCheckable(true);
+    shareAct->setStatusTip(tr("Publish every frame in shared memory " CHIP8_GUI_SHM_NAME " and take keys from agents"));
+    connect(shareAct, SIGNAL(toggled(bool)), this, SLOT(toggleSharing(bool)));
+
+    pauseAct = new QAction(tr("&Pause"), this);
+    pauseAct->setShortcut(QKeySequence(Qt::Key_F5));
+    pauseAct->setStatusTip(tr("Pause the emulator, or continue after a pause or a breakpoint"));
+    connect(pauseAct, SIGNAL(triggered()), this, SLOT(togglePause()));
+
+    stepAct = new QAction(tr("Step &Into"), this);
+    stepAct->setShortcut(QKeySequence(Qt::Key_F11));
+    stepAct->setStatusTip(tr("Run one instruction while paused"));
+    connect(stepAct, SIGNAL(triggered()), this, SLOT(step()));
+
+    stepOverAct = new QAction(tr("Step &Over"), this);
+    stepOverAct->setShortcut(QKeySequence(Qt::Key_F10));
+    stepOverAct->setStatusTip(tr("Run one instruction while paused, a CALL until it returns"));
+    connect(stepOverAct, SIGNAL(triggered()), this, SLOT(stepOver()));
+
+    exitAct = new QAction(QIcon(":/images/exit.png"), tr("&Exit"), this);
+    exitAct->setStatusTip(tr("Exit emulator"));
+    connect(exitAct, SIGNAL(triggered()), this, SLOT(exit()));
+
+    aboutAct = new QAction(QIcon(":/images/about.png"), tr("About"), this);
+    connect(aboutAct, SIGNAL(triggered()), this, SLOT(about()));
+}
+
+void GUI::createMenus()
+{
+    fileMenu = menuBar()->addMenu(tr("&File(F)"));
+    fileMenu->addAction(openAct);
+    fileMenu->addAction(openLibraryAct);
+    fileMenu->addAction(buildLibraryAct);
+    fileMenu->addSeparator();
+    fileMenu->addAction(saveStateAct);
+    fileMenu->addAction(loadStateAct);
+    fileMenu->addSeparator();
+    fileMenu->addAction(recordMovieAct);
+    fileMenu->addAction(stopMovieAct);
+    fileMenu->addSeparator();
+    fileMenu->addAction(exitAct);
+
+    romMenu = menuBar()->addMenu(tr("&ROMs(R)"));
+    connect(romMenu, SIGNAL(triggered(QAction*)), this, SLOT(selectRom(QAction*)));
+    fillRomMenu();
+
+    debugMenu = menuBar()->addMenu(tr("&Debug(D)"));
+    debugMenu->addAction(profileAct);
+    debugMenu->addSeparator();
+    debugMenu->addAction(traceAct);
+    debugMenu->addAction(dumpTraceAct);
+    debugMenu->addSeparator();
+    debugMenu->addAction(shareAct);
+    debugMenu->addSeparator();
+    debugMenu->addAction(pauseAct);
+    debugMenu->addAction(stepAct);
+    debugMenu->addAction(stepOverAct);
+
+    helpMenu = menuBar()->addMenu(tr("&Help(H)"));
+    helpMenu->addAction(aboutAct);
+}
+
+// Run controls, breakpoint and watch fields above a live listing around PC
+void GUI::createDebugger()
+{
+    shownPaused = false;
+    memoryWatches = 0;
+
+    QWidget *panel = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(panel);
+
+    QHBoxLayout *runRow = new QHBoxLayout();
+    QToolButton *pauseButton = new QToolButton(panel);
+    pauseButton->setDefaultAction(pauseAct);
+    QToolButton *stepButton = new QToolButton(panel);
+    stepButton->setDefaultAction(stepAct);
+    QToolButton *stepOverButton = new QToolButton(panel);
+    stepOverButton->setDefaultAction(stepOverAct);
+    framesSpin = new QSpinBox(panel);
+    framesSpin->setRange(1, 65535);
+    framesSpin->setSuffix(tr(" frames"));
+    QPushButton *runButton = new QPushButton(tr("Run"), panel);
+    connect(runButton, SIGNAL(clicked()), this, SLOT(runFrames()));
+    runRow->addWidget(pauseButton);
+    runRow->addWidget(stepButton);
+    runRow->addWidget(stepOverButton);
+    runRow->addStretch();
+    runRow->addWidget(framesSpin);
+    runRow->addWidget(runButton);
+    layout->addLayout(runRow);
+
+    QHBoxLayout *breakRow = new QHBoxLayout();
+    breakpointEdit = new QLineEdit(panel);
+    breakpointEdit->setPlaceholderText(tr("Breakpoint address, e.g. 0x2A0"));
+    connect(breakpointEdit, SIGNAL(returnPressed()), this, SLOT(toggleBreakpoint()));
+    QPushButton *toggleButton = new QPushButton(tr("Toggle"), panel);
+    connect(toggleButton, SIGNAL(clicked()), this, SLOT(toggleBreakpoint()));
+    QPushButton *clearBreakButton = new QPushButton(tr("Clear"), panel);
+    connect(clearBreakButton, SIGNAL(clicked()), this, SLOT(clearBreakpoints()));
+    breakRow->addWidget(breakpointEdit);
+    breakRow->addWidget(toggleButton);
+    breakRow->addWidget(clearBreakButton);
+    layout->addLayout(breakRow);
+
+    QHBoxLayout *watchRow = new QHBoxLayout();
+    watchEdit = new QLineEdit(panel);
+    watchEdit->setPlaceholderText(tr("Watch: 0x300 16, V3, V3=5 or I"));
+    connect(watchEdit, SIGNAL(returnPressed()), this, SLOT(addWatch()));
+    QPushButton *watchButton = new QPushButton(tr("Watch"), panel);
+    connect(watchButton, SIGNAL(clicked()), this, SLOT(addWatch()));
+    QPushButton *clearWatchButton = new QPushButton(tr("Clear"), panel);
+    connect(clearWatchButton, SIGNAL(clicked()), this, SLOT(clearWatches()));
+    watchRow->addWidget(watchEdit);
+    watchRow->addWidget(watchButton);
+    watchRow->addWidget(clearWatchButton);
+    layout->addLayout(watchRow);
+
+    debugView = new QTextBrowser(panel);
+    debugView->setFontFamily("monospace");
+    debugView->setFontPointSize(10);
+    layout->addWidget(debugView);
+
+    debugDock = new QDockWidget(tr("Debugger"), this);
+    debugDock->setWidget(panel);
+    this->addDockWidget(Qt::RightDockWidgetArea, debugDock);
+    debugMenu->addSeparator();
+    debugMenu->addAction(debugDock->toggleViewAction());
+}
+
+void GUI::open()
+{
+    QString fileName = QFileDialog::getOpenFileName(this);
+    if (!fileName.isEmpty())
+    {
+        std::vector<unsigned char> image;
+        if (!chip8_read_rom(fileName.toStdString().c_str(), image)) {
+            QMessageBox::warning(this, tr("Chip8Emulator"),
+                                 tr("%1 is not a ROM of 1 to %2 bytes").arg(fileName).arg(CHIP8_ROM_MAX_SIZE));
+            return;
+        }
+
+        startRom(&image[0], image.size(), QFileInfo(fileName).fileName());
+    }
+}
+
+// Boots a ROM image; the image is kept so movies can restart it
+void GUI::startRom(const unsigned char *data, size_t size, const QString &name)
+{
+    emuThread->stop();
+    finishMovie();
+
+    rom.assign(data, data + size);
+    romName = name;
+    chip8_emu->initialize();
+    chip8_emu->loadGame(&rom[0], rom.size());
+    emuThread->clearHistory();
+    if (shared.isOpen()) {
+        shared.header()->romHash = chip8_rom_hash(&rom[0], rom.size());
+    }
+    this->setWindowTitle(tr("Chip8Emulator - %1 (%2 quirks)").arg(romName).arg(chip8::quirksName(chip8_emu->getQuirks())));
+
+    emuThread->startEmulation();
+    timer->start(1000 / 60);
+}
+
+void GUI::openLibrary()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open Library"), QString(), tr("Chip-8 ROM packs (*.c8p)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    if (!library.open(fileName.toStdString().c_str())) {
+        QMessageBox::warning(this, tr("Chip8Emulator"), tr("%1 is not a ROM pack of this version").arg(fileName));
+    }
+    fillRomMenu();
+}
+
+void GUI::buildLibrary()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, tr("ROM Folder"));
+    if (dir.isEmpty()) {
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Build Library"), dir + ".c8p", tr("Chip-8 ROM packs (*.c8p)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    std::vector<std::string> skipped;
+    if (!chip8_library::build(dir.toStdString().c_str(), fileName.toStdString().c_str(), &skipped)
+            || !library.open(fileName.toStdString().c_str())) {
+        QMessageBox::warning(this, tr("Chip8Emulator"), tr("Cannot build %1").arg(fileName));
+    } else if (!skipped.empty()) {
+        QMessageBox::information(this, tr("Chip8Emulator"), tr("%1 files were not ROMs and were left out").arg(skipped.size()));
+    }
+    fillRomMenu();
+}
+
+// One action per ROM in the open library; the action data is its index
+void GUI::fillRomMenu()
+{
+    romMenu->clear();
+    romMenu->addAction(findRomAct);
+    findRomAct->setEnabled(library.size() > 0);
+    romMenu->addSeparator();
+
+    for (size_t i = 0; i < library.size(); ++i)
+    {
+        QAction *action = romMenu->addAction(QString::fromLatin1(library.entry(i).name));
+        action->setData((int) i);
+    }
+}
+
+void GUI::selectRom(QAction *action)
+{
+    bool ok = false;
+    int index = action->data().toInt(&ok);
+    if (!ok || index < 0 || (size_t) index >= library.size()) {
+        return;
+    }
+
+    const chip8_pack_entry &e = library.entry(index);
+    startRom(library.image(e), e.size, QString::fromLatin1(e.name));
+}
+
+void GUI::findRom()
+{
+    QString key = QInputDialog::getText(this, tr("Find ROM"), tr("Name or hash:"));
+    if (key.isEmpty()) {
+        return;
+    }
+
+    const chip8_pack_entry *e = library.find(key.trimmed().toStdString().c_str());
+    if (e == NULL) {
+        QMessageBox::information(this, tr("Chip8Emulator"), tr("No ROM named %1 (or with that hash) in the library").arg(key));
+        return;
+    }
+    startRom(library.image(*e), e->size, QString::fromLatin1(e->name));
+}
+
+// The emulator thread is paused around savestates so it never sees a half-copied machine
+void GUI::saveState()
+{
+    bool running = emuThread->isRunning();
+    emuThread->stop();
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save State"), QString(), tr("Chip-8 states (*.c8s)"));
+    if (!fileName.isEmpty() && !chip8_emu->saveState(fileName.toStdString().c_str())) {
+        QMessageBox::warning(this, tr("Chip8Emulator"), tr("Cannot save state to %1").arg(fileName));
+    }
+
+    if (running) {
+        emuThread->startEmulation();
+    }
+}
+
+void GUI::loadState()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load State"), QString(), tr("Chip-8 states (*.c8s)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    emuThread->stop();
+    finishMovie();
+
+    if (chip8_emu->loadState(fileName.toStdString().c_str())) {
+        emuThread->clearHistory();
+    } else {
+        QMessageBox::warning(this, tr("Chip8Emulator"), tr("%1 is not a savestate of this version").arg(fileName));
+    }
+
+    emuThread->startEmulation();
+    timer->start(1000 / 60);
+}
+
+// Movies start from a freshly booted ROM, so recording restarts the current one
+void GUI::recordMovie()
+{
+    if (rom.empty()) {
+        QMessageBox::information(this, tr("Chip8Emulator"), tr("Open a ROM before recording a movie."));
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Record Movie"), QString(), tr("Chip-8 movies (*.c8m)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    emuThread->stop();
+    finishMovie();
+
+    uint64_t romHash = chip8_rom_hash(&rom[0], rom.size());
+
+    uint32_t seed = (uint32_t) time(NULL);
+    chip8_emu->initialize();
+    chip8_emu->loadGame(&rom[0], rom.size());
+    chip8_emu->seedRandom(seed);
+    emuThread->clearHistory();
+
+    if (movie.open(fileName.toStdString().c_str(), seed, chip8_emu->getCyclesPerFrame(), romHash, chip8_emu->getQuirks())) {
+        emuThread->setMovie(&movie);
+        recordMovieAct->setEnabled(false);
+        stopMovieAct->setEnabled(true);
+    } else {
+        QMessageBox::warning(this, tr("Chip8Emulator"), tr("Cannot record to %1").arg(fileName));
+    }
+
+    emuThread->startEmulation();
+    timer->start(1000 / 60);
+}
+
+void GUI::stopMovie()
+{
+    bool running = emuThread->isRunning();
+    emuThread->stop();
+    finishMovie();
+
+    if (running) {
+        emuThread->startEmulation();
+    }
+}
+
+// Only while the emulator thread is stopped; the final hash lets a replay check itself
+void GUI::finishMovie()
+{
+    if (!movie.isOpen()) {
+        return;
+    }
+
+    emuThread->setMovie(NULL);
+    if (!movie.close(chip8_emu->framebufferHash())) {
+        QMessageBox::warning(this, tr("Chip8Emulator"), tr("Cannot finish the movie"));
+    }
+    recordMovieAct->setEnabled(true);
+    stopMovieAct->setEnabled(false);
+}
+
+// The emulator thread owns the counters, so switching goes through its input queue
+void GUI::toggleProfiling(bool enabled)
+{
+    EmulatorEvent e;
+    e.type = EmulatorEvent::PROFILE;
+    e.value = enabled ? 1 : 0;
+    emuThread->pushEvent(e);
+}
+
+void GUI::toggleTracing(bool enabled)
+{
+    EmulatorEvent e;
+    e.type = EmulatorEvent::TRACE;
+    e.value = enabled ? 1 : 0;
+    emuThread->pushEvent(e);
+}
+
+// The debugger belongs to the emulator thread, so it is only ever changed through its input queue
+void GUI::sendDebugEvent(unsigned char type, unsigned char value, unsigned short address, unsigned short length)
+{
+    EmulatorEvent e;
+    e.type = type;
+    e.value = value;
+    e.address = address;
+    e.length = length;
+    emuThread->pushEvent(e);
+}
+
+void GUI::togglePause()
+{
+    sendDebugEvent(shownPaused ? EmulatorEvent::CONTINUE : EmulatorEvent::PAUSE);
+}
+
+void GUI::step()
+{
+    sendDebugEvent(EmulatorEvent::STEP);
+}
+
+void GUI::stepOver()
+{
+    sendDebugEvent(EmulatorEvent::STEP_OVER);
+}
+
+void GUI::runFrames()
+{
+    sendDebugEvent(EmulatorEvent::RUN_FRAMES, 0, (unsigned short) framesSpin->value());
+}
+
+void GUI::toggleBreakpoint()
+{
+    bool ok = false;
+    unsigned addr = breakpointEdit->text().trimmed().toUInt(&ok, 0);
+    if (!ok || addr > 0x0FFF) {
+        QMessageBox::information(this, tr("Chip8Emulator"), tr("Breakpoints go on addresses 0x000 to 0xFFF"));
+        return;
+    }
+
+    bool set = !breakpoints.contains(addr);
+    if (set) {
+        breakpoints.insert(addr);
+    } else {
+        breakpoints.remove(addr);
+    }
+    sendDebugEvent(EmulatorEvent::BREAKPOINT, set ? 1 : 0, (unsigned short) addr);
+    breakpointEdit->clear();
+}
+
+void GUI::clearBreakpoints()
+{
+    breakpoints.clear();
+    sendDebugEvent(EmulatorEvent::CLEAR_BREAKPOINTS);
+}
+
+// "ADDR [LEN]" watches memory, "VX", "VX=N", "I" and "I=N" watch a register
+void GUI::addWatch()
+{
+    QString text = watchEdit->text().trimmed().toUpper();
+    QStringList parts = text.split('=');
+    QString name = parts[0].trimmed();
+
+    bool ok = false;
+    int reg = -1;
+    if (name == "I") {
+        reg = CHIP8_DEBUG_REG_I;
+    } else if (name.length() == 2 && name[0] == 'V') {
+        reg = name.mid(1).toInt(&ok, 16);
+        if (!ok) {
+            reg = -1;
+        }
+    }
+
+    if (reg >= 0 && parts.size() <= 2) {
+        unsigned value = 0;
+        ok = true;
+        if (parts.size() == 2) {
+            value = parts[1].trimmed().toUInt(&ok, 0);
+            ok = ok && value <= (reg == CHIP8_DEBUG_REG_I ? 0xFFFFu : 0xFFu);
+        }
+        if (ok) {
+            sendDebugEvent(EmulatorEvent::WATCH_REGISTER, (unsigned char) reg, (unsigned short) value, parts.size() == 2 ? 1 : 0);
+            watches << text;
+            watchEdit->clear();
+            return;
+        }
+    } else if (reg < 0 && parts.size() == 1) {
+        QStringList words = text.split(' ', QString::SkipEmptyParts);
+        unsigned addr = words.isEmpty() ? 0 : words[0].toUInt(&ok, 0);
+        unsigned length = 1;
+        if (ok && words.size() == 2) {
+            length = words[1].toUInt(&ok, 0);
+        }
+        if (memoryWatches == CHIP8_DEBUG_MEMORY_WATCHES) {
+            QMessageBox::information(this, tr("Chip8Emulator"), tr("At most %1 memory ranges can be watched").arg(CHIP8_DEBUG_MEMORY_WATCHES));
+            return;
+        }
+        if (ok && words.size() <= 2 && length != 0 && addr < CHIP8_MEMORY_SIZE && length <= CHIP8_MEMORY_SIZE - addr) {
+            ++memoryWatches;
+            sendDebugEvent(EmulatorEvent::WATCH_MEMORY, 0, (unsigned short) addr, (unsigned short) length);
+            watches << text;
+            watchEdit->clear();
+            return;
+        }
+    }
+
+    QMessageBox::information(this, tr("Chip8Emulator"), tr("Watch an address and length (0x300 16), a register (V3, I) or a register value (V3=5)"));
+}
+
+void GUI::clearWatches()
+{
+    watches.clear();
+    memoryWatches = 0;
+    sendDebugEvent(EmulatorEvent::CLEAR_WATCHES);
+}
+
+// The trace ring can be read while the emulator keeps running
+void GUI::dumpTrace()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Dump Trace"), QString(), tr("Chip-8 traces (*.c8t)"));
+    if (!fileName.isEmpty() && !emuThread->dumpTrace(fileName.toStdString().c_str())) {
+        QMessageBox::warning(this, tr("Chip8Emulator"), tr("Cannot write trace to %1").arg(fileName));
+    }
+}
+
+// The region is handed to the emulator thread, which may only change hands while it is stopped
+void GUI::toggleSharing(bool enabled)
+{
+    bool running = emuThread->isRunning();
+    emuThread->stop();
+    emuThread->setSharedMemory(NULL);
+    shared.close();
+
+    if (enabled) {
+        uint64_t romHash = rom.empty() ? 0 : chip8_rom_hash(&rom[0], rom.size());
+        if (shared.create(CHIP8_GUI_SHM_NAME, 1, CHIP8_SHM_FREE, romHash)) {
+            emuThread->setSharedMemory(&shared);
+        } else {
+            QMessageBox::warning(this, tr("Chip8Emulator"), tr("Cannot create shared memory " CHIP8_GUI_SHM_NAME));
+            shareAct->blockSignals(true);
+            shareAct->setChecked(false);
+            shareAct->blockSignals(false);
+        }
+    }
+
+    if (running) {
+        emuThread->startEmulation();
+    }
+}
+
+void GUI::exit()
+{
+    timer->stop();
+    emuThread->stop();
+    finishMovie();
+    QApplication::quit();
+}
+
+void GUI::about()
+{
+    QMessageBox::about(this, tr("Chip8Emulator"),
+             tr("Chip8Emulator 0.8 (MinGW 32bit)\nBuilt on 2016/1/18\n\nCopyright 2016 NCKU CSIE 陳冠斌. All rights reserved."));
+}
+
+// Maps the left side of a QWERTY keyboard onto the HEX keypad:
+//   1 2 3 4        1 2 3 C
+//   Q W E R   ->   4 5 6 D
+//   A S D F        7 8 9 E
+//   Z X C V        A 0 B F
+static int chip8Key(int qtKey)
+{
+    switch (qtKey)
+    {
+    case Qt::Key_1: return 0x1;
+    case Qt::Key_2: return 0x2;
+    case Qt::Key_3: return 0x3;
+    case Qt::Key_4: return 0xC;
+    case Qt::Key_Q: return 0x4;
+    case Qt::Key_W: return 0x5;
+    case Qt::Key_E: return 0x6;
+    case Qt::Key_R: return 0xD;
+    case Qt::Key_A: return 0x7;
+    case Qt::Key_S: return 0x8;
+    case Qt::Key_D: return 0x9;
+    case Qt::Key_F: return 0xE;
+    case Qt::Key_Z: return 0xA;
+    case Qt::Key_X: return 0x0;
+    case Qt::Key_C: return 0xB;
+    case Qt::Key_V: return 0xF;
+    }
+    return -1;
+}
+
+bool GUI::event(QEvent *event)
+{
+    if (event->type() == QEvent::KeyPress || event->type() == QEvent::KeyRelease)
+    {
+        QKeyEvent *ke = static_cast<QKeyEvent *>(event);
+
+        // Backspace held down rewinds
+        if (ke->key() == Qt::Key_Backspace) {
+            if (!ke->isAutoRepeat()) {
+                EmulatorEvent e;
+                e.type = (event->type() == QEvent::KeyPress) ? EmulatorEvent::REWIND_START : EmulatorEvent::REWIND_STOP;
+                e.value = 0;
+                emuThread->pushEvent(e);
+            }
+            return true;
+        }
+
+        int index = chip8Key(ke->key());
+        if (index < 0) {
+            return QWidget::event(event);
+        }
+
+        // Key state changes go to the emulator thread through its input queue
+        if (!ke->isAutoRepeat()) {
+            EmulatorEvent e;
+            e.type = (event->type() == QEvent::KeyPress) ? EmulatorEvent::KEY_DOWN : EmulatorEvent::KEY_UP;
+            e.value = index;
+            emuThread->pushEvent(e);
+        }
+        return true;
+    }
+
+    return QWidget::event(event);
+}
+
+// Hottest opcode classes and addresses, as shares of all instructions run
+static QString profileInfo(const chip8_profile &p)
+{
+    double total = p.instructions ? (double) p.instructions : 1.0;
+    QString str;
+    QString line;
+
+    line.sprintf("\nFrame: %u instructions, %u draws\n", p.frameInstructions, p.frameDraws);
+    str += line;
+
+    // Top opcode classes by selection, the table is small
+    bool shown[chip8::OP_COUNT] = { false };
+    str += "Opcodes:\n";
+    for (int rank = 0; rank < 8; ++rank)
+    {
+        int best = -1;
+        for (int op = 0; op < chip8::OP_COUNT; ++op)
+        {
+            if (!shown[op] && p.ops[op] != 0 && (best < 0 || p.ops[op] > p.ops[best])) {
+                best = op;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        shown[best] = true;
+        line.sprintf("  %-6s %5.1f%%\n", chip8::opName(best), 100.0 * p.ops[best] / total);
+        str += line;
+    }
+
+    unsigned short hot[8];
+    size_t found = chip8_profile_hottest(p, hot, 8);
+    str += "Hot PCs:\n";
+    for (size_t i = 0; i < found; ++i)
+    {
+        line.sprintf("  0x%03X  %5.1f%%\n", hot[i], 100.0 * p.pc[hot[i]] / total);
+        str += line;
+    }
+
+    return str;
+}
+
+// Registers, why the machine stopped and a disassembly around PC ('>' marks PC, '*' breakpoints)
+static QString debugInfo(const EmulatorFrame &f, const QStringList &watches)
+{
+    QString str;
+    QString line;
+
+    chip8_debugger::Reason reason = (chip8_debugger::Reason) f.stopReason;
+    if (!f.paused) {
+        str += "Running\n";
+    } else if (reason == chip8_debugger::STOP_MEMORY) {
+        line.sprintf("Paused: memory watch, 0x%03X written\n", f.stopAddress);
+        str += line;
+    } else if (reason == chip8_debugger::STOP_REGISTER) {
+        if (f.stopAddress == CHIP8_DEBUG_REG_I) {
+            str += "Paused: register watch, I changed\n";
+        } else {
+            line.sprintf("Paused: register watch, V%X changed\n", f.stopAddress);
+            str += line;
+        }
+    } else if (reason != chip8_debugger::STOP_NONE) {
+        line.sprintf("Paused: %s\n", chip8_debugger::reasonName(reason));
+        str += line;
+    } else {
+        str += "Paused\n";
+    }
+
+    for (int r = 0; r < 16; ++r)
+    {
+        line.sprintf("V%X=%02X%s", r, f.V[r], (r % 8 == 7) ? "\n" : " ");
+        str += line;
+    }
+    line.sprintf("I=%03X SP=%X DT=%02X ST=%02X\nStack:", f.I, f.sp, f.delayTimer, f.soundTimer);
+    str += line;
+    for (int i = f.sp - 1; i >= 0 && i < 16; --i)
+    {
+        line.sprintf(" %03X", f.stack[i]);
+        str += line;
+    }
+    str += "\n";
+    if (!watches.isEmpty()) {
+        str += "Watching: " + watches.join(", ") + "\n";
+    }
+    str += "\n";
+
+    for (int i = 0; i + 1 < EMULATOR_LISTING_BYTES; i += 2)
+    {
+        unsigned short addr = (f.listingStart + i) & 0x0FFF;
+        unsigned short opcode = (unsigned short) (f.listing[i] << 8 | f.listing[i + 1]);
+        char text[32];
+        chip8_disassemble(opcode, text, sizeof(text));
+        line.sprintf("%c%c %03X  %04X  %s\n", addr == f.pc ? '>' : ' ',
+                     ((f.listingBreakpoints >> i) & 1) ? '*' : ' ', addr, opcode, text);
+        str += line;
+    }
+    return str;
+}
+
+// Runs on the UI timer: shows the newest frame the emulator thread published, if any
+void GUI::refreshFrame()
+{
+    const EmulatorFrame *frame = emuThread->takeFrame();
+    if (frame == NULL) {
+        return;
+    }
+
+    // Only rows that changed since the last shown frame are repainted
+    uint64_t dirty = 0;
+    for (int y = 0; y < CHIP8_FB_ROWS; ++y)
+    {
+        for (int w = y * CHIP8_FB_ROW_WORDS; w < (y + 1) * CHIP8_FB_ROW_WORDS; ++w)
+        {
+            for (int p = 0; p < CHIP8_PLANES; ++p)
+            {
+                if (frame->rows[p * CHIP8_FB_PLANE_WORDS + w] != shownRows[p * CHIP8_FB_PLANE_WORDS + w]) {
+                    dirty |= 1ULL << y;
+                }
+            }
+        }
+    }
+    if (frame->hires != shownHires) {
+        dirty = ~0ULL;
+        shownHires = frame->hires;
+    }
+    if (dirty != 0) {
+        memcpy(shownRows, frame->rows, sizeof(shownRows));
+        display->updateRows(shownRows, shownHires, dirty);
+    }
+
+    // Status dock, refreshed once per frame and only when it changes
+    QString infoStr;
+    infoStr.sprintf("PC: 0x%x\nRewind: %u frames%s\n", frame->pc, frame->history,
+                    frame->rewinding ? " (rewinding)" : "");
+    if (shared.isOpen()) {
+        infoStr += "Shared memory: " CHIP8_GUI_SHM_NAME "\n";
+    }
+    if (frame->audio.onsets != 0) {
+        const chip8_audio_stats &a = frame->audio;
+        QString audioStr;
+        audioStr.sprintf("Audio latency: %.1f ms (mean %.1f, max %.1f), %llu samples dropped\n",
+                         a.lastLatency * 1e3, a.totalLatency / a.onsets * 1e3, a.maxLatency * 1e3, a.dropped);
+        infoStr += audioStr;
+    }
+    if (frame->profiling) {
+        infoStr += profileInfo(frame->profile);
+    }
+    if (infoStr != lastInfo) {
+        infoView->setPlainText(infoStr);
+        lastInfo = infoStr;
+    }
+
+    // Debugger panel, the same way; a paused machine publishes the same text every frame
+    if (frame->paused != shownPaused) {
+        shownPaused = frame->paused;
+        pauseAct->setText(shownPaused ? tr("&Continue") : tr("&Pause"));
+    }
+    if (debugDock->isVisible()) {
+        QString debugStr = debugInfo(*frame, watches);
+        if (debugStr != lastDebug) {
+            debugView->setPlainText(debugStr);
+            lastDebug = debugStr;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef GUI_H
+#define GUI_H
+
+#include <QMainWindow>
+#include <QTextBrowser>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QSet>
+#include <QStringList>
+
+#include "audiooutput.h"
+#include "chip8.h"
+#include "emulatorthread.h"
+#include "library.h"
+#include "movie.h"
+#include "shm.h"
+
+#include <vector>
+
+#define CHIP8_GUI_SHM_NAME  "/chip8-gui"     // Region Debug > Share Memory publishes to
+
+class DisplayWidget;
+
+class GUI : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    GUI(QWidget *parent = 0);
+    ~GUI();
+
+protected:
+    bool event(QEvent *event);
+
+private slots:
+    void open();
+    void openLibrary();
+    void buildLibrary();
+    void findRom();
+    void selectRom(QAction *action);
+    void saveState();
+    void loadState();
+    void recordMovie();
+    void stopMovie();
+    void toggleProfiling(bool enabled);
+    void toggleTracing(bool enabled);
+    void dumpTrace();
+    void toggleSharing(bool enabled);
+    void togglePause();
+    void step();
+    void stepOver();
+    void runFrames();
+    void toggleBreakpoint();
+    void clearBreakpoints();
+    void addWatch();
+    void clearWatches();
+    void exit();
+    void about();
+    void refreshFrame();
+
+private:
+    void createActions();
+    void createMenus();
+    void createDebugger();
+    void sendDebugEvent(unsigned char type, unsigned char value = 0, unsigned short address = 0, unsigned short length = 0);
+    void finishMovie();
+    void startRom(const unsigned char *data, size_t size, const QString &name);
+    void fillRomMenu();
+
+    QMenu *fileMenu;
+    QMenu *romMenu;
+    QMenu *debugMenu;
+    QMenu *helpMenu;
+    QAction *openAct;
+    QAction *openLibraryAct;
+    QAction *buildLibraryAct;
+    QAction *findRomAct;
+    QAction *saveStateAct;
+    QAction *loadStateAct;
+    QAction *recordMovieAct;
+    QAction *stopMovieAct;
+    QAction *profileAct;
+    QAction *traceAct;
+    QAction *dumpTraceAct;
+    QAction *shareAct;
+    QAction *pauseAct;
+    QAction *stepAct;
+    QAction *stepOverAct;
+    QAction *exitAct;
+    QAction *aboutAct;
+
+    QDockWidget *dockWidget;
+    DisplayWidget *display;
+    QTextBrowser *infoView;
+    QString lastInfo;
+
+    QDockWidget *debugDock;
+    QLineEdit *breakpointEdit;
+    QLineEdit *watchEdit;
+    QSpinBox *framesSpin;
+    QTextBrowser *debugView;
+    QString lastDebug;
+    QSet<unsigned> breakpoints;         // Mirrors of what the emulator thread's debugger was sent
+    QStringList watches;                // As typed
+    unsigned memoryWatches;
+    bool shownPaused;
+
+    QTimer *timer;
+
+    chip8 *chip8_emu;
+    EmulatorThread *emuThread;
+    std::vector<unsigned char> rom;     // Image of the running ROM, for restarts
+    QString romName;
+    chip8_library library;
+    chip8_movie_writer movie;
+    chip8_shm shared;                   // Open while Debug > Share Memory is checked
+    uint64_t shownRows[CHIP8_PLANES * CHIP8_FB_PLANE_WORDS];
+    bool shownHires;
+    AudioOutput audioOutput;
+    chip8_null_sink noAudio;            // When there is no usable audio device
+};
+
+#endif // GUI_H
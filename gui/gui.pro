@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2016-01-11T13:57:40
+#
+#-------------------------------------------------
+
+QT       += core gui multimedia
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = Chip8Emulator
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += main.cpp\
+        gui.cpp \
+    audiooutput.cpp \
+    displaywidget.cpp \
+    emulatorthread.cpp
+
+HEADERS  += gui.h \
+    audiooutput.h \
+    displaywidget.h \
+    emulatorthread.h
+
+RESOURCES += \
+    resources.qrc
@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Headless command-line runner, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt app_bundle
+CONFIG   += console
+
+TARGET = Chip8Headless
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += main.cpp
+
+# The bundled ROMs recompiled by Chip8Recompile, for --engine native
+include(../recompiler/native_roms.pri)
+
+# make check: every engine, quirk profile and idle setting against the interpreter on the bundled ROMs
+check.commands = ./$(TARGET) --pack check.c8p --build $$PWD/../ROMs --check --frames 3000
+check.depends = $(TARGET)
+QMAKE_EXTRA_TARGETS += check
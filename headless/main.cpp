@@ -0,0 +1,1095 @@
+#include "chip8.h"
+#include "audio.h"
+#include "batch.h"
+#include "lanes.h"
+#include "library.h"
+#include "state.h"
+#include "rewind.h"
+#include "search.h"
+#include "movie.h"
+#include "quirks.h"
+#include "trace.h"
+#include "shm.h"
+#include "thread_pool.h"
+#include "video.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+struct Options
+{
+    const char *romPath;                // As given: a file, or a name or hash in the pack
+    const unsigned char *rom;           // The ROM image, resolved once by main()
+    size_t romSize;
+    unsigned long long frames;
+    unsigned long long ipf;
+    chip8::Engine engine;
+    bool lanes;
+    uint32_t seed;
+    bool seeded;
+    size_t instances;
+    unsigned threads;
+    bool scaling;
+    const char *loadStatePath;
+    const char *saveStatePath;
+    bool rewind;
+    const char *recordPath;
+    const char *replayPath;
+    bool profile;
+    const char *tracePath;
+    const char *packPath;
+    int quirks;                         // chip8::Quirks, or -1 to go by the ROM hash
+    bool idle;                          // Fast-forward idle loops
+    const char *audioPath;              // WAV file for the synthesized sound, or NULL
+    const char *videoPath;              // Framebuffer video of the run, or NULL
+    const char *serveName;              // Shared-memory region to serve machines in, or NULL
+    const char *agentName;              // Shared-memory region to step as the reference agent, or NULL
+    unsigned searchDepth;               // Levels of state-space search, 0 for a plain run
+    unsigned stepFrames;                // Frames each key is held for in the search
+    size_t maxStates;                   // Search stops adding states past this, 0 for no limit
+};
+
+// "N (P%)" of the instructions that were fast-forwarded
+static void printIdle(unsigned long long idle, unsigned long long instructions)
+{
+    printf("Idle skipped:  %llu (%.1f%%)\n", idle, instructions ? 100.0 * idle / instructions : 0.0);
+}
+
+// Only when the ROM ran into any; the core leaves reporting them to the tools
+static void printUnknown(const chip8 &emu)
+{
+    if (emu.getUnknownOpcodes() != 0) {
+        printf("Unknown ops:   %llu decoded, last 0x%04X\n", emu.getUnknownOpcodes(), emu.getLastUnknownOpcode());
+    }
+}
+
+// The native engine interprets ROMs that were not recompiled into this executable
+static const char *nativeNote(const chip8 &emu)
+{
+    if (emu.getEngine() == chip8::ENGINE_NATIVE && emu.getNative() == NULL) {
+        return " (no recompiled code for this ROM, interpreting)";
+    }
+    return "";
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] <rom>\n", prog);
+    printf("       %s [options] --load-state FILE\n", prog);
+    printf("       %s --pack F [--build DIR] [--list | --all | --check | [options] <name or hash>]\n", prog);
+    printf("  --cycles N     Run at least N instructions (default 1000000)\n");
+    printf("  --frames N     Run N frames instead of a fixed cycle count\n");
+    printf("  --ipf N        Instructions per 60 Hz frame (default %d)\n", CHIP8_DEFAULT_CYCLES_PER_FRAME);
+    printf("  --engine E     interpreter, blocks, native or lanes (default interpreter)\n");
+    printf("  --seed N       Seed for CXNN (default: time based)\n");
+    printf("  --instances N  Run N machines in parallel (default 1)\n");
+    printf("  --threads N    Worker threads for --instances (default: all cores)\n");
+    printf("  --scaling      Repeat the batch with 1, 2, 4, ... threads\n");
+    printf("  --load-state F Resume from a savestate instead of booting the ROM\n");
+    printf("  --save-state F Write a savestate of (the first) machine when done\n");
+    printf("  --rewind       Record every frame into a rewind buffer and report its cost\n");
+    printf("  --record F     Record the run as an input movie\n");
+    printf("  --replay F     Replay an input movie against the ROM and check its hash\n");
+    printf("  --no-idle      Run idle loops instruction by instruction\n");
+    printf("  --audio F      Synthesize the sound timer into the WAV file F\n");
+    printf("  --video F      Record the framebuffer of every frame into F\n");
+    printf("  --serve NAME   Serve --instances machines in shared memory, a frame per agent step\n");
+    printf("  --agent NAME   Step every machine served at NAME --frames times with random keys\n");
+    printf("  --search N     Explore every key held for --step frames, N levels breadth-first\n");
+    printf("  --step N       Frames per search step (default 1)\n");
+    printf("  --max-states N Stop the search after about N distinct states\n");
+    printf("  --profile      Count instructions per opcode class and address\n");
+    printf("  --trace F      Trace the last instructions, dumped to F at exit or on a crash\n");
+    printf("  --quirks Q     modern, vip, chip48, schip or xochip (default: by ROM hash)\n");
+    printf("  --pack F       Take ROMs from the pack F, by name or content hash\n");
+    printf("  --build DIR    Index the ROMs in DIR into the pack first\n");
+    printf("  --list         List the ROMs in the pack\n");
+    printf("  --all          Run every ROM in the pack\n");
+    printf("  --check        Check every engine, profile and idle setting against the interpreter\n");
+}
+
+static double seconds(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end)
+{
+    return chrono::duration<double>(end - start).count();
+}
+
+static bool byCount(const chip8_profile *p, int a, int b)
+{
+    return p->ops[a] > p->ops[b];
+}
+
+// Opcode classes and the hottest addresses, most executed first
+static void printProfile(const chip8_profile &p)
+{
+    double total = p.instructions ? (double) p.instructions : 1.0;
+
+    printf("Profile:       %llu frames, last one %u instructions and %u draws\n",
+           p.frames, p.frameInstructions, p.frameDraws);
+
+    int order[chip8::OP_COUNT];
+    for (int op = 0; op < chip8::OP_COUNT; ++op)
+    {
+        order[op] = op;
+    }
+    sort(order, order + chip8::OP_COUNT, [&p](int a, int b) { return byCount(&p, a, b); });
+
+    printf("Opcode classes:\n");
+    for (int i = 0; i < chip8::OP_COUNT && p.ops[order[i]] != 0; ++i)
+    {
+        printf("  %-8s %14llu %6.2f%%\n", chip8::opName(order[i]), p.ops[order[i]], 100.0 * p.ops[order[i]] / total);
+    }
+
+    unsigned short hot[16];
+    size_t found = chip8_profile_hottest(p, hot, 16);
+    printf("Hot addresses:\n");
+    for (size_t i = 0; i < found; ++i)
+    {
+        printf("  0x%03X    %14llu %6.2f%%\n", hot[i], p.pc[hot[i]], 100.0 * p.pc[hot[i]] / total);
+    }
+}
+
+// Attaches the trace ring to emu when --trace was given
+static void startTrace(const Options &opt, chip8 &emu, chip8_trace &trace)
+{
+    if (opt.tracePath == NULL) {
+        return;
+    }
+    if (!trace.dumpOnCrash(opt.tracePath)) {
+        fprintf(stderr, "Warning: no crash dumps on this platform\n");
+    }
+    emu.setTrace(&trace);
+}
+
+static bool finishTrace(const Options &opt, const chip8_trace &trace)
+{
+    if (opt.tracePath == NULL) {
+        return true;
+    }
+    if (!trace.dump(opt.tracePath)) {
+        fprintf(stderr, "Cannot write trace: %s\n", opt.tracePath);
+        return false;
+    }
+    printf("Trace:         %llu instructions, newest written to %s\n",
+           (unsigned long long) trace.total(), opt.tracePath);
+    return true;
+}
+
+static int runSingle(const Options &opt)
+{
+    chip8 emu;
+    emu.setEngine(opt.engine);
+    emu.setIdleSkipping(opt.idle);
+    emu.setProfiling(opt.profile);
+    emu.setCyclesPerFrame((unsigned) opt.ipf);
+
+    chip8_trace trace(opt.tracePath ? CHIP8_TRACE_DEFAULT_ENTRIES : 1);
+    startTrace(opt, emu, trace);
+    emu.initialize();
+    if (opt.loadStatePath != NULL) {
+        if (!emu.loadState(opt.loadStatePath)) {
+            fprintf(stderr, "Cannot load state: %s\n", opt.loadStatePath);
+            return 1;
+        }
+    } else {
+        emu.loadGame(opt.rom, opt.romSize);
+    }
+    if (opt.quirks >= 0) {
+        emu.setQuirks((chip8::Quirks) opt.quirks);
+    }
+    if (opt.seeded) {
+        emu.seedRandom(opt.seed);
+    }
+
+    // A movie needs the seed, so recordings always pick one explicitly
+    chip8_movie_writer movie;
+    if (opt.recordPath != NULL) {
+        uint32_t seed = opt.seeded ? opt.seed : (uint32_t) time(NULL);
+        uint64_t romHash = chip8_rom_hash(opt.rom, opt.romSize);
+        emu.seedRandom(seed);
+        if (!movie.open(opt.recordPath, seed, (unsigned) opt.ipf, romHash, emu.getQuirks())) {
+            fprintf(stderr, "Cannot record to: %s\n", opt.recordPath);
+            return 1;
+        }
+    }
+
+    chip8_wav_sink wav;
+    chip8_audio audio;
+    if (opt.audioPath != NULL) {
+        if (!wav.open(opt.audioPath, audio.getRate())) {
+            fprintf(stderr, "Cannot write audio: %s\n", opt.audioPath);
+            return 1;
+        }
+        audio.setSink(&wav);
+    }
+
+    chip8_video_writer video;
+    if (opt.videoPath != NULL && !video.open(opt.videoPath, chip8_rom_hash(opt.rom, opt.romSize))) {
+        fprintf(stderr, "Cannot record video to: %s\n", opt.videoPath);
+        return 1;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chip8_frame result;
+    chip8_rewind history;
+    double recording = 0;
+    double synthesis = 0;
+    double capture = 0;
+    if (opt.rewind || movie.isOpen() || wav.isOpen() || video.isOpen()) {
+        const unsigned char noKeys[16] = { 0 };
+        result.instructions = 0;
+        for (unsigned long long f = 0; f < opt.frames; ++f)
+        {
+            if (movie.isOpen()) {
+                movie.writeFrame(noKeys);
+            }
+            audio.beginFrame();
+            chip8_frame frame = emu.runFrame();
+            result.instructions += frame.instructions;
+            if (wav.isOpen()) {
+                chrono::steady_clock::time_point audioStart = chrono::steady_clock::now();
+                audio.renderFrame(emu, frame);
+                synthesis += seconds(audioStart, chrono::steady_clock::now());
+            }
+            if (video.isOpen()) {
+                chrono::steady_clock::time_point videoStart = chrono::steady_clock::now();
+                video.writeFrame(emu);
+                capture += seconds(videoStart, chrono::steady_clock::now());
+            }
+            if (!opt.rewind) {
+                continue;
+            }
+
+            chrono::steady_clock::time_point recordStart = chrono::steady_clock::now();
+            chip8_state state;
+            emu.saveState(state);
+            history.record(state);
+            recording += seconds(recordStart, chrono::steady_clock::now());
+        }
+    } else {
+        result = emu.runFrames((unsigned) opt.frames);
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    double elapsed = seconds(start, end) - recording - synthesis - capture;
+
+    printf("ROM:           %s\n", opt.loadStatePath ? opt.loadStatePath : opt.romPath);
+    printf("Engine:        %s%s\n", chip8::engineName(opt.engine), nativeNote(emu));
+    printf("Quirks:        %s\n", chip8::quirksName(emu.getQuirks()));
+    printf("Frames:        %llu\n", opt.frames);
+    printf("Instructions:  %llu\n", result.instructions);
+    printf("Elapsed:       %.6f s\n", elapsed);
+    printf("Instr/sec:     %.0f\n", elapsed > 0 ? result.instructions / elapsed : 0.0);
+    printIdle(emu.getIdleInstructions(), result.instructions);
+    printUnknown(emu);
+    printf("Final PC:      0x%03X\n", emu.getPC());
+    printf("FB hash:       0x%016llX\n", (unsigned long long) emu.framebufferHash());
+    if (opt.rewind) {
+        printf("Rewind:        %llu frames in %llu bytes, %.2f us/frame to record\n",
+               (unsigned long long) history.size(), (unsigned long long) history.bytesUsed(),
+               opt.frames ? recording / opt.frames * 1e6 : 0.0);
+    }
+    if (wav.isOpen()) {
+        const chip8_audio_stats &s = audio.getStats();
+        printf("Audio:         %llu samples, %llu tone starts, %.2f us/frame to synthesize and write\n",
+               s.samples, s.onsets, opt.frames ? synthesis / opt.frames * 1e6 : 0.0);
+    }
+    if (opt.profile) {
+        printProfile(*emu.getProfile());
+    }
+    if (!finishTrace(opt, trace)) {
+        return 1;
+    }
+    if (wav.isOpen() && !wav.close()) {
+        fprintf(stderr, "Cannot finish audio: %s\n", opt.audioPath);
+        return 1;
+    }
+    if (video.isOpen()) {
+        if (!video.close()) {
+            fprintf(stderr, "Cannot finish video: %s\n", opt.videoPath);
+            return 1;
+        }
+        // An hour is 216000 frames
+        printf("Video:         %llu frames, %llu distinct, %llu bytes (%.1f KB/hour), %.3f us/frame, %llu stalls\n",
+               (unsigned long long) video.frames(), (unsigned long long) video.pictures(),
+               (unsigned long long) video.bytes(),
+               video.frames() ? video.bytes() * 216000.0 / video.frames() / 1024 : 0.0,
+               opt.frames ? capture / opt.frames * 1e6 : 0.0, (unsigned long long) video.stalls());
+    }
+
+    if (opt.saveStatePath != NULL && !emu.saveState(opt.saveStatePath)) {
+        fprintf(stderr, "Cannot save state: %s\n", opt.saveStatePath);
+        return 1;
+    }
+    if (movie.isOpen() && !movie.close(emu.framebufferHash())) {
+        fprintf(stderr, "Cannot finish movie: %s\n", opt.recordPath);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Boots the ROM with the movie's seed and feeds it the recorded keys as fast as possible
+static int runReplay(const Options &opt)
+{
+    chip8_movie_reader movie;
+    if (!movie.open(opt.replayPath)) {
+        fprintf(stderr, "Cannot read movie: %s\n", opt.replayPath);
+        return 1;
+    }
+    const chip8_movie_header &header = movie.getHeader();
+
+    if (chip8_rom_hash(opt.rom, opt.romSize) != header.romHash) {
+        fprintf(stderr, "Warning: the movie was recorded with a different ROM\n");
+    }
+
+    chip8 emu;
+    emu.setEngine(opt.engine);
+    emu.setIdleSkipping(opt.idle);
+    emu.setProfiling(opt.profile);
+    emu.setCyclesPerFrame(header.cyclesPerFrame);
+
+    chip8_trace trace(opt.tracePath ? CHIP8_TRACE_DEFAULT_ENTRIES : 1);
+    startTrace(opt, emu, trace);
+    emu.initialize();
+    emu.loadGame(opt.rom, opt.romSize);
+    emu.setQuirks((chip8::Quirks) header.quirks);
+    emu.seedRandom(header.seed);
+
+    unsigned char key[16];
+    unsigned long long frames = 0;
+    unsigned long long instructions = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    while (movie.readFrame(key))
+    {
+        emu.setKeys(key);
+        instructions += emu.runFrame().instructions;
+        ++frames;
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    double elapsed = seconds(start, end);
+    uint64_t hash = emu.framebufferHash();
+
+    printf("ROM:           %s\n", opt.romPath);
+    printf("Movie:         %s (seed 0x%08X, %u instr/frame)\n", opt.replayPath, header.seed, header.cyclesPerFrame);
+    printf("Engine:        %s%s\n", chip8::engineName(opt.engine), nativeNote(emu));
+    printf("Quirks:        %s\n", chip8::quirksName(emu.getQuirks()));
+    printf("Frames:        %llu\n", frames);
+    printf("Instructions:  %llu\n", instructions);
+    printf("Elapsed:       %.6f s\n", elapsed);
+    printf("Instr/sec:     %.0f\n", elapsed > 0 ? instructions / elapsed : 0.0);
+    printIdle(emu.getIdleInstructions(), instructions);
+    printUnknown(emu);
+    printf("FB hash:       0x%016llX\n", (unsigned long long) hash);
+    if (opt.profile) {
+        printProfile(*emu.getProfile());
+    }
+    if (!finishTrace(opt, trace)) {
+        return 1;
+    }
+
+    if (header.frames == 0) {
+        printf("Expected:      unknown, the recording was not closed\n");
+        return 0;
+    }
+    printf("Expected:      0x%016llX %s\n", (unsigned long long) header.finalHash,
+           hash == header.finalHash && frames == header.frames ? "(match)" : "(MISMATCH)");
+
+    return (hash == header.finalHash && frames == header.frames) ? 0 : 1;
+}
+
+// Runs opt.instances machines on a pool of the given size, returns instructions/second
+static double runBatch(const Options &opt, unsigned threads, bool report)
+{
+    chip8_thread_pool pool(threads);
+    chip8_batch batch(opt.instances, pool);
+    batch.setEngine(opt.engine);
+    batch.setIdleSkipping(opt.idle);
+    batch.setCyclesPerFrame((unsigned) opt.ipf);
+
+    double warmStart = 0;
+    if (opt.loadStatePath != NULL) {
+        chip8_state_file file;
+        if (!file.open(opt.loadStatePath)) {
+            fprintf(stderr, "Cannot load state: %s\n", opt.loadStatePath);
+            return -1;
+        }
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (!batch.loadState(*file.state())) {
+            fprintf(stderr, "Cannot load state: %s\n", opt.loadStatePath);
+            return -1;
+        }
+        warmStart = seconds(start, chrono::steady_clock::now());
+    } else {
+        batch.loadGame(opt.rom, opt.romSize);
+        if (opt.quirks >= 0) {
+            batch.setQuirks((chip8::Quirks) opt.quirks);
+        }
+    }
+    batch.seedRandom(opt.seeded ? opt.seed : (uint32_t) time(NULL));
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    batch.runFrames((unsigned) opt.frames);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    double elapsed = seconds(start, end);
+    double rate = elapsed > 0 ? batch.instructions() / elapsed : 0.0;
+
+    if (report) {
+        printf("ROM:           %s\n", opt.loadStatePath ? opt.loadStatePath : opt.romPath);
+        printf("Engine:        %s\n", chip8::engineName(opt.engine));
+        printf("Instances:     %llu\n", (unsigned long long) batch.size());
+        printf("Threads:       %u\n", pool.size());
+        if (opt.loadStatePath != NULL) {
+            printf("Warm start:    %.1f us\n", warmStart * 1e6);
+        }
+        printf("Frames:        %llu per instance\n", opt.frames);
+        printf("Instructions:  %llu\n", batch.instructions());
+        printf("Elapsed:       %.6f s\n", elapsed);
+        printf("Instr/sec:     %.0f (aggregate)\n", rate);
+        printIdle(batch.idleInstructions(), batch.instructions());
+        printUnknown(batch.instance(0));
+        printf("Final PC[0]:   0x%03X\n", batch.instance(0).getPC());
+        printf("FB hash[0]:    0x%016llX\n", (unsigned long long) batch.framebufferHash(0));
+
+        if (opt.saveStatePath != NULL && !batch.instance(0).saveState(opt.saveStatePath)) {
+            fprintf(stderr, "Cannot save state: %s\n", opt.saveStatePath);
+            return -1;
+        }
+    }
+
+    return rate;
+}
+
+// Runs opt.instances machines in lockstep on one thread
+static int runLanes(const Options &opt)
+{
+    chip8_lanes lanes(opt.instances);
+    lanes.setCyclesPerFrame((unsigned) opt.ipf);
+    if (!lanes.loadGame(opt.rom, opt.romSize)) {
+        fprintf(stderr, "The lanes engine only runs ROMs of up to %d bytes\n", CHIP8_LANES_ROM_MAX_SIZE);
+        return 1;
+    }
+    if (chip8_rom_quirks(chip8_rom_hash(opt.rom, opt.romSize), opt.romSize) != chip8::QUIRKS_MODERN || opt.quirks > 0) {
+        fprintf(stderr, "Warning: the lanes engine only implements 64x32 CHIP-8 with the modern quirks\n");
+    }
+    lanes.seedRandom(opt.seeded ? opt.seed : (uint32_t) time(NULL));
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    lanes.runFrames((unsigned) opt.frames);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    double elapsed = seconds(start, end);
+
+    printf("ROM:           %s\n", opt.romPath);
+    printf("Engine:        lanes\n");
+    printf("Instances:     %llu\n", (unsigned long long) lanes.size());
+    printf("Frames:        %llu per instance\n", opt.frames);
+    printf("Instructions:  %llu\n", lanes.instructions());
+    printf("Vectorized:    %.1f%%\n", lanes.instructions() ? 100.0 * lanes.vectorInstructions() / lanes.instructions() : 0.0);
+    printf("Elapsed:       %.6f s\n", elapsed);
+    printf("Instr/sec:     %.0f (aggregate)\n", elapsed > 0 ? lanes.instructions() / elapsed : 0.0);
+    printf("Final PC[0]:   0x%03X\n", lanes.getPC(0));
+    printf("FB hash[0]:    0x%016llX\n", (unsigned long long) lanes.framebufferHash(0));
+
+    return 0;
+}
+
+// Runs every ROM of the pack on one machine each, straight from the mapping
+static int runAll(const Options &opt, const chip8_library &library, double opening)
+{
+    printf("Pack:          %s, %llu ROMs, opened in %.1f us\n", opt.packPath, (unsigned long long) library.size(), opening * 1e6);
+    printf("Engine:        %s, %llu frames each\n", chip8::engineName(opt.engine), opt.frames);
+    printf("%-12s %-18s %-7s %16s %6s %18s\n", "ROM", "hash", "quirks", "instr/sec", "idle", "FB hash");
+
+    double loading = 0;
+    double running = 0;
+    for (size_t i = 0; i < library.size(); ++i)
+    {
+        const chip8_pack_entry &e = library.entry(i);
+        chip8 emu;
+        emu.setEngine(opt.engine);
+        emu.setIdleSkipping(opt.idle);
+        emu.setCyclesPerFrame((unsigned) opt.ipf);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        emu.initialize();
+        emu.loadGame(library.image(e), e.size);
+        if (opt.quirks >= 0) {
+            emu.setQuirks((chip8::Quirks) opt.quirks);
+        }
+        chrono::steady_clock::time_point loaded = chrono::steady_clock::now();
+        if (opt.seeded) {
+            emu.seedRandom(opt.seed);
+        }
+        chip8_frame result = emu.runFrames((unsigned) opt.frames);
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+        double elapsed = seconds(loaded, end);
+        loading += seconds(start, loaded);
+        running += elapsed;
+
+        printf("%-12s %016llX   %-7s %16.0f %5.1f%%   %016llX\n", e.name, (unsigned long long) e.hash, chip8::quirksName(emu.getQuirks()),
+               elapsed > 0 ? result.instructions / elapsed : 0.0,
+               result.instructions ? 100.0 * emu.getIdleInstructions() / result.instructions : 0.0,
+               (unsigned long long) emu.framebufferHash());
+    }
+
+    printf("Loading:       %.1f us in all\n", (opening + loading) * 1e6);
+    printf("Running:       %.6f s in all\n", running);
+    return 0;
+}
+
+// Framebuffer hash of one machine running a pack ROM for opt.frames frames
+static uint64_t checkSingle(const Options &opt, const chip8_library &library, const chip8_pack_entry &e,
+                            chip8::Engine engine, chip8::Quirks quirks, bool idle)
+{
+    chip8 emu;
+    emu.setEngine(engine);
+    emu.setIdleSkipping(idle);
+    emu.setCyclesPerFrame((unsigned) opt.ipf);
+    emu.initialize();
+    emu.loadGame(library.image(e), e.size);
+    emu.setQuirks(quirks);
+    emu.seedRandom(opt.seeded ? opt.seed : 1);
+    emu.runFrames((unsigned) opt.frames);
+    return emu.framebufferHash();
+}
+
+/*
+ * Runs every ROM of the pack under every quirk profile, with and without
+ * idle skipping, on each engine and compares the final framebuffer with the
+ * interpreter's. The lanes engine only takes part for ROMs it implements:
+ * 64x32 CHIP-8 that loads with the modern profile. Returns 1 on any mismatch.
+ */
+static int runCheck(const Options &opt, const chip8_library &library)
+{
+    chip8_thread_pool pool(opt.threads);
+    const uint32_t seed = opt.seeded ? opt.seed : 1;
+    unsigned runs = 0;
+    unsigned mismatches = 0;
+
+    printf("Pack:          %s, %llu ROMs, %llu frames each\n", opt.packPath, (unsigned long long) library.size(), opt.frames);
+    for (size_t i = 0; i < library.size(); ++i)
+    {
+        const chip8_pack_entry &e = library.entry(i);
+        const chip8::Quirks own = chip8_rom_quirks(e.hash, e.size);
+
+        for (int q = 0; q < chip8::QUIRKS_COUNT; ++q)
+        {
+            const chip8::Quirks quirks = (chip8::Quirks) q;
+            for (int idle = 1; idle >= 0; --idle)
+            {
+                uint64_t expected = checkSingle(opt, library, e, chip8::ENGINE_INTERPRETER, quirks, idle != 0);
+                vector<pair<const char *, uint64_t> > results;
+                results.push_back(make_pair("blocks", checkSingle(opt, library, e, chip8::ENGINE_BLOCKS, quirks, idle != 0)));
+                results.push_back(make_pair("native", checkSingle(opt, library, e, chip8::ENGINE_NATIVE, quirks, idle != 0)));
+
+                chip8_batch batch(2, pool);
+                batch.setIdleSkipping(idle != 0);
+                batch.setCyclesPerFrame((unsigned) opt.ipf);
+                batch.loadGame(library.image(e), e.size);
+                batch.setQuirks(quirks);
+                batch.seedRandom(seed);
+                batch.runFrames((unsigned) opt.frames);
+                results.push_back(make_pair("batch", batch.framebufferHash(0)));
+
+                if (quirks == chip8::QUIRKS_MODERN && own == chip8::QUIRKS_MODERN && e.size <= CHIP8_LANES_ROM_MAX_SIZE) {
+                    chip8_lanes lanes(2);
+                    lanes.setCyclesPerFrame((unsigned) opt.ipf);
+                    lanes.loadGame(library.image(e), e.size);
+                    lanes.seedRandom(seed);
+                    lanes.runFrames((unsigned) opt.frames);
+                    results.push_back(make_pair("lanes", lanes.framebufferHash(0)));
+                }
+
+                for (size_t r = 0; r < results.size(); ++r)
+                {
+                    ++runs;
+                    if (results[r].second != expected) {
+                        ++mismatches;
+                        printf("MISMATCH      %-12s %-7s idle %-3s %-7s %016llX, interpreter %016llX\n",
+                               e.name, chip8::quirksName(quirks), idle ? "on" : "off", results[r].first,
+                               (unsigned long long) results[r].second, (unsigned long long) expected);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("Compared:      %u runs against the interpreter, %u mismatches\n", runs, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
+
+static int runScaling(const Options &opt)
+{
+    unsigned maxThreads = opt.threads ? opt.threads : thread::hardware_concurrency();
+    if (maxThreads == 0) {
+        maxThreads = 1;
+    }
+
+    printf("ROM: %s, %llu instances, %llu frames each\n", opt.loadStatePath ? opt.loadStatePath : opt.romPath, (unsigned long long) opt.instances, opt.frames);
+    printf("%8s %16s %8s\n", "threads", "instr/sec", "speedup");
+
+    double base = 0;
+    for (unsigned threads = 1; ; threads *= 2)
+    {
+        if (threads > maxThreads) {
+            threads = maxThreads;
+        }
+
+        double rate = runBatch(opt, threads, false);
+        if (rate < 0) {
+            return 1;
+        }
+        if (base == 0) {
+            base = rate;
+        }
+        printf("%8u %16.0f %7.2fx\n", threads, rate, base > 0 ? rate / base : 0.0);
+
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+// One thread per machine, each running a frame whenever its agent steps it, until an agent asks to stop
+static int runServe(const Options &opt)
+{
+    chip8_shm shm;
+    if (!shm.create(opt.serveName, (unsigned) opt.instances, CHIP8_SHM_STEPPED, chip8_rom_hash(opt.rom, opt.romSize))) {
+        fprintf(stderr, "Cannot create shared memory: %s\n", opt.serveName);
+        return 1;
+    }
+    printf("Serving:       %s, %zu machines of %s\n", opt.serveName, opt.instances, opt.romPath);
+    fflush(stdout);
+
+    std::atomic<unsigned long long> total(0);
+    vector<thread> workers;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned i = 0; i < (unsigned) opt.instances; ++i)
+    {
+        workers.push_back(thread([&opt, &shm, &total, i]
+        {
+            chip8 emu;
+            emu.setEngine(opt.engine);
+            emu.setIdleSkipping(opt.idle);
+            emu.setCyclesPerFrame((unsigned) opt.ipf);
+            emu.initialize();
+            emu.loadGame(opt.rom, opt.romSize);
+            if (opt.quirks >= 0) {
+                emu.setQuirks((chip8::Quirks) opt.quirks);
+            }
+            emu.seedRandom(opt.seeded ? opt.seed : 1);
+
+            // Frame 0 is the machine as booted, there before the first step
+            unsigned long long frames = 0;
+            shm.publish(i, emu, frames);
+
+            uint32_t request;
+            while (shm.waitRequest(i, request))
+            {
+                unsigned mask = shm.keys(i);
+                unsigned char key[16];
+                for (int k = 0; k < 16; ++k)
+                {
+                    key[k] = (mask >> k) & 1;
+                }
+                emu.setKeys(key);
+                emu.runFrame();
+                shm.publish(i, emu, ++frames);
+                shm.complete(i, request);
+            }
+            total += frames;
+        }));
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+    double elapsed = seconds(start, chrono::steady_clock::now());
+
+    printf("Frames:        %llu stepped in %.3f s\n", total.load(), elapsed);
+    return 0;
+}
+
+// Reference agent: one thread per served machine pressing random keys, then asks the server to stop
+static int runAgent(const Options &opt)
+{
+    chip8_shm shm;
+    if (!shm.attach(opt.agentName)) {
+        fprintf(stderr, "Nothing served at %s\n", opt.agentName);
+        return 1;
+    }
+    if (shm.mode() != CHIP8_SHM_STEPPED) {
+        fprintf(stderr, "%s runs freely and cannot be stepped\n", opt.agentName);
+        return 1;
+    }
+
+    unsigned slots = shm.slots();
+    std::atomic<bool> served(true);
+    vector<thread> agents;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned s = 0; s < slots; ++s)
+    {
+        agents.push_back(thread([&opt, &shm, &served, s]
+        {
+            // xorshift32; each machine gets its own key sequence, at most one key down per frame
+            uint32_t x = (opt.seeded ? opt.seed : 1) * 2654435761u + s + 1;
+            for (unsigned long long f = 0; f < opt.frames; ++f)
+            {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                unsigned key = x % 17;
+                if (!shm.step(s, key < 16 ? 1u << key : 0)) {
+                    served.store(false);
+                    return;
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < agents.size(); ++i)
+    {
+        agents[i].join();
+    }
+    double elapsed = seconds(start, chrono::steady_clock::now());
+    shm.requestStop();
+
+    if (!served.load()) {
+        fprintf(stderr, "The emulator serving %s went away\n", opt.agentName);
+        return 1;
+    }
+
+    // Read in place: the server is idle until the next step
+    unsigned long long frames = opt.frames * slots;
+    printf("Agent:         %s, %u machines\n", opt.agentName, slots);
+    printf("Frames:        %llu in %.3f s\n", frames, elapsed);
+    printf("Steps/sec:     %.0f (%.2f us per step and machine)\n",
+           elapsed > 0 ? frames / elapsed : 0.0, frames ? elapsed * slots / frames * 1e6 : 0.0);
+    printf("FB hash:       0x%016llX (machine 0)\n", (unsigned long long) shm.slot(0)->frame.hash);
+    return 0;
+}
+
+// Breadth-first search from the booted ROM (or a savestate), one line per level
+static int runSearch(const Options &opt)
+{
+    chip8 root;
+    root.setIdleSkipping(opt.idle);
+    root.initialize();
+    if (opt.loadStatePath != NULL) {
+        if (!root.loadState(opt.loadStatePath)) {
+            fprintf(stderr, "Cannot load state: %s\n", opt.loadStatePath);
+            return 1;
+        }
+    } else {
+        root.loadGame(opt.rom, opt.romSize);
+        if (opt.quirks >= 0) {
+            root.setQuirks((chip8::Quirks) opt.quirks);
+        }
+        root.seedRandom(opt.seeded ? opt.seed : 1);
+    }
+    chip8_state state;
+    root.saveState(state);
+
+    chip8_thread_pool pool(opt.threads);
+    chip8_search search(pool);
+    search.setFramesPerStep(opt.stepFrames);
+    search.setCyclesPerFrame((unsigned) opt.ipf);
+    search.setIdleSkipping(opt.idle);
+    search.setStateLimit(opt.maxStates);
+    if (!search.reset(state)) {
+        fprintf(stderr, "The machine state cannot be searched\n");
+        return 1;
+    }
+
+    printf("ROM:           %s\n", opt.loadStatePath ? opt.loadStatePath : opt.romPath);
+    printf("Threads:       %u\n", pool.size());
+    printf("Step:          %u frames per key\n", opt.stepFrames);
+    for (unsigned level = 0; level < opt.searchDepth && !search.frontier().empty(); ++level)
+    {
+        size_t added = search.expand();
+        const chip8_search_stats &s = search.getStats();
+        printf("Depth %3u:     %zu new, %llu states, %llu frontier, %.1f MB\n",
+               level + 1, added, s.states, s.frontier, s.bytes / 1048576.0);
+        fflush(stdout);
+        if (opt.maxStates != 0 && s.states >= opt.maxStates) {
+            break;
+        }
+    }
+
+    const chip8_search_stats &s = search.getStats();
+    printf("States:        %llu distinct, %llu expanded\n", s.states, s.expanded);
+    printf("Successors:    %llu (%.1f%% duplicates)\n", s.successors,
+           s.successors ? 100.0 * s.duplicates / s.successors : 0.0);
+    printf("Pages:         %llu pages, %llu groups\n", s.pages, s.groups);
+    printf("Store:         %.1f MB (%.0f bytes per state)\n", s.bytes / 1048576.0, s.states ? (double) s.bytes / s.states : 0.0);
+    printf("Instructions:  %llu\n", s.instructions);
+    printf("Elapsed:       %.3f s\n", s.seconds);
+    printf("Successors/s:  %.0f\n", s.seconds > 0 ? s.successors / s.seconds : 0.0);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    opt.romPath = NULL;
+    opt.rom = NULL;
+    opt.romSize = 0;
+    opt.frames = 0;
+    opt.ipf = CHIP8_DEFAULT_CYCLES_PER_FRAME;
+    opt.engine = chip8::ENGINE_INTERPRETER;
+    opt.lanes = false;
+    opt.seed = 0;
+    opt.seeded = false;
+    opt.instances = 1;
+    opt.threads = 0;
+    opt.scaling = false;
+    opt.loadStatePath = NULL;
+    opt.saveStatePath = NULL;
+    opt.rewind = false;
+    opt.recordPath = NULL;
+    opt.replayPath = NULL;
+    opt.profile = false;
+    opt.tracePath = NULL;
+    opt.packPath = NULL;
+    opt.quirks = -1;
+    opt.idle = true;
+    opt.audioPath = NULL;
+    opt.videoPath = NULL;
+    opt.serveName = NULL;
+    opt.agentName = NULL;
+    opt.searchDepth = 0;
+    opt.stepFrames = 1;
+    opt.maxStates = 0;
+
+    unsigned long long cycles = 1000000;
+    const char *buildDir = NULL;
+    bool list = false;
+    bool all = false;
+    bool check = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            opt.frames = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+            opt.ipf = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "interpreter") == 0) {
+                opt.engine = chip8::ENGINE_INTERPRETER;
+            } else if (strcmp(name, "blocks") == 0) {
+                opt.engine = chip8::ENGINE_BLOCKS;
+            } else if (strcmp(name, "native") == 0) {
+                opt.engine = chip8::ENGINE_NATIVE;
+            } else if (strcmp(name, "lanes") == 0) {
+                opt.lanes = true;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            opt.seed = (uint32_t) strtoul(argv[++i], NULL, 0);
+            opt.seeded = true;
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            opt.instances = (size_t) strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opt.threads = (unsigned) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            opt.scaling = true;
+        } else if (strcmp(argv[i], "--load-state") == 0 && i + 1 < argc) {
+            opt.loadStatePath = argv[++i];
+        } else if (strcmp(argv[i], "--save-state") == 0 && i + 1 < argc) {
+            opt.saveStatePath = argv[++i];
+        } else if (strcmp(argv[i], "--rewind") == 0) {
+            opt.rewind = true;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            opt.recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            opt.replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--no-idle") == 0) {
+            opt.idle = false;
+        } else if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc) {
+            opt.audioPath = argv[++i];
+        } else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+            opt.videoPath = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            opt.serveName = argv[++i];
+        } else if (strcmp(argv[i], "--agent") == 0 && i + 1 < argc) {
+            opt.agentName = argv[++i];
+        } else if (strcmp(argv[i], "--search") == 0 && i + 1 < argc) {
+            opt.searchDepth = (unsigned) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            opt.stepFrames = (unsigned) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--max-states") == 0 && i + 1 < argc) {
+            opt.maxStates = (size_t) strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            opt.profile = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            opt.tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            for (int q = 0; q < chip8::QUIRKS_COUNT; ++q)
+            {
+                if (strcmp(name, chip8::quirksName((chip8::Quirks) q)) == 0) {
+                    opt.quirks = q;
+                }
+            }
+            if (opt.quirks < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+            opt.packPath = argv[++i];
+        } else if (strcmp(argv[i], "--build") == 0 && i + 1 < argc) {
+            buildDir = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else if (strcmp(argv[i], "--all") == 0) {
+            all = true;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            opt.romPath = argv[i];
+        }
+    }
+
+    bool packOnly = buildDir != NULL || list || all || check;
+    if ((opt.romPath == NULL && opt.loadStatePath == NULL && !packOnly && opt.agentName == NULL) || opt.ipf == 0 || opt.instances == 0
+            || (packOnly && opt.packPath == NULL)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Everything runs in whole frames so timers tick at the right rate
+    if (opt.frames == 0) {
+        opt.frames = (cycles + opt.ipf - 1) / opt.ipf;
+    }
+    if (opt.agentName != NULL) {
+        return runAgent(opt);
+    }
+
+    chip8_library library;
+    if (buildDir != NULL) {
+        vector<string> skipped;
+        if (!chip8_library::build(buildDir, opt.packPath, &skipped)) {
+            fprintf(stderr, "Cannot build %s from %s\n", opt.packPath, buildDir);
+            return 1;
+        }
+        for (size_t i = 0; i < skipped.size(); ++i)
+        {
+            fprintf(stderr, "Skipped %s: not a ROM of 1 to %d bytes\n", skipped[i].c_str(), CHIP8_ROM_MAX_SIZE);
+        }
+    }
+    if (opt.packPath != NULL) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (!library.open(opt.packPath)) {
+            fprintf(stderr, "Not a ROM pack of this version: %s\n", opt.packPath);
+            return 1;
+        }
+        double opening = seconds(start, chrono::steady_clock::now());
+
+        if (list) {
+            for (size_t i = 0; i < library.size(); ++i)
+            {
+                const chip8_pack_entry &e = library.entry(i);
+                printf("%-12s %016llX %5u bytes\n", e.name, (unsigned long long) e.hash, e.size);
+            }
+            return 0;
+        }
+        if (all) {
+            return runAll(opt, library, opening);
+        }
+        if (check) {
+            return runCheck(opt, library);
+        }
+        if (opt.romPath == NULL && opt.loadStatePath == NULL) {
+            return 0;
+        }
+    }
+
+    // The ROM is resolved once; every engine loads it from memory
+    vector<unsigned char> romFile;
+    if (opt.romPath != NULL && opt.packPath != NULL) {
+        const chip8_pack_entry *e = library.find(opt.romPath);
+        if (e == NULL) {
+            fprintf(stderr, "No ROM named %s (or with that hash) in %s\n", opt.romPath, opt.packPath);
+            return 1;
+        }
+        opt.romPath = e->name;
+        opt.rom = library.image(*e);
+        opt.romSize = e->size;
+    } else if (opt.romPath != NULL) {
+        if (!chip8_read_rom(opt.romPath, romFile)) {
+            fprintf(stderr, "Cannot load ROM: %s (missing, empty or over %d bytes)\n", opt.romPath, CHIP8_ROM_MAX_SIZE);
+            return 1;
+        }
+        opt.rom = &romFile[0];
+        opt.romSize = romFile.size();
+    }
+
+    // Movies always start from a freshly booted ROM
+    if ((opt.recordPath != NULL || opt.replayPath != NULL) && (opt.romPath == NULL || opt.loadStatePath != NULL)) {
+        fprintf(stderr, "Movies need a ROM and cannot start from a savestate\n");
+        return 1;
+    }
+    if (opt.replayPath != NULL) {
+        return runReplay(opt);
+    }
+    if (opt.recordPath != NULL && opt.instances > 1) {
+        fprintf(stderr, "--record runs a single machine\n");
+        return 1;
+    }
+
+    // Only runSingle() records, profiles or traces; the other modes would drop these silently
+    bool singleOnly = opt.rewind || opt.profile || opt.tracePath != NULL || opt.audioPath != NULL || opt.videoPath != NULL;
+    if (singleOnly && (opt.instances > 1 || opt.scaling || opt.lanes || opt.serveName != NULL || opt.searchDepth > 0)) {
+        fprintf(stderr, "--rewind, --profile, --trace, --audio and --video run a single machine\n");
+        return 1;
+    }
+
+    if (opt.serveName != NULL) {
+        if (opt.romPath == NULL || opt.loadStatePath != NULL || opt.lanes) {
+            fprintf(stderr, "--serve boots a ROM on the interpreter or block engine\n");
+            return 1;
+        }
+        return runServe(opt);
+    }
+    if (opt.searchDepth > 0) {
+        if (opt.lanes) {
+            fprintf(stderr, "--search runs on the interpreter\n");
+            return 1;
+        }
+        return runSearch(opt);
+    }
+    if (opt.lanes) {
+        if (opt.romPath == NULL || opt.loadStatePath != NULL || opt.saveStatePath != NULL) {
+            fprintf(stderr, "--engine lanes boots from a ROM and does not support savestates\n");
+            return 1;
+        }
+        return runLanes(opt);
+    }
+    if (opt.scaling) {
+        return runScaling(opt);
+    }
+    if (opt.instances > 1) {
+        return runBatch(opt, opt.threads, true) < 0 ? 1 : 0;
+    }
+    return runSingle(opt);
+}
@@ -0,0 +1,117 @@
+#include "recompiler.h"
+#include "library.h"
+#include "quirks.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] <rom>...\n", prog);
+    printf("  --quirks Q     modern, vip, chip48, schip or xochip (default: by ROM hash)\n");
+    printf("  --output F     Write the C++ to F instead of stdout\n");
+    printf("  --cfg          List each ROM's blocks on stderr\n");
+}
+
+// The file name without directories and extension, as a C++ identifier
+static string programName(const char *path)
+{
+    const char *base = strrchr(path, '/');
+    base = (base != NULL) ? base + 1 : path;
+
+    string name;
+    for (const char *c = base; *c != '\0' && *c != '.'; ++c)
+    {
+        name += isalnum((unsigned char) *c) ? *c : '_';
+    }
+    return name.empty() ? string("rom") : name;
+}
+
+int main(int argc, char **argv)
+{
+    vector<const char *> paths;
+    const char *output = NULL;
+    int quirks = -1;
+    bool cfg = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            for (int q = 0; q < chip8::QUIRKS_COUNT; ++q)
+            {
+                if (strcmp(name, chip8::quirksName((chip8::Quirks) q)) == 0) {
+                    quirks = q;
+                }
+            }
+            if (quirks < 0) {
+                fprintf(stderr, "Unknown quirks profile: %s\n", name);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--cfg") == 0) {
+            cfg = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (output != NULL && (out = fopen(output, "w")) == NULL) {
+        fprintf(stderr, "Cannot write %s\n", output);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by Chip8Recompile from");
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        fprintf(out, " %s", programName(paths[i]).c_str());
+    }
+    fprintf(out, ", do not edit\n\n#include \"native.h\"\n");
+
+    int status = 0;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        vector<unsigned char> rom;
+        if (!chip8_read_rom(paths[i], rom) || rom.empty()) {
+            fprintf(stderr, "Cannot read %s\n", paths[i]);
+            status = 1;
+            continue;
+        }
+
+        chip8::Quirks profile = (quirks >= 0) ? (chip8::Quirks) quirks
+                                              : chip8_rom_quirks(chip8_rom_hash(&rom[0], rom.size()), rom.size());
+        chip8_recompiler recompiler;
+        recompiler.analyze(&rom[0], rom.size(), profile);
+
+        string name = programName(paths[i]);
+        fprintf(out, "\n");
+        recompiler.emit(out, name.c_str());
+
+        const chip8_recompiler_stats &stats = recompiler.getStats();
+        fprintf(stderr, "%-12s %-7s %4u blocks, %4u of %4u instructions (%u interpreted, %u uncompiled), %u returns and computed jumps\n",
+                name.c_str(), chip8::quirksName(profile), stats.blocks, stats.instructions, stats.reachable,
+                stats.interpreted, stats.uncompiled, stats.dynamic);
+        if (cfg) {
+            recompiler.listBlocks(stderr);
+        }
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return status;
+}
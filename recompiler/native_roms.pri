@@ -0,0 +1,22 @@
+# Include this from any project that runs the bundled ROMs on ENGINE_NATIVE.
+# native_roms.cpp is generated into the build directory by Chip8Recompile,
+# so it always matches the recompiler, native.h and the ROMs it is built from.
+# The subdirs project builds recompiler before anything that includes this.
+
+NATIVE_ROMS = $$files($$PWD/../ROMs/*)
+
+win32:CONFIG(release, debug|release) {
+    CHIP8_RECOMPILE = $$OUT_PWD/../recompiler/release/Chip8Recompile.exe
+} else:win32:CONFIG(debug, debug|release) {
+    CHIP8_RECOMPILE = $$OUT_PWD/../recompiler/debug/Chip8Recompile.exe
+} else {
+    CHIP8_RECOMPILE = $$OUT_PWD/../recompiler/Chip8Recompile
+}
+
+native_roms.input = NATIVE_ROMS
+native_roms.output = native_roms.cpp
+native_roms.commands = $$shell_path($$CHIP8_RECOMPILE) --output ${QMAKE_FILE_OUT} ${QMAKE_FILE_IN}
+native_roms.depends = $$CHIP8_RECOMPILE
+native_roms.variable_out = SOURCES
+native_roms.CONFIG += combine target_predeps
+QMAKE_EXTRA_COMPILERS += native_roms
@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Ahead-of-time recompiler from ROMs to C++, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt app_bundle
+CONFIG   += console
+
+TARGET = Chip8Recompile
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,75 @@
+#include "trace.h"
+#include "disasm.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] <trace>\n", prog);
+    printf("  --last N       Only the newest N instructions\n");
+    printf("  --pc ADDR      Only instructions at ADDR (hex)\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    unsigned long long last = 0;
+    int onlyPC = -1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--last") == 0 && i + 1 < argc) {
+            last = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--pc") == 0 && i + 1 < argc) {
+            onlyPC = (int) strtoul(argv[++i], NULL, 16) & 0x0FFF;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    chip8_trace_header header;
+    vector<chip8_trace_entry> entries;
+    if (!chip8_trace::load(path, header, entries)) {
+        fprintf(stderr, "Not a trace of this version: %s\n", path);
+        return 1;
+    }
+
+    size_t begin = 0;
+    if (last != 0 && last < entries.size()) {
+        begin = entries.size() - (size_t) last;
+    }
+
+    // Instruction numbers count from the start of the traced run
+    unsigned long long first = header.total - header.count;
+    printf("%llu instructions traced, %llu in this file\n", (unsigned long long) header.total, (unsigned long long) header.count);
+
+    for (size_t i = begin; i < entries.size(); ++i)
+    {
+        const chip8_trace_entry &e = entries[i];
+        if (onlyPC >= 0 && e.pc != onlyPC) {
+            continue;
+        }
+
+        char text[32];
+        chip8_disassemble(e.opcode, text, sizeof(text));
+
+        printf("%12llu  %03X  %04X  %-18s I=%03X", first + i, e.pc, e.opcode, text, e.I);
+        if (e.reg != CHIP8_TRACE_NO_REG) {
+            printf("  V%X=%02X", e.reg, e.value);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
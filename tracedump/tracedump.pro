@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Decoder for instruction traces, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt app_bundle
+CONFIG   += console
+
+TARGET = Chip8TraceDump
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += main.cpp
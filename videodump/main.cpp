@@ -0,0 +1,137 @@
+#include "video.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Same colors as the GUI, indexed by the planes a pixel is lit in
+static const unsigned char palette[4][3] = {
+    { 0, 0, 0 }, { 255, 255, 255 }, { 255, 102, 0 }, { 255, 204, 0 }
+};
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] <video> [prefix]\n", prog);
+    printf("Writes prefix000000.ppm, prefix000001.ppm, ... one per frame (60 per second),\n");
+    printf("or only prints what the video holds if no prefix is given. <video> may be - for stdin.\n");
+    printf("  --scale N      Pixels per 128x64 pixel (default 4); 64x32 pictures are doubled\n");
+    printf("  --distinct     One image per distinct picture instead of one per frame\n");
+}
+
+// P6 image of a picture at 128x64 times scale
+static void render(const uint64_t *rows, bool hires, int scale, vector<unsigned char> &image)
+{
+    const int width = 128 * scale;
+    const int height = 64 * scale;
+    char head[32];
+    int headLength = snprintf(head, sizeof(head), "P6\n%d %d\n255\n", width, height);
+
+    image.resize(headLength + (size_t) width * height * 3);
+    memcpy(&image[0], head, headLength);
+    unsigned char *out = &image[headLength];
+
+    // Lo-res pixels cover two hi-res ones each way
+    const int shift = hires ? 0 : 1;
+    for (int y = 0; y < height; ++y)
+    {
+        int row = (y / scale) >> shift;
+        for (int x = 0; x < width; ++x)
+        {
+            int column = (x / scale) >> shift;
+            const uint64_t *word = rows + row * CHIP8_FB_ROW_WORDS + (column >> 6);
+            int bit = 63 - (column & 63);
+            int color = (int) (((word[0] >> bit) & 1) | (((word[CHIP8_FB_PLANE_WORDS] >> bit) & 1) << 1));
+            memcpy(out, palette[color], 3);
+            out += 3;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    const char *prefix = NULL;
+    int scale = 4;
+    bool distinct = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--distinct") == 0) {
+            distinct = true;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            return 1;
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            prefix = argv[i];
+        }
+    }
+
+    if (path == NULL || scale < 1 || scale > 64) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    chip8_video_reader video;
+    if (!video.open(path)) {
+        fprintf(stderr, "Not a video of this version: %s\n", path);
+        return 1;
+    }
+
+    uint64_t rows[CHIP8_VIDEO_FRAME_WORDS];
+    bool hires;
+    uint32_t held;
+    unsigned long long frames = 0;
+    unsigned long long pictures = 0;
+    unsigned long long images = 0;
+    vector<unsigned char> image;
+    while (video.readPicture(rows, hires, held))
+    {
+        ++pictures;
+        frames += held;
+        if (prefix == NULL) {
+            continue;
+        }
+
+        render(rows, hires, scale, image);
+        uint32_t copies = distinct ? 1 : held;
+        for (uint32_t c = 0; c < copies; ++c)
+        {
+            string name = prefix;
+            char number[16];
+            snprintf(number, sizeof(number), "%06llu.ppm", images++);
+            name += number;
+
+            FILE *fp = fopen(name.c_str(), "wb");
+            bool ok = fp != NULL && fwrite(&image[0], 1, image.size(), fp) == image.size();
+            if (fp != NULL) {
+                ok = (fclose(fp) == 0) && ok;
+            }
+            if (!ok) {
+                fprintf(stderr, "Cannot write %s\n", name.c_str());
+                return 1;
+            }
+        }
+    }
+
+    const chip8_video_header &header = video.getHeader();
+    if (header.frames != 0 && header.frames != frames) {
+        fprintf(stderr, "Video ends after %llu of %llu frames\n", frames, (unsigned long long) header.frames);
+        return 1;
+    }
+
+    printf("ROM hash:      %016llX\n", (unsigned long long) header.romHash);
+    printf("Frames:        %llu (%.1f s)\n", frames, frames / 60.0);
+    printf("Pictures:      %llu distinct\n", pictures);
+    if (prefix != NULL) {
+        printf("Images:        %llu written as %s*.ppm\n", images, prefix);
+    }
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Converts framebuffer videos to image sequences, no Qt dependency
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt app_bundle
+CONFIG   += console
+
+TARGET = Chip8VideoDump
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += main.cpp